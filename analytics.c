@@ -0,0 +1,252 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "analytics.h"
+#include "structures.h"
+
+// A pair of symbol tiles over a span of days fits in L2: 2 x 64 x 256 doubles
+#define TILE_SYMBOLS 64
+#define TILE_DAYS 256
+
+static size_t packed_index(int n, int i, int j) {
+    if (i > j) {
+        int swap = i;
+        i = j;
+        j = swap;
+    }
+    return (size_t)i * (size_t)n - (size_t)i * (size_t)(i - 1) / 2 + (size_t)(j - i);
+}
+
+int covariance_init(CovarianceMatrix *matrix, int symbol_count) {
+    size_t packed = (size_t)symbol_count * (size_t)(symbol_count + 1) / 2;
+
+    matrix->symbol_count = symbol_count;
+    matrix->window = 0;
+    matrix->sums = calloc((size_t)symbol_count + 1, sizeof(double));
+    matrix->products = calloc(packed + 1, sizeof(double));
+    if (matrix->sums == NULL || matrix->products == NULL) {
+        covariance_free(matrix);
+        return -1;
+    }
+    return 0;
+}
+
+void covariance_free(CovarianceMatrix *matrix) {
+    free(matrix->sums);
+    free(matrix->products);
+    matrix->sums = NULL;
+    matrix->products = NULL;
+}
+
+static double bar_return(const double *closes, int day) {
+    return closes[day - 1] > 0.0 ? closes[day] / closes[day - 1] - 1.0 : 0.0;
+}
+
+typedef struct {
+    const double *returns;      // symbol-major: returns[i * days + t]
+    int symbol_count;
+    int days;
+    double *products;
+    int first_pair;
+    int stride;
+} CovWorker;
+
+// Accumulates every dot product between two symbol tiles, one span of days
+// at a time. Each row is paired with four columns at once so its values are
+// loaded once per four products.
+static void covariance_tile(const CovWorker *worker, int bi, int bj) {
+    int n = worker->symbol_count, days = worker->days;
+    int i0 = bi * TILE_SYMBOLS, j0 = bj * TILE_SYMBOLS;
+    int i_end = i0 + TILE_SYMBOLS < n ? i0 + TILE_SYMBOLS : n;
+    int j_end = j0 + TILE_SYMBOLS < n ? j0 + TILE_SYMBOLS : n;
+    double acc[TILE_SYMBOLS][TILE_SYMBOLS];
+
+    memset(acc, 0, sizeof(acc));
+    for (int t0 = 0; t0 < days; t0 += TILE_DAYS) {
+        int t1 = t0 + TILE_DAYS < days ? t0 + TILE_DAYS : days;
+
+        for (int i = i0; i < i_end; i++) {
+            const double *ri = worker->returns + (size_t)i * days;
+            int j = bi == bj ? i : j0;
+
+            for (; j + 4 <= j_end; j += 4) {
+                const double *r0 = worker->returns + (size_t)j * days;
+                const double *r1 = r0 + days, *r2 = r1 + days, *r3 = r2 + days;
+                double a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0;
+                for (int t = t0; t < t1; t++) {
+                    double x = ri[t];
+                    a0 += x * r0[t];
+                    a1 += x * r1[t];
+                    a2 += x * r2[t];
+                    a3 += x * r3[t];
+                }
+                acc[i - i0][j - j0] += a0;
+                acc[i - i0][j - j0 + 1] += a1;
+                acc[i - i0][j - j0 + 2] += a2;
+                acc[i - i0][j - j0 + 3] += a3;
+            }
+            for (; j < j_end; j++) {
+                const double *rj = worker->returns + (size_t)j * days;
+                double a = 0.0;
+                for (int t = t0; t < t1; t++) a += ri[t] * rj[t];
+                acc[i - i0][j - j0] += a;
+            }
+        }
+    }
+
+    for (int i = i0; i < i_end; i++) {
+        for (int j = bi == bj ? i : j0; j < j_end; j++) {
+            worker->products[packed_index(n, i, j)] = acc[i - i0][j - j0];
+        }
+    }
+}
+
+// Tile pairs (bi <= bj) are dealt out round-robin, so every worker gets a
+// similar share of the triangle and each entry is written by one thread
+static void *cov_worker_main(void *arg) {
+    CovWorker *worker = (CovWorker *)arg;
+    int tiles = (worker->symbol_count + TILE_SYMBOLS - 1) / TILE_SYMBOLS;
+    int pair = 0;
+
+    for (int bi = 0; bi < tiles; bi++) {
+        for (int bj = bi; bj < tiles; bj++, pair++) {
+            if (pair % worker->stride == worker->first_pair) covariance_tile(worker, bi, bj);
+        }
+    }
+    return NULL;
+}
+
+// Covariance of returns on bars [first_day, first_day + day_count); each
+// return is close[d] / close[d - 1] - 1, so first_day must be at least 1.
+// threads <= 0 uses one per CPU.
+int compute_covariance(CovarianceMatrix *matrix, const double *const closes[], int first_day,
+                       int day_count, int threads) {
+    int n = matrix->symbol_count;
+    if (first_day < 1 || day_count <= 0) return -1;
+
+    double *returns = malloc(sizeof(double) * (size_t)n * (size_t)day_count + 1);
+    if (returns == NULL) return -1;
+    for (int i = 0; i < n; i++) {
+        double sum = 0.0;
+        for (int t = 0; t < day_count; t++) {
+            double r = bar_return(closes[i], first_day + t);
+            returns[(size_t)i * day_count + t] = r;
+            sum += r;
+        }
+        matrix->sums[i] = sum;
+    }
+
+    int tiles = (n + TILE_SYMBOLS - 1) / TILE_SYMBOLS;
+    int pairs = tiles * (tiles + 1) / 2;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > pairs) threads = pairs;
+    if (threads <= 0) threads = 1;
+
+    CovWorker workers[threads];
+    pthread_t handles[threads];
+    int started = 0;
+    for (int w = 0; w < threads; w++) {
+        workers[w].returns = returns;
+        workers[w].symbol_count = n;
+        workers[w].days = day_count;
+        workers[w].products = matrix->products;
+        workers[w].first_pair = w;
+        workers[w].stride = threads;
+    }
+    for (int w = 1; w < threads; w++) {
+        if (pthread_create(&handles[w], NULL, cov_worker_main, &workers[w]) != 0) break;
+        started++;
+    }
+    // The calling thread takes the first share, plus any that failed to start
+    cov_worker_main(&workers[0]);
+    for (int w = started + 1; w < threads; w++) cov_worker_main(&workers[w]);
+    for (int w = 1; w <= started; w++) pthread_join(handles[w], NULL);
+
+    matrix->window = day_count;
+    free(returns);
+    return 0;
+}
+
+// Slides the window one bar: the return on leaving_day drops out and the
+// one on entering_day comes in. A leaving_day below 1 grows the window
+// instead, so it can fill up from the start of the data.
+int covariance_roll(CovarianceMatrix *matrix, const double *const closes[], int leaving_day,
+                    int entering_day) {
+    int n = matrix->symbol_count;
+    double *entering = malloc(sizeof(double) * (size_t)n * 2 + 1);
+    if (entering == NULL) return -1;
+    double *leaving = entering + n;
+
+    for (int i = 0; i < n; i++) {
+        entering[i] = bar_return(closes[i], entering_day);
+        leaving[i] = leaving_day >= 1 ? bar_return(closes[i], leaving_day) : 0.0;
+        matrix->sums[i] += entering[i] - leaving[i];
+    }
+    if (leaving_day < 1) matrix->window++;
+    double *row = matrix->products;
+    for (int i = 0; i < n; i++) {
+        double e = entering[i], l = leaving[i];
+        for (int j = i; j < n; j++) *row++ += e * entering[j] - l * leaving[j];
+    }
+    free(entering);
+    return 0;
+}
+
+// Sample covariance from the co-moments
+double covariance_at(const CovarianceMatrix *matrix, int i, int j) {
+    int n = matrix->window;
+    if (n < 2) return 0.0;
+    double product = matrix->products[packed_index(matrix->symbol_count, i, j)];
+    return (product - matrix->sums[i] * matrix->sums[j] / n) / (n - 1);
+}
+
+double correlation_at(const CovarianceMatrix *matrix, int i, int j) {
+    double variance = covariance_at(matrix, i, i) * covariance_at(matrix, j, j);
+    return variance > 0.0 ? covariance_at(matrix, i, j) / sqrt(variance) : 0.0;
+}
+
+// Mean correlation of symbol i with the given members, leaving out i
+// itself; 0 when there is no other member
+double average_correlation(const CovarianceMatrix *matrix, int i, const int members[], int count) {
+    double total = 0.0;
+    int pairs = 0;
+    for (int k = 0; k < count; k++) {
+        if (members[k] == i) continue;
+        total += correlation_at(matrix, i, members[k]);
+        pairs++;
+    }
+    return pairs > 0 ? total / pairs : 0.0;
+}
+
+// Covariance of the loaded stocks over their last `window` returns. Stocks
+// are aligned on their final bar. On success the caller frees the matrix.
+int compute_stock_covariance(CovarianceMatrix *matrix, Stock stocks[], int stock_count,
+                             int window, int threads) {
+    int days = MAX_DAYS;
+    for (int s = 0; s < stock_count; s++) {
+        if (stocks[s].day_count < days) days = stocks[s].day_count;
+    }
+    if (window > days - 1) window = days - 1;
+    if (stock_count <= 0 || window <= 0) return -1;
+
+    double *storage = malloc(sizeof(double) * (size_t)stock_count * (size_t)(window + 1));
+    const double *closes[MAX_STOCKS];
+    if (storage == NULL) return -1;
+    for (int s = 0; s < stock_count; s++) {
+        double *column = storage + (size_t)s * (window + 1);
+        const PriceData *last = &stocks[s].prices[stocks[s].day_count - 1];
+        for (int t = 0; t <= window; t++) column[t] = last[t - window].close;
+        closes[s] = column;
+    }
+
+    int status = covariance_init(matrix, stock_count);
+    if (status == 0) {
+        status = compute_covariance(matrix, closes, 1, window, threads);
+        if (status != 0) covariance_free(matrix);
+    }
+    free(storage);
+    return status;
+}
@@ -0,0 +1,29 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include "structures.h"
+
+// Pairwise return covariance over a window of bars. Only raw co-moments are
+// kept (per-symbol sums and the upper triangle of sum r_i * r_j), so the
+// window can be rolled forward one bar in O(N^2) without recomputing.
+// Calls return -1 on bad arguments or a failed allocation.
+typedef struct {
+    int symbol_count;
+    int window;             // returns currently in the window
+    double *sums;
+    double *products;       // packed upper triangle, row-major
+} CovarianceMatrix;
+
+int covariance_init(CovarianceMatrix *matrix, int symbol_count);
+void covariance_free(CovarianceMatrix *matrix);
+int compute_covariance(CovarianceMatrix *matrix, const double *const closes[], int first_day,
+                       int day_count, int threads);
+int covariance_roll(CovarianceMatrix *matrix, const double *const closes[], int leaving_day,
+                    int entering_day);
+double covariance_at(const CovarianceMatrix *matrix, int i, int j);
+double correlation_at(const CovarianceMatrix *matrix, int i, int j);
+double average_correlation(const CovarianceMatrix *matrix, int i, const int members[], int count);
+int compute_stock_covariance(CovarianceMatrix *matrix, Stock stocks[], int stock_count,
+                             int window, int threads);
+
+#endif
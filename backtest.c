@@ -1,9 +1,121 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <stddef.h>
 #include "backtest.h"
+#include "rules.h"
+#include "order_book.h"
+#include "indicator_cache.h"
+#include "analytics.h"
 #include "structures.h"
 
+// Nearest whole tick; prices are loaded from two-decimal text
+long long price_ticks(double price) {
+    return llround(price * PRICE_SCALE);
+}
+
+void init_portfolio_mode(Portfolio *portfolio, double initial_cash, int fixed_point) {
+    portfolio->cash = initial_cash;
+    portfolio->trade_count = 0;
+    portfolio->trades_made = 0;
+    portfolio->winning_trades = 0;
+    portfolio->losing_trades = 0;
+    portfolio->start_cash = initial_cash;
+    portfolio->realized_profit = 0.0;
+    portfolio->peak_equity = initial_cash;
+    portfolio->max_drawdown = 0.0;
+    portfolio->fixed_point = fixed_point != 0;
+    portfolio->cash_ticks = price_ticks(initial_cash);
+    if (portfolio->fixed_point) portfolio->cash = (double)portfolio->cash_ticks / PRICE_SCALE;
+    for (int i = 0; i < MAX_STOCKS; i++) {
+        portfolio->positions[i] = 0;
+        portfolio->avg_buy_price[i] = 0.0;
+        portfolio->avg_buy_ticks[i] = 0;
+        portfolio->buy_day[i] = -1;
+    }
+}
+
+static unsigned long long hash_bytes(unsigned long long hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Identity of a strategy's behaviour: every parameter and rule, not the name
+unsigned long long strategy_hash(const Strategy *strategy) {
+    unsigned long long hash = 14695981039346656037ULL;
+    hash = hash_bytes(hash, &strategy->rsi_oversold, sizeof(double));
+    hash = hash_bytes(hash, &strategy->rsi_overbought, sizeof(double));
+    hash = hash_bytes(hash, &strategy->sma_short_period, sizeof(int));
+    hash = hash_bytes(hash, &strategy->sma_long_period, sizeof(int));
+    hash = hash_bytes(hash, &strategy->stop_loss_pct, sizeof(double));
+    hash = hash_bytes(hash, &strategy->take_profit_pct, sizeof(double));
+    hash = hash_bytes(hash, &strategy->max_holding_days, sizeof(int));
+    hash = hash_bytes(hash, strategy->entry_rule, strlen(strategy->entry_rule) + 1);
+    hash = hash_bytes(hash, strategy->exit_rule, strlen(strategy->exit_rule) + 1);
+    return hash;
+}
+
+// Whether two strategies behave the same: the fields strategy_hash covers,
+// compared the same way, bit for bit
+int strategies_equal(const Strategy *a, const Strategy *b) {
+    return memcmp(&a->rsi_oversold, &b->rsi_oversold, sizeof(double)) == 0 &&
+           memcmp(&a->rsi_overbought, &b->rsi_overbought, sizeof(double)) == 0 &&
+           a->sma_short_period == b->sma_short_period && a->sma_long_period == b->sma_long_period &&
+           memcmp(&a->stop_loss_pct, &b->stop_loss_pct, sizeof(double)) == 0 &&
+           memcmp(&a->take_profit_pct, &b->take_profit_pct, sizeof(double)) == 0 &&
+           a->max_holding_days == b->max_holding_days &&
+           strcmp(a->entry_rule, b->entry_rule) == 0 && strcmp(a->exit_rule, b->exit_rule) == 0;
+}
+
+// Sets first[i] to the lowest index whose parameters match strategy i, so
+// only entries with first[i] == i need to run. Returns the distinct count.
+int dedupe_strategies(const Strategy strategies[], int count, int first[]) {
+    int slot_count = 16;
+    while (slot_count < count * 2) slot_count *= 2;
+    int *slots = malloc(sizeof(int) * (size_t)slot_count);
+    unsigned long long *hashes = malloc(sizeof(unsigned long long) * (size_t)(count + 1));
+    int distinct = 0;
+
+    if (slots == NULL || hashes == NULL) {
+        // Without the table every entry simply runs
+        for (int i = 0; i < count; i++) first[i] = i;
+        free(slots);
+        free(hashes);
+        return count;
+    }
+    for (int i = 0; i < slot_count; i++) slots[i] = -1;
+    for (int i = 0; i < count; i++) {
+        hashes[i] = strategy_hash(&strategies[i]);
+        int slot = (int)(hashes[i] & (unsigned long long)(slot_count - 1));
+        // Equal hashes only nominate a match; the parameters confirm it
+        while (slots[slot] >= 0 && (hashes[slots[slot]] != hashes[i] ||
+                                    !strategies_equal(&strategies[slots[slot]], &strategies[i]))) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        if (slots[slot] < 0) {
+            slots[slot] = i;
+            distinct++;
+        }
+        first[i] = slots[slot];
+    }
+    free(slots);
+    free(hashes);
+    return distinct;
+}
+
+// Copies a shared result to another owner of the same parameters
+void share_strategy_result(StrategyResult *result, const StrategyResult *source, const char *name,
+                           const char *username) {
+    *result = *source;
+    strcpy(result->strategy_name, name);
+    strcpy(result->username, username);
+}
+
 double calculate_sma(double prices[], int current_day, int period) {
     if (current_day < period - 1) return 0.0;
     
@@ -34,75 +146,406 @@ double calculate_rsi(double prices[], int current_day, int period) {
     return 100.0 - (100.0 / (1.0 + rs));
 }
 
-void backtest(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio) {
+// Appends a trade to the log and applies its cash movement. Once the log is
+// full the cash, positions and running totals are still updated, so results
+// stay consistent.
+// In fixed-point mode the price is a whole number of ticks and cash moves
+// by an exact integer amount.
+static void record_trade(Portfolio *portfolio, Stock *stock, int day, const char *type,
+                         double price, int quantity, double profit, const char *reason) {
+    double total_value = price * quantity;
+    double cash_before = portfolio->cash;
+
+    if (portfolio->fixed_point) {
+        long long value_ticks = price_ticks(price) * quantity;
+        if (strcmp(type, "BUY") == 0) portfolio->cash_ticks -= value_ticks;
+        else portfolio->cash_ticks += value_ticks;
+        total_value = (double)value_ticks / PRICE_SCALE;
+        portfolio->cash = (double)portfolio->cash_ticks / PRICE_SCALE;
+    } else if (strcmp(type, "BUY") == 0) {
+        portfolio->cash -= total_value;
+    } else {
+        portfolio->cash += total_value;
+    }
+
+    portfolio->trades_made++;
+    if (strcmp(type, "SELL") == 0) {
+        portfolio->realized_profit += profit;
+        if (profit > 0) portfolio->winning_trades++;
+        else portfolio->losing_trades++;
+
+        // Equity counting closed trades only
+        double equity = portfolio->start_cash + portfolio->realized_profit;
+        if (equity > portfolio->peak_equity) portfolio->peak_equity = equity;
+        double drawdown = portfolio->peak_equity > 0 ? (portfolio->peak_equity - equity) / portfolio->peak_equity : 0.0;
+        if (drawdown > portfolio->max_drawdown) portfolio->max_drawdown = drawdown;
+    }
+
+    if (portfolio->trade_count >= MAX_TRADES) return;
+
+    Trade *trade = &portfolio->trades[portfolio->trade_count++];
+    trade->symbol_id = stock->symbol_id;
+    strcpy(trade->date, stock->prices[day].date);
+    trade->day = day;
+    strcpy(trade->type, type);
+    trade->price = price;
+    trade->quantity = quantity;
+    trade->total_value = total_value;
+    trade->portfolio_cash_before = cash_before;
+    trade->portfolio_cash_after = portfolio->cash;
+    trade->profit_loss = profit;
+    strcpy(trade->reason, reason);
+}
+
+// Protective orders for a new position: a stop at the stop-loss level and a
+// limit at the take-profit level, both tagged with the symbol index. In
+// fixed-point mode the book holds tick levels, rounded so a tick price
+// triggers exactly when it crosses the unrounded level.
+static void place_exit_orders(OrderBook *book, int s, const Portfolio *portfolio, const Strategy *strategy) {
+    if (portfolio->fixed_point) {
+        long long buy = portfolio->avg_buy_ticks[s];
+        long long stop_bp = llround(strategy->stop_loss_pct * 100.0);
+        long long profit_bp = llround(strategy->take_profit_pct * 100.0);
+        order_book_add(book, s, ORDER_STOP, (double)(buy * (10000 - stop_bp) / 10000), s);
+        order_book_add(book, s, ORDER_LIMIT, (double)((buy * (10000 + profit_bp) + 9999) / 10000), s);
+        return;
+    }
+    double buy_price = portfolio->avg_buy_price[s];
+    order_book_add(book, s, ORDER_STOP, buy_price * (1.0 - strategy->stop_loss_pct / 100.0), s);
+    order_book_add(book, s, ORDER_LIMIT, buy_price * (1.0 + strategy->take_profit_pct / 100.0), s);
+}
+
+// Buys with 20% of available cash at the given price
+static void open_position(Portfolio *portfolio, OrderBook *book, Stock *stock, int s, int day,
+                          double price, const Strategy *strategy, const char *reason) {
+    int quantity;
+
+    if (portfolio->fixed_point) {
+        long long ticks = price_ticks(price);
+        if (ticks <= 0) return;
+        quantity = (int)(portfolio->cash_ticks / 5 / ticks);
+        price = (double)ticks / PRICE_SCALE;
+        portfolio->avg_buy_ticks[s] = ticks;
+    } else {
+        double investment = portfolio->cash * 0.2;
+        quantity = (int)(investment / price);
+        if (portfolio->cash < price * quantity) return;
+    }
+
+    if (quantity > 0) {
+        record_trade(portfolio, stock, day, "BUY", price, quantity, 0.0, reason);
+        portfolio->positions[s] = quantity;
+        portfolio->avg_buy_price[s] = price;
+        portfolio->buy_day[s] = day;
+        place_exit_orders(book, s, portfolio, strategy);
+    }
+}
+
+static void close_position(Portfolio *portfolio, OrderBook *book, Stock *stock, int s, int day,
+                           double price, const char *reason) {
+    int quantity = portfolio->positions[s];
+    double profit;
+
+    if (portfolio->fixed_point) {
+        long long ticks = price_ticks(price);
+        price = (double)ticks / PRICE_SCALE;
+        profit = (double)((ticks - portfolio->avg_buy_ticks[s]) * quantity) / PRICE_SCALE;
+    } else {
+        profit = (price - portfolio->avg_buy_price[s]) * quantity;
+    }
+
+    record_trade(portfolio, stock, day, "SELL", price, quantity, profit, reason);
+    portfolio->positions[s] = 0;
+    portfolio->avg_buy_price[s] = 0.0;
+    portfolio->avg_buy_ticks[s] = 0;
+    portfolio->buy_day[s] = -1;
+    order_book_cancel(book, s, s);
+}
+
+// Fills a protective order the bar's high/low range reached.
+// Returns 1 if the position was closed.
+static int fill_exit_orders(Portfolio *portfolio, OrderBook *book, Stock *stock, int s, int day) {
+    const PriceData *bar = &stock->prices[day];
+    OrderFill fill;
+
+    if (portfolio->fixed_point) {
+        if (order_book_match(book, s, (double)price_ticks(bar->open), (double)price_ticks(bar->high),
+                             (double)price_ticks(bar->low), &fill, 1) == 0) return 0;
+        fill.price /= PRICE_SCALE;
+    } else if (order_book_match(book, s, bar->open, bar->high, bar->low, &fill, 1) == 0) {
+        return 0;
+    }
+
+    double buy_price = portfolio->avg_buy_price[s];
+    double pct = ((fill.price - buy_price) / buy_price) * 100.0;
+    char reason[100];
+    if (fill.type == ORDER_LIMIT) sprintf(reason, "Take Profit (%.2f%% gain)", pct);
+    else sprintf(reason, "Stop Loss (%.2f%% loss)", pct);
+
+    close_position(portfolio, book, stock, s, day, fill.price, reason);
+    return 1;
+}
+
+// Most indicator columns one run reads per stock
+#define RUN_MAX_COLUMNS 32
+
+// The indicator columns a run reads, flattened as columns[s * count + k].
+// With a cache they are pinned, full-length shared columns; otherwise they
+// are computed into storage for the run's window alone.
+typedef struct {
+    const double *columns[MAX_STOCKS * RUN_MAX_COLUMNS];
+    IndicatorColumn *pinned[MAX_STOCKS * RUN_MAX_COLUMNS];
+    int pinned_count;
+    double *storage;
+} RunColumns;
+
+static void release_run_columns(RunColumns *run, IndicatorCache *cache) {
+    for (int i = 0; i < run->pinned_count; i++) indicator_cache_release(cache, run->pinned[i]);
+    run->pinned_count = 0;
+    free(run->storage);
+    run->storage = NULL;
+}
+
+// Fills the columns whose bit is set in needed; the others stay NULL
+static int load_run_columns(RunColumns *run, Stock stocks[], int stock_count,
+                            const RuleIndicator indicators[], int count, unsigned needed,
+                            int first_day, int end_day, IndicatorCache *cache,
+                            const unsigned long long fingerprints[]) {
+    run->pinned_count = 0;
+    run->storage = NULL;
+    for (int i = 0; i < stock_count * count; i++) run->columns[i] = NULL;
+
+    if (cache != NULL) {
+        for (int s = 0; s < stock_count; s++) {
+            for (int k = 0; k < count; k++) {
+                if (!(needed & (1u << k))) continue;
+                IndicatorColumn *column = indicator_cache_acquire(cache, &stocks[s], fingerprints[s],
+                                                                  &indicators[k]);
+                if (column == NULL) {
+                    release_run_columns(run, cache);
+                    return BACKTEST_ERROR_MEMORY;
+                }
+                run->pinned[run->pinned_count++] = column;
+                run->columns[s * count + k] = column->values;
+            }
+        }
+        return BACKTEST_OK;
+    }
+
+    // Signals read day and day - 1, so columns start one bar before first_day
     int max_days = stocks[0].day_count;
+    int column_start = first_day > 0 ? first_day - 1 : 0;
+    int lookback = 0;
+    for (int k = 0; k < count; k++) {
+        if ((needed & (1u << k)) && indicator_lookback(&indicators[k]) > lookback) {
+            lookback = indicator_lookback(&indicators[k]);
+        }
+    }
+    int close_start = column_start > lookback ? column_start - lookback : 0;
+    double closes[MAX_DAYS];
+
+    run->storage = malloc(sizeof(double) * (size_t)(stock_count * count * max_days + 1));
+    if (run->storage == NULL) return BACKTEST_ERROR_MEMORY;
+
+    for (int s = 0; s < stock_count; s++) {
+        for (int i = close_start; i < end_day; i++) {
+            closes[i] = stocks[s].prices[i].close;
+        }
+        for (int k = 0; k < count; k++) {
+            if (!(needed & (1u << k))) continue;
+            double *column = run->storage + ((size_t)s * count + k) * max_days;
+            compute_indicator_column(&indicators[k], closes, column_start, end_day, column);
+            run->columns[s * count + k] = column;
+        }
+    }
+    return BACKTEST_OK;
+}
 
-    for (int day = 20; day < max_days; day++) {
+// Return correlation across the run's stocks for entry rules that read
+// avg_corr(N). The window ends on the current bar and is rolled forward
+// with it; near the start of the data it covers the bars there are.
+typedef struct {
+    CovarianceMatrix matrix;
+    const double *closes[MAX_STOCKS];
+    double *storage;
+    int window;
+} RunCorrelation;
+
+static int start_run_correlation(RunCorrelation *run, Stock stocks[], int stock_count, int window,
+                                 int first_day, int end_day) {
+    run->window = window;
+    run->storage = malloc(sizeof(double) * (size_t)stock_count * (size_t)end_day);
+    if (run->storage == NULL) return BACKTEST_ERROR_MEMORY;
+    for (int s = 0; s < stock_count; s++) {
+        double *column = run->storage + (size_t)s * end_day;
+        for (int d = 0; d < end_day; d++) column[d] = stocks[s].prices[d].close;
+        run->closes[s] = column;
+    }
+
+    int start = first_day - window + 1 > 1 ? first_day - window + 1 : 1;
+    if (covariance_init(&run->matrix, stock_count) != 0) {
+        free(run->storage);
+        return BACKTEST_ERROR_MEMORY;
+    }
+    if (compute_covariance(&run->matrix, run->closes, start, first_day - start + 1, 1) != 0) {
+        covariance_free(&run->matrix);
+        free(run->storage);
+        return BACKTEST_ERROR_MEMORY;
+    }
+    return BACKTEST_OK;
+}
+
+static int advance_run_correlation(RunCorrelation *run, int day) {
+    int leaving = run->matrix.window == run->window ? day - run->window : 0;
+    return covariance_roll(&run->matrix, run->closes, leaving, day) == 0 ? BACKTEST_OK : BACKTEST_ERROR_MEMORY;
+}
+
+static void free_run_correlation(RunCorrelation *run) {
+    covariance_free(&run->matrix);
+    free(run->storage);
+}
+
+// Average correlation of stock s with the other stocks held right now
+static double holdings_correlation(const RunCorrelation *run, const Portfolio *portfolio,
+                                   int stock_count, int s) {
+    int held[MAX_STOCKS], held_count = 0;
+    for (int h = 0; h < stock_count; h++) {
+        if (portfolio->positions[h] > 0) held[held_count++] = h;
+    }
+    return average_correlation(&run->matrix, s, held, held_count);
+}
+
+// Rule-driven variant of the engine: entry/exit signals come from compiled
+// bytecode evaluated over the run's indicator columns.
+static int backtest_rules(Stock stocks[], int stock_count, Strategy strategy,
+                          Portfolio *portfolio, OrderBook *book, const CompiledRules *rules,
+                          int first_day, int end_day, IndicatorCache *cache,
+                          const unsigned long long fingerprints[]) {
+    int per_stock = rules->indicator_count;
+    RunColumns run;
+
+    int status = load_run_columns(&run, stocks, stock_count, rules->indicators, per_stock,
+                                  (1u << per_stock) - 1, first_day, end_day, cache, fingerprints);
+    if (status != BACKTEST_OK) return status;
+
+    char entry_reason[100], exit_reason[100];
+    snprintf(entry_reason, sizeof(entry_reason), "Entry Rule: %.80s",
+             strategy.entry_rule[0] ? strategy.entry_rule : "strategy parameters");
+    snprintf(exit_reason, sizeof(exit_reason), "Exit Rule: %.80s",
+             strategy.exit_rule[0] ? strategy.exit_rule : "strategy parameters");
+
+    RunCorrelation correlation;
+    if (rules->correlation_window > 0) {
+        status = start_run_correlation(&correlation, stocks, stock_count, rules->correlation_window,
+                                       first_day, end_day);
+        if (status != BACKTEST_OK) {
+            release_run_columns(&run, cache);
+            return status;
+        }
+    }
+    double entry_state[RULE_STATE_COUNT] = { 0.0 };
+
+    for (int day = first_day; day < end_day && status == BACKTEST_OK; day++) {
+        if (rules->correlation_window > 0 && day > first_day) {
+            status = advance_run_correlation(&correlation, day);
+            if (status != BACKTEST_OK) break;
+        }
         for (int s = 0; s < stock_count; s++) {
             double current_price = stocks[s].prices[day].close;
-            
-            double close_prices[MAX_DAYS];
-            for (int i = 0; i < day + 1; i++) {
-                close_prices[i] = stocks[s].prices[i].close;
-            }
 
             if (portfolio->positions[s] > 0) {
+                if (fill_exit_orders(portfolio, book, &stocks[s], s, day)) continue;
+
                 double buy_price = portfolio->avg_buy_price[s];
                 double profit_pct = ((current_price - buy_price) / buy_price) * 100.0;
                 int holding_days = day - portfolio->buy_day[s];
+                char reason[100] = "";
+
+                if (holding_days >= strategy.max_holding_days) {
+                    sprintf(reason, "Max Holding Period (%d days)", holding_days);
+                } else if (rules->exit.constant != 0) {
+                    double state[RULE_STATE_COUNT];
+                    state[RULE_STATE_PNL_PCT] = profit_pct;
+                    state[RULE_STATE_HELD_DAYS] = holding_days;
+                    if (rules->exit.constant == 1 || evaluate_rule(&rules->exit, run.columns + s * per_stock, day, state)) {
+                        strcpy(reason, exit_reason);
+                    }
+                }
+
+                if (reason[0] != '\0') {
+                    close_position(portfolio, book, &stocks[s], s, day, current_price, reason);
+                }
+            } else if (rules->entry.constant != 0) {
+                if (rules->correlation_window > 0) {
+                    entry_state[RULE_STATE_AVG_CORR] = holdings_correlation(&correlation, portfolio, stock_count, s);
+                }
+                if (rules->entry.constant == 1 ||
+                    evaluate_rule(&rules->entry, run.columns + s * per_stock, day, entry_state)) {
+                    open_position(portfolio, book, &stocks[s], s, day, current_price, &strategy, entry_reason);
+                }
+            }
+        }
+    }
 
+    if (rules->correlation_window > 0) free_run_correlation(&correlation);
+    release_run_columns(&run, cache);
+    return status;
+}
+
+#ifdef __GNUC__
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE static inline
+#endif
+
+// Columns of the fixed-parameter kernels, COL_COUNT per stock
+enum { COL_CLOSE, COL_SMA_SHORT, COL_SMA_LONG, COL_RSI, COL_COUNT };
+
+// Generic fixed-parameter engine. Every feature flag is a compile-time
+// constant in the kernels below, so each instantiation keeps only the
+// branches and indicator reads its strategy shape actually uses.
+KERNEL_INLINE void backtest_kernel(Stock stocks[], int stock_count, const Strategy *strategy,
+                                   Portfolio *portfolio, OrderBook *book, const double *const series[],
+                                   int first_day, int end_day, const int use_sma,
+                                   const int use_rsi_entry, const int use_rsi_exit,
+                                   const int use_max_hold) {
+    for (int day = first_day; day < end_day; day++) {
+        for (int s = 0; s < stock_count; s++) {
+            const double *const *cols = series + s * COL_COUNT;
+            double current_price = cols[COL_CLOSE][day];
+
+            if (portfolio->positions[s] > 0) {
+                // Take profit and stop loss are resting orders matched
+                // against the bar's range; the rest are checked at the close
+                if (fill_exit_orders(portfolio, book, &stocks[s], s, day)) continue;
+
+                int holding_days = day - portfolio->buy_day[s];
                 int should_sell = 0;
-                char reason[100] = "";
+                char reason[100];
 
-                if (profit_pct >= strategy.take_profit_pct) {
-                    should_sell = 1;
-                    sprintf(reason, "Take Profit (%.2f%% gain)", profit_pct);
-                } else if (profit_pct <= -strategy.stop_loss_pct) {
-                    should_sell = 1;
-                    sprintf(reason, "Stop Loss (%.2f%% loss)", profit_pct);
-                } else if (holding_days >= strategy.max_holding_days) {
+                if (use_max_hold && holding_days >= strategy->max_holding_days) {
                     should_sell = 1;
                     sprintf(reason, "Max Holding Period (%d days)", holding_days);
-                } else if (strategy.rsi_overbought < 100) {
-                    double rsi = calculate_rsi(close_prices, day, 14);
-                    if (rsi >= strategy.rsi_overbought) {
+                } else if (use_rsi_exit) {
+                    double rsi = cols[COL_RSI][day];
+                    if (rsi >= strategy->rsi_overbought) {
                         should_sell = 1;
                         sprintf(reason, "RSI Overbought (RSI: %.2f)", rsi);
                     }
                 }
 
                 if (should_sell) {
-                    int quantity = portfolio->positions[s];
-                    double total_value = current_price * quantity;
-                    double profit = (current_price - buy_price) * quantity;
-                    
-                    Trade *trade = &portfolio->trades[portfolio->trade_count++];
-                    strcpy(trade->symbol, stocks[s].symbol);
-                    strcpy(trade->date, stocks[s].prices[day].date);
-                    trade->day = day;
-                    strcpy(trade->type, "SELL");
-                    trade->price = current_price;
-                    trade->quantity = quantity;
-                    trade->total_value = total_value;
-                    trade->portfolio_cash_before = portfolio->cash;
-                    portfolio->cash += total_value;
-                    trade->portfolio_cash_after = portfolio->cash;
-                    trade->profit_loss = profit;
-                    strcpy(trade->reason, reason);
-
-                    portfolio->positions[s] = 0;
-                    portfolio->avg_buy_price[s] = 0.0;
-                    portfolio->buy_day[s] = -1;
+                    close_position(portfolio, book, &stocks[s], s, day, current_price, reason);
                 }
             } else {
                 int should_buy = 0;
-                char reason[100] = "";
+                char reason[100];
 
-                if (strategy.sma_short_period > 0 && strategy.sma_long_period > 0) {
-                    double sma_short = calculate_sma(close_prices, day, strategy.sma_short_period);
-                    double sma_long = calculate_sma(close_prices, day, strategy.sma_long_period);
-                    double prev_sma_short = calculate_sma(close_prices, day - 1, strategy.sma_short_period);
-                    double prev_sma_long = calculate_sma(close_prices, day - 1, strategy.sma_long_period);
+                if (use_sma) {
+                    double sma_short = cols[COL_SMA_SHORT][day];
+                    double sma_long = cols[COL_SMA_LONG][day];
+                    double prev_sma_short = cols[COL_SMA_SHORT][day - 1];
+                    double prev_sma_long = cols[COL_SMA_LONG][day - 1];
 
                     if (prev_sma_short <= prev_sma_long && sma_short > sma_long) {
                         should_buy = 1;
@@ -110,389 +553,699 @@ void backtest(Stock stocks[], int stock_count, Strategy strategy, Portfolio *por
                     }
                 }
 
-                if (!should_buy && strategy.rsi_oversold > 0) {
-                    double rsi = calculate_rsi(close_prices, day, 14);
-                    if (rsi <= strategy.rsi_oversold) {
+                if (use_rsi_entry && !should_buy) {
+                    double rsi = cols[COL_RSI][day];
+                    if (rsi <= strategy->rsi_oversold) {
                         should_buy = 1;
                         sprintf(reason, "RSI Oversold (RSI: %.2f)", rsi);
                     }
                 }
 
                 if (should_buy) {
-                    double investment = portfolio->cash * 0.2;
-                    int quantity = (int)(investment / current_price);
-
-                    if (quantity > 0 && portfolio->cash >= current_price * quantity) {
-                        double total_value = current_price * quantity;
-                        
-                        Trade *trade = &portfolio->trades[portfolio->trade_count++];
-                        strcpy(trade->symbol, stocks[s].symbol);
-                        strcpy(trade->date, stocks[s].prices[day].date);
-                        trade->day = day;
-                        strcpy(trade->type, "BUY");
-                        trade->price = current_price;
-                        trade->quantity = quantity;
-                        trade->total_value = total_value;
-                        trade->portfolio_cash_before = portfolio->cash;
-                        portfolio->cash -= total_value;
-                        trade->portfolio_cash_after = portfolio->cash;
-                        trade->profit_loss = 0.0;
-                        strcpy(trade->reason, reason);
-
-                        portfolio->positions[s] = quantity;
-                        portfolio->avg_buy_price[s] = current_price;
-                        portfolio->buy_day[s] = day;
+                    open_position(portfolio, book, &stocks[s], s, day, current_price, strategy, reason);
+                }
+            }
+        }
+    }
+}
+
+typedef void (*BacktestKernel)(Stock stocks[], int stock_count, const Strategy *strategy,
+                               Portfolio *portfolio, OrderBook *book, const double *const series[],
+                               int first_day, int end_day);
+
+#define DEFINE_KERNEL(name, sma, rsi_entry, rsi_exit, max_hold)                           \
+    static void name(Stock stocks[], int stock_count, const Strategy *strategy,           \
+                     Portfolio *portfolio, OrderBook *book, const double *const series[], \
+                     int first_day, int end_day) {                                        \
+        backtest_kernel(stocks, stock_count, strategy, portfolio, book, series,           \
+                        first_day, end_day, sma, rsi_entry, rsi_exit, max_hold);          \
+    }
+
+DEFINE_KERNEL(kernel_0000, 0, 0, 0, 0)
+DEFINE_KERNEL(kernel_0001, 0, 0, 0, 1)
+DEFINE_KERNEL(kernel_0010, 0, 0, 1, 0)
+DEFINE_KERNEL(kernel_0011, 0, 0, 1, 1)
+DEFINE_KERNEL(kernel_0100, 0, 1, 0, 0)
+DEFINE_KERNEL(kernel_0101, 0, 1, 0, 1)
+DEFINE_KERNEL(kernel_0110, 0, 1, 1, 0)
+DEFINE_KERNEL(kernel_0111, 0, 1, 1, 1)
+DEFINE_KERNEL(kernel_1000, 1, 0, 0, 0)
+DEFINE_KERNEL(kernel_1001, 1, 0, 0, 1)
+DEFINE_KERNEL(kernel_1010, 1, 0, 1, 0)
+DEFINE_KERNEL(kernel_1011, 1, 0, 1, 1)
+DEFINE_KERNEL(kernel_1100, 1, 1, 0, 0)
+DEFINE_KERNEL(kernel_1101, 1, 1, 0, 1)
+DEFINE_KERNEL(kernel_1110, 1, 1, 1, 0)
+DEFINE_KERNEL(kernel_1111, 1, 1, 1, 1)
+
+// Indexed by (sma << 3) | (rsi_entry << 2) | (rsi_exit << 1) | max_hold
+static const BacktestKernel kernels[16] = {
+    kernel_0000, kernel_0001, kernel_0010, kernel_0011,
+    kernel_0100, kernel_0101, kernel_0110, kernel_0111,
+    kernel_1000, kernel_1001, kernel_1010, kernel_1011,
+    kernel_1100, kernel_1101, kernel_1110, kernel_1111
+};
+
+int strategy_kernel_index(const Strategy *strategy, int max_days) {
+    int use_sma = strategy->sma_short_period > 0 && strategy->sma_long_period > 0;
+    int use_rsi_entry = strategy->rsi_oversold > 0;
+    int use_rsi_exit = strategy->rsi_overbought < 100;
+    // A holding limit at least as long as the data can never trigger
+    int use_max_hold = strategy->max_holding_days < max_days;
+
+    return (use_sma << 3) | (use_rsi_entry << 2) | (use_rsi_exit << 1) | use_max_hold;
+}
+
+int backtest(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio) {
+    return backtest_range(stocks, stock_count, strategy, portfolio, BACKTEST_FIRST_DAY);
+}
+
+// Runs the strategy over bars [first_day, end of data) on top of whatever
+// state the portfolio already holds, so a run can resume where another
+// stopped. Indicators are windowed, so their state is rebuilt from the
+// bars just before first_day rather than stored.
+int backtest_range(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio,
+                   int first_day) {
+    return backtest_window(stocks, stock_count, strategy, portfolio, first_day, stocks[0].day_count);
+}
+
+// As backtest_range, but stops before end_day. Consecutive windows give the
+// same result as one run over their union. Prints nothing; returns
+// BACKTEST_OK or one of the BACKTEST_ERROR codes.
+int backtest_window(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio,
+                    int first_day, int end_day) {
+    return backtest_window_cached(stocks, stock_count, strategy, portfolio, first_day, end_day, NULL, NULL);
+}
+
+// As backtest_window, reading indicator columns from a shared cache when
+// one is given. fingerprints[s] is stock_fingerprint() of stocks[s].
+int backtest_window_cached(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio,
+                           int first_day, int end_day, IndicatorCache *cache,
+                           const unsigned long long fingerprints[]) {
+    int max_days = stocks[0].day_count;
+    if (end_day > max_days) end_day = max_days;
+    if (first_day < BACKTEST_FIRST_DAY) first_day = BACKTEST_FIRST_DAY;
+    if (first_day >= end_day) return BACKTEST_OK;
+
+    // Protective orders are a function of the open positions
+    OrderBook book;
+    order_book_init(&book);
+    for (int s = 0; s < stock_count; s++) {
+        if (portfolio->positions[s] > 0) {
+            place_exit_orders(&book, s, portfolio, &strategy);
+        }
+    }
+
+    if (strategy.entry_rule[0] != '\0' || strategy.exit_rule[0] != '\0') {
+        CompiledRules rules;
+        char error[128];
+        if (compile_strategy_rules(&strategy, &rules, error, sizeof(error)) != 0) {
+            return BACKTEST_ERROR_RULE;
+        }
+        return backtest_rules(stocks, stock_count, strategy, portfolio, &book, &rules, first_day, end_day,
+                              cache, fingerprints);
+    }
+
+    int kernel = strategy_kernel_index(&strategy, max_days);
+
+    // Only the series the selected kernel reads are loaded
+    const RuleIndicator indicators[COL_COUNT] = {
+        [COL_CLOSE] = { IND_CLOSE, 0 },
+        [COL_SMA_SHORT] = { IND_SMA, strategy.sma_short_period },
+        [COL_SMA_LONG] = { IND_SMA, strategy.sma_long_period },
+        [COL_RSI] = { IND_RSI, 14 }
+    };
+    unsigned needed = 1u << COL_CLOSE;
+    if (kernel & 8) needed |= (1u << COL_SMA_SHORT) | (1u << COL_SMA_LONG);
+    if (kernel & 6) needed |= 1u << COL_RSI;
+
+    RunColumns run;
+    int status = load_run_columns(&run, stocks, stock_count, indicators, COL_COUNT, needed,
+                                  first_day, end_day, cache, fingerprints);
+    if (status != BACKTEST_OK) return status;
+
+    kernels[kernel](stocks, stock_count, &strategy, portfolio, &book, run.columns, first_day, end_day);
+    release_run_columns(&run, cache);
+    return BACKTEST_OK;
+}
+
+int strategy_is_fusable(const Strategy *strategy) {
+    return strategy->entry_rule[0] == '\0' && strategy->exit_rule[0] == '\0';
+}
+
+// Per-strategy state of a fused pass, one lane per strategy. Everything
+// the per-bar screen reads is laid out struct-of-arrays, mirrored from the
+// lane's portfolio and order book, so the screen runs across all lanes at
+// once. Unused signals hold values that can never trigger. All lanes of a
+// pass share one accounting mode, so order levels share one unit.
+typedef struct {
+    int count;
+    int fixed_point;
+    int pair_count;                                 // distinct SMA (short, long) column pairs
+    unsigned char pair_short[BACKTEST_FUSED_WIDTH + 1];
+    unsigned char pair_long[BACKTEST_FUSED_WIDTH + 1];
+    unsigned char crossed[BACKTEST_FUSED_WIDTH + 1];    // per pair, for the current bar
+    unsigned char pair[BACKTEST_FUSED_WIDTH];       // 0 = no SMA entry
+    double rsi_entry[BACKTEST_FUSED_WIDTH];
+    double rsi_exit[BACKTEST_FUSED_WIDTH];
+    int max_hold[BACKTEST_FUSED_WIDTH];
+    unsigned char held[MAX_STOCKS][BACKTEST_FUSED_WIDTH];
+    int buy_day[MAX_STOCKS][BACKTEST_FUSED_WIDTH];
+    double stop_level[MAX_STOCKS][BACKTEST_FUSED_WIDTH];    // nearest resting orders, book units
+    double limit_level[MAX_STOCKS][BACKTEST_FUSED_WIDTH];
+    unsigned char act[BACKTEST_FUSED_WIDTH];
+    const Strategy *strategies[BACKTEST_FUSED_WIDTH];
+    Portfolio *portfolios[BACKTEST_FUSED_WIDTH];
+    OrderBook books[BACKTEST_FUSED_WIDTH];
+} FusedLanes;
+
+// Refreshes lane i's mirror of its position in symbol s
+static void sync_lane(FusedLanes *lanes, int i, int s) {
+    const SymbolOrders *orders = &lanes->books[i].symbols[s];
+    lanes->held[s][i] = lanes->portfolios[i]->positions[s] > 0;
+    lanes->buy_day[s][i] = lanes->portfolios[i]->buy_day[s];
+    lanes->stop_level[s][i] = orders->stop_count > 0 ? orders->stops[orders->stop_count - 1].level : -HUGE_VAL;
+    lanes->limit_level[s][i] = orders->limit_count > 0 ? orders->limits[orders->limit_count - 1].level
+                                                       : HUGE_VAL;
+}
+
+enum { FUSED_COL_CLOSE, FUSED_COL_RSI, FUSED_COL_FIRST_SMA };
+
+// Index of the SMA column for period, adding it if there is room
+static int fused_sma_column(RuleIndicator indicators[], int *count, int period) {
+    for (int c = FUSED_COL_FIRST_SMA; c < *count; c++) {
+        if (indicators[c].period == period) return c;
+    }
+    if (*count == RUN_MAX_COLUMNS) return -1;
+    indicators[*count].kind = IND_SMA;
+    indicators[*count].period = period;
+    return (*count)++;
+}
+
+// Index of the (short, long) column pair, adding it if new
+static int fused_pair(FusedLanes *lanes, int short_col, int long_col) {
+    for (int p = 1; p < lanes->pair_count; p++) {
+        if (lanes->pair_short[p] == short_col && lanes->pair_long[p] == long_col) return p;
+    }
+    lanes->pair_short[lanes->pair_count] = (unsigned char)short_col;
+    lanes->pair_long[lanes->pair_count] = (unsigned char)long_col;
+    return lanes->pair_count++;
+}
+
+// One walk over the (day, symbol) grid for every lane. Each bar's close,
+// range and indicator values are read once and screened against every lane
+// without branching: a lane acts only if it could open, or if its resting
+// orders, holding limit or RSI exit could close its position. Acting lanes
+// then trade exactly as backtest_kernel() would.
+static void fused_pass(Stock stocks[], int stock_count, FusedLanes *lanes, const double *const columns[],
+                       int column_count, int first_day, int end_day) {
+    double now[RUN_MAX_COLUMNS], prev[RUN_MAX_COLUMNS];
+    int n = lanes->count;
+
+    for (int day = first_day; day < end_day; day++) {
+        for (int s = 0; s < stock_count; s++) {
+            const double *const *cols = columns + s * column_count;
+            for (int c = 0; c < column_count; c++) {
+                now[c] = cols[c][day];
+                prev[c] = cols[c][day - 1];
+            }
+            for (int p = 1; p < lanes->pair_count; p++) {
+                lanes->crossed[p] = (prev[lanes->pair_short[p]] <= prev[lanes->pair_long[p]]) &
+                                    (now[lanes->pair_short[p]] > now[lanes->pair_long[p]]);
+            }
+
+            // The bar's range in the book's unit: ticks in fixed-point mode
+            const PriceData *bar = &stocks[s].prices[day];
+            double low = lanes->fixed_point ? (double)price_ticks(bar->low) : bar->low;
+            double high = lanes->fixed_point ? (double)price_ticks(bar->high) : bar->high;
+            double current_price = now[FUSED_COL_CLOSE];
+            double rsi = now[FUSED_COL_RSI];
+            const unsigned char *held = lanes->held[s];
+            const int *buy_day = lanes->buy_day[s];
+            const double *stop_level = lanes->stop_level[s];
+            const double *limit_level = lanes->limit_level[s];
+            int active = 0;
+
+            for (int i = 0; i < n; i++) {
+                int enter = lanes->crossed[lanes->pair[i]] | (rsi <= lanes->rsi_entry[i]);
+                int leave = (stop_level[i] >= low) | (limit_level[i] <= high) |
+                            (day - buy_day[i] >= lanes->max_hold[i]) | (rsi >= lanes->rsi_exit[i]);
+                lanes->act[i] = (unsigned char)(held[i] ? leave : enter);
+                active |= lanes->act[i];
+            }
+            if (!active) continue;
+
+            for (int i = 0; i < n; i++) {
+                if (!lanes->act[i]) continue;
+                Portfolio *portfolio = lanes->portfolios[i];
+                OrderBook *book = &lanes->books[i];
+                char reason[100];
+
+                if (held[i]) {
+                    if (!fill_exit_orders(portfolio, book, &stocks[s], s, day)) {
+                        int holding_days = day - portfolio->buy_day[s];
+                        if (holding_days >= lanes->max_hold[i]) {
+                            sprintf(reason, "Max Holding Period (%d days)", holding_days);
+                            close_position(portfolio, book, &stocks[s], s, day, current_price, reason);
+                        } else if (rsi >= lanes->rsi_exit[i]) {
+                            sprintf(reason, "RSI Overbought (RSI: %.2f)", rsi);
+                            close_position(portfolio, book, &stocks[s], s, day, current_price, reason);
+                        }
+                    }
+                } else {
+                    int p = lanes->pair[i];
+                    if (lanes->crossed[p]) {
+                        sprintf(reason, "SMA Crossover (Short:%.2f > Long:%.2f)",
+                                now[lanes->pair_short[p]], now[lanes->pair_long[p]]);
+                    } else {
+                        sprintf(reason, "RSI Oversold (RSI: %.2f)", rsi);
                     }
+                    open_position(portfolio, book, &stocks[s], s, day, current_price, lanes->strategies[i],
+                                  reason);
                 }
+                sync_lane(lanes, i, s);
             }
         }
     }
 }
 
-void print_detailed_results(Portfolio *portfolio, Stock stocks[], int stock_count, double initial_cash) {
-    printf("\n\n");
-    printf("================================================================================\n");
-    printf("                          DETAILED BACKTEST RESULTS                             \n");
-    printf("================================================================================\n\n");
-
-    printf("COMPLETE TRADE HISTORY:\n");
-    printf("================================================================================\n\n");
-
-    for (int i = 0; i < portfolio->trade_count; i++) {
-        Trade *t = &portfolio->trades[i];
-        
-        printf("TRADE #%d - %s %s\n", i + 1, t->type, t->symbol);
-        printf("--------------------------------------------------------------------------------\n");
-        printf("Date:                    %s (Day %d)\n", t->date, t->day);
-        printf("Reason:                  %s\n", t->reason);
-        printf("Price per Share:         $%.2f\n", t->price);
-        printf("Quantity:                %d shares\n", t->quantity);
-        printf("Total Transaction Value: $%.2f\n", t->total_value);
-        printf("Portfolio Cash Before:   $%.2f\n", t->portfolio_cash_before);
-        printf("Portfolio Cash After:    $%.2f\n", t->portfolio_cash_after);
-        
-        if (strcmp(t->type, "SELL") == 0) {
-            if (t->profit_loss >= 0) {
-                printf("Profit:                  $%.2f ✓\n", t->profit_loss);
-            } else {
-                printf("Loss:                    $%.2f ✗\n", t->profit_loss);
+// Runs fixed-parameter strategies over bars [first_day, end_day), up to
+// BACKTEST_FUSED_WIDTH side by side in each pass, each on its own
+// portfolio. Every lane ends exactly where backtest_window() would have
+// left it. Lanes beyond the pass width, whose SMA periods do not fit in
+// one pass's columns, or whose accounting mode differs, go in a further
+// pass.
+int backtest_fused_window(Stock stocks[], int stock_count, const Strategy *const strategies[],
+                          Portfolio *const portfolios[], int count, int first_day, int end_day,
+                          IndicatorCache *cache, const unsigned long long fingerprints[]) {
+    int max_days = stocks[0].day_count;
+    if (end_day > max_days) end_day = max_days;
+    if (first_day < BACKTEST_FIRST_DAY) first_day = BACKTEST_FIRST_DAY;
+    if (first_day >= end_day || count <= 0) return BACKTEST_OK;
+
+    FusedLanes *lanes = malloc(sizeof(FusedLanes));
+    if (lanes == NULL) return BACKTEST_ERROR_MEMORY;
+
+    int status = BACKTEST_OK;
+    for (int next = 0; next < count && status == BACKTEST_OK;) {
+        RuleIndicator indicators[RUN_MAX_COLUMNS] = {
+            [FUSED_COL_CLOSE] = { IND_CLOSE, 0 },
+            [FUSED_COL_RSI] = { IND_RSI, 14 }
+        };
+        int column_count = FUSED_COL_FIRST_SMA;
+
+        lanes->count = 0;
+        lanes->fixed_point = portfolios[next]->fixed_point;
+        lanes->pair_count = 1;
+        lanes->crossed[0] = 0;
+        for (; next < count && lanes->count < BACKTEST_FUSED_WIDTH &&
+               portfolios[next]->fixed_point == lanes->fixed_point; next++) {
+            const Strategy *strategy = strategies[next];
+            int i = lanes->count;
+            int pair = 0;
+
+            if (strategy->sma_short_period > 0 && strategy->sma_long_period > 0) {
+                int saved = column_count;
+                int short_col = fused_sma_column(indicators, &column_count, strategy->sma_short_period);
+                int long_col = fused_sma_column(indicators, &column_count, strategy->sma_long_period);
+                if (short_col < 0 || long_col < 0) {
+                    column_count = saved;
+                    break;
+                }
+                pair = fused_pair(lanes, short_col, long_col);
+            }
+            lanes->pair[i] = (unsigned char)pair;
+            lanes->rsi_entry[i] = strategy->rsi_oversold > 0 ? strategy->rsi_oversold : -HUGE_VAL;
+            lanes->rsi_exit[i] = strategy->rsi_overbought < 100 ? strategy->rsi_overbought : HUGE_VAL;
+            lanes->max_hold[i] = strategy->max_holding_days < max_days ? strategy->max_holding_days : INT_MAX;
+            lanes->strategies[i] = strategy;
+            lanes->portfolios[i] = portfolios[next];
+
+            // Protective orders are a function of the open positions
+            order_book_init(&lanes->books[i]);
+            for (int s = 0; s < stock_count; s++) {
+                if (portfolios[next]->positions[s] > 0) {
+                    place_exit_orders(&lanes->books[i], s, portfolios[next], strategy);
+                }
+                sync_lane(lanes, i, s);
             }
+            lanes->count++;
         }
-        printf("\n");
+
+        RunColumns run;
+        status = load_run_columns(&run, stocks, stock_count, indicators, column_count, ~0u,
+                                  first_day, end_day, cache, fingerprints);
+        if (status != BACKTEST_OK) break;
+        fused_pass(stocks, stock_count, lanes, run.columns, column_count, first_day, end_day);
+        release_run_columns(&run, cache);
     }
 
-    double portfolio_value = portfolio->cash;
-    int buy_count = 0, sell_count = 0;
-    double total_realized_profit = 0.0;
-    int winning_trades = 0, losing_trades = 0;
-    double total_invested = 0.0;
+    free(lanes);
+    return status;
+}
 
-    for (int i = 0; i < portfolio->trade_count; i++) {
-        Trade *t = &portfolio->trades[i];
-        if (strcmp(t->type, "BUY") == 0) {
-            buy_count++;
-            total_invested += t->total_value;
+// Identity of a strategy's entry behaviour: the parameters that decide
+// when positions open. Variants sharing it differ only in how they exit.
+unsigned long long strategy_entry_hash(const Strategy *strategy) {
+    unsigned long long hash = 14695981039346656037ULL;
+    hash = hash_bytes(hash, &strategy->rsi_oversold, sizeof(double));
+    hash = hash_bytes(hash, &strategy->sma_short_period, sizeof(int));
+    hash = hash_bytes(hash, &strategy->sma_long_period, sizeof(int));
+    return hash;
+}
+
+int strategies_share_entry(const Strategy *a, const Strategy *b) {
+    return strategy_is_fusable(a) && strategy_is_fusable(b) && a->rsi_oversold == b->rsi_oversold &&
+           a->sma_short_period == b->sma_short_period && a->sma_long_period == b->sma_long_period;
+}
+
+// strategies[] must share one entry configuration (strategies_share_entry)
+// and stay valid for the life of the run
+int variant_run_init(VariantRun *run, const Strategy *const strategies[], int count, double initial_cash,
+                     int fixed_point) {
+    memset(run, 0, sizeof(VariantRun));
+    run->count = count;
+    run->strategies = malloc(sizeof(*run->strategies) * (size_t)count);
+    run->nodes = malloc(sizeof(*run->nodes) * (size_t)count);
+    run->node_head = malloc(sizeof(int) * (size_t)count);
+    run->member_node = malloc(sizeof(int) * (size_t)count);
+    run->member_next = malloc(sizeof(int) * (size_t)count);
+    run->member_outcome = malloc(sizeof(int) * (size_t)count);
+    run->outcomes = malloc(sizeof(VariantOutcome) * (size_t)count);
+    run->books = malloc(sizeof(OrderBook) * (size_t)count);
+    if (run->strategies == NULL || run->nodes == NULL || run->node_head == NULL || run->member_node == NULL ||
+        run->member_next == NULL || run->member_outcome == NULL || run->outcomes == NULL ||
+        run->books == NULL || count <= 0 || (run->nodes[0] = malloc(sizeof(Portfolio))) == NULL) {
+        variant_run_free(run);
+        return BACKTEST_ERROR_MEMORY;
+    }
+
+    init_portfolio_mode(run->nodes[0], initial_cash, fixed_point);
+    run->node_count = 1;
+    run->node_head[0] = 0;
+    for (int m = 0; m < count; m++) {
+        run->strategies[m] = strategies[m];
+        run->member_node[m] = 0;
+        run->member_next[m] = m + 1 < count ? m + 1 : -1;
+        order_book_init(&run->books[m]);
+    }
+    return BACKTEST_OK;
+}
+
+void variant_run_free(VariantRun *run) {
+    for (int k = 0; k < run->node_count; k++) free(run->nodes[k]);
+    free(run->strategies);
+    free(run->nodes);
+    free(run->node_head);
+    free(run->member_node);
+    free(run->member_next);
+    free(run->member_outcome);
+    free(run->outcomes);
+    free(run->books);
+    memset(run, 0, sizeof(VariantRun));
+}
+
+// The portfolio member m ended up with; shared by every member whose
+// history never diverged from it
+Portfolio *variant_portfolio(const VariantRun *run, int member) {
+    return run->nodes[run->member_node[member]];
+}
+
+// Copies a node's state for a new branch. Only the logged part of the
+// trade array is copied.
+static Portfolio *fork_portfolio(const Portfolio *source) {
+    Portfolio *copy = malloc(sizeof(Portfolio));
+    if (copy == NULL) return NULL;
+    size_t head = offsetof(Portfolio, trades);
+    size_t tail = offsetof(Portfolio, trade_count);
+    memcpy(copy, source, head);
+    memcpy(copy->trades, source->trades, sizeof(Trade) * (size_t)source->trade_count);
+    memcpy((char *)copy + tail, (const char *)source + tail, sizeof(Portfolio) - tail);
+    return copy;
+}
+
+enum { EXIT_NONE, EXIT_STOP, EXIT_LIMIT, EXIT_MAX_HOLD, EXIT_RSI };
+
+// What one member's exit logic does with a held position this bar, as
+// fill_exit_orders() and the kernel's close checks would decide it.
+// Members with the same kind and fill price produce the same trade.
+static int member_exit(const VariantRun *run, int m, const Portfolio *portfolio, const PriceData *bar,
+                            int s, int day, int max_days, double rsi, double *price) {
+    const SymbolOrders *orders = &run->books[m].symbols[s];
+    const Strategy *strategy = run->strategies[m];
+    double open = portfolio->fixed_point ? (double)price_ticks(bar->open) : bar->open;
+    double high = portfolio->fixed_point ? (double)price_ticks(bar->high) : bar->high;
+    double low = portfolio->fixed_point ? (double)price_ticks(bar->low) : bar->low;
+
+    *price = 0.0;
+    if (orders->stop_count > 0 && orders->stops[orders->stop_count - 1].level >= low) {
+        double level = orders->stops[orders->stop_count - 1].level;
+        *price = open < level ? open : level;
+        return EXIT_STOP;
+    }
+    if (orders->limit_count > 0 && orders->limits[orders->limit_count - 1].level <= high) {
+        double level = orders->limits[orders->limit_count - 1].level;
+        *price = open > level ? open : level;
+        return EXIT_LIMIT;
+    }
+    if (strategy->max_holding_days < max_days && day - portfolio->buy_day[s] >= strategy->max_holding_days) {
+        return EXIT_MAX_HOLD;
+    }
+    if (strategy->rsi_overbought < 100 && rsi >= strategy->rsi_overbought) return EXIT_RSI;
+    return EXIT_NONE;
+}
+
+// Applies one exit decision to a node through member lead's order book;
+// the node's other members drop their orders for the symbol
+static void apply_exit(VariantRun *run, int node, int lead, int kind, Stock *stock, int s, int day,
+                       double current_price, double rsi) {
+    Portfolio *portfolio = run->nodes[node];
+    char reason[100];
+
+    if (kind == EXIT_NONE) return;
+    if (kind == EXIT_STOP || kind == EXIT_LIMIT) {
+        fill_exit_orders(portfolio, &run->books[lead], stock, s, day);
+    } else {
+        if (kind == EXIT_MAX_HOLD) {
+            sprintf(reason, "Max Holding Period (%d days)", day - portfolio->buy_day[s]);
         } else {
-            sell_count++;
-            total_realized_profit += t->profit_loss;
-            if (t->profit_loss > 0) winning_trades++;
-            else losing_trades++;
+            sprintf(reason, "RSI Overbought (RSI: %.2f)", rsi);
+        }
+        close_position(portfolio, &run->books[lead], stock, s, day, current_price, reason);
+    }
+    for (int m = run->node_head[node]; m >= 0; m = run->member_next[m]) {
+        if (m != lead) order_book_cancel(&run->books[m], s, s);
+    }
+}
+
+// Decides a held position for every member of a node. If they all agree
+// the node trades once; otherwise each distinct outcome beyond the first
+// forks the node's state into a new node that carries those members on.
+static int resolve_exits(VariantRun *run, int node, Stock *stock, int s, int day, int max_days,
+                         double current_price, double rsi) {
+    const Portfolio *portfolio = run->nodes[node];
+    const PriceData *bar = &stock->prices[day];
+    VariantOutcome *outcomes = run->outcomes;
+    int outcome_count = 0;
+
+    for (int m = run->node_head[node]; m >= 0; m = run->member_next[m]) {
+        double price;
+        int kind = member_exit(run, m, portfolio, bar, s, day, max_days, rsi, &price);
+        int c = 0;
+        while (c < outcome_count && (outcomes[c].kind != kind || outcomes[c].price != price)) c++;
+        if (c == outcome_count) {
+            outcomes[c].kind = kind;
+            outcomes[c].price = price;
+            outcomes[c].lead = m;
+            outcome_count++;
         }
+        run->member_outcome[m] = c;
+    }
+    if (outcome_count == 1) {
+        apply_exit(run, node, outcomes[0].lead, outcomes[0].kind, stock, s, day, current_price, rsi);
+        return BACKTEST_OK;
     }
 
-    for (int i = 0; i < stock_count; i++) {
-        if (portfolio->positions[i] > 0) {
-            int last_day = stocks[i].day_count - 1;
-            portfolio_value += portfolio->positions[i] * stocks[i].prices[last_day].close;
+    // Branch before anything trades, then split the member list by outcome
+    outcomes[0].node = node;
+    for (int c = 1; c < outcome_count; c++) {
+        Portfolio *copy = fork_portfolio(portfolio);
+        if (copy == NULL) return BACKTEST_ERROR_MEMORY;
+        outcomes[c].node = run->node_count++;
+        run->nodes[outcomes[c].node] = copy;
+        run->forks++;
+    }
+    for (int c = 0; c < outcome_count; c++) outcomes[c].tail = -1;
+    for (int m = run->node_head[node], next; m >= 0; m = next) {
+        VariantOutcome *outcome = &outcomes[run->member_outcome[m]];
+        next = run->member_next[m];
+        if (outcome->tail < 0) run->node_head[outcome->node] = m;
+        else run->member_next[outcome->tail] = m;
+        run->member_next[m] = -1;
+        run->member_node[m] = outcome->node;
+        outcome->tail = m;
+    }
+    for (int c = 0; c < outcome_count; c++) {
+        apply_exit(run, outcomes[c].node, outcomes[c].lead, outcomes[c].kind, stock, s, day,
+                   current_price, rsi);
+    }
+    return BACKTEST_OK;
+}
+
+// Runs every member of a variant run over bars [first_day, end_day).
+// Entries are decided once per bar, and while members agree they share a
+// portfolio, so a grid over exit parameters only pays separately for the
+// bars after its histories diverge. Each member ends exactly where
+// backtest_window() would have left it; consecutive windows continue the
+// same tree.
+int backtest_variants_window(VariantRun *run, Stock stocks[], int stock_count, int first_day, int end_day,
+                             IndicatorCache *cache, const unsigned long long fingerprints[]) {
+    int max_days = stocks[0].day_count;
+    if (end_day > max_days) end_day = max_days;
+    if (first_day < BACKTEST_FIRST_DAY) first_day = BACKTEST_FIRST_DAY;
+    if (first_day >= end_day) return BACKTEST_OK;
+
+    const Strategy *entry = run->strategies[0];
+    int use_sma = entry->sma_short_period > 0 && entry->sma_long_period > 0;
+    int use_rsi_entry = entry->rsi_oversold > 0;
+    int use_rsi = use_rsi_entry;
+    for (int m = 0; m < run->count; m++) {
+        if (run->strategies[m]->rsi_overbought < 100) use_rsi = 1;
+    }
+
+    const RuleIndicator indicators[COL_COUNT] = {
+        [COL_CLOSE] = { IND_CLOSE, 0 },
+        [COL_SMA_SHORT] = { IND_SMA, entry->sma_short_period },
+        [COL_SMA_LONG] = { IND_SMA, entry->sma_long_period },
+        [COL_RSI] = { IND_RSI, 14 }
+    };
+    unsigned needed = 1u << COL_CLOSE;
+    if (use_sma) needed |= (1u << COL_SMA_SHORT) | (1u << COL_SMA_LONG);
+    if (use_rsi) needed |= 1u << COL_RSI;
+
+    RunColumns columns;
+    int status = load_run_columns(&columns, stocks, stock_count, indicators, COL_COUNT, needed,
+                                  first_day, end_day, cache, fingerprints);
+    if (status != BACKTEST_OK) return status;
+
+    for (int day = first_day; day < end_day && status == BACKTEST_OK; day++) {
+        for (int s = 0; s < stock_count && status == BACKTEST_OK; s++) {
+            const double *const *cols = columns.columns + s * COL_COUNT;
+            double current_price = cols[COL_CLOSE][day];
+            double rsi = use_rsi ? cols[COL_RSI][day] : 0.0;
+
+            // Entry signals depend only on the shared entry parameters
+            int should_buy = 0;
+            char reason[100];
+            if (use_sma && cols[COL_SMA_SHORT][day - 1] <= cols[COL_SMA_LONG][day - 1] &&
+                cols[COL_SMA_SHORT][day] > cols[COL_SMA_LONG][day]) {
+                should_buy = 1;
+                sprintf(reason, "SMA Crossover (Short:%.2f > Long:%.2f)", cols[COL_SMA_SHORT][day],
+                        cols[COL_SMA_LONG][day]);
+            } else if (use_rsi_entry && rsi <= entry->rsi_oversold) {
+                should_buy = 1;
+                sprintf(reason, "RSI Oversold (RSI: %.2f)", rsi);
+            }
+
+            // Nodes forked on this bar have already traded it
+            int node_count = run->node_count;
+            for (int k = 0; k < node_count && status == BACKTEST_OK; k++) {
+                Portfolio *portfolio = run->nodes[k];
+                if (portfolio->positions[s] > 0) {
+                    status = resolve_exits(run, k, &stocks[s], s, day, max_days, current_price, rsi);
+                } else if (should_buy) {
+                    int lead = run->node_head[k];
+                    open_position(portfolio, &run->books[lead], &stocks[s], s, day, current_price,
+                                  run->strategies[lead], reason);
+                    if (portfolio->positions[s] == 0) continue;
+                    for (int m = run->member_next[lead]; m >= 0; m = run->member_next[m]) {
+                        place_exit_orders(&run->books[m], s, portfolio, run->strategies[m]);
+                    }
+                }
+            }
         }
     }
 
-    double total_return = portfolio_value - initial_cash;
-    double return_pct = (total_return / initial_cash) * 100.0;
-
-    printf("================================================================================\n");
-    printf("                              PORTFOLIO SUMMARY                                 \n");
-    printf("================================================================================\n\n");
-    printf("Initial Capital:         $%.2f\n", initial_cash);
-    printf("Final Portfolio Value:   $%.2f\n", portfolio_value);
-    printf("Final Cash Balance:      $%.2f\n", portfolio->cash);
-    printf("Total Return:            $%.2f (%.2f%%)\n", total_return, return_pct);
-    printf("Total Realized Profit:   $%.2f\n", total_realized_profit);
-    printf("\n");
-
-    printf("TRADING STATISTICS:\n");
-    printf("--------------------------------------------------------------------------------\n");
-    printf("Total Trades:            %d\n", portfolio->trade_count);
-    printf("Buy Orders:              %d\n", buy_count);
-    printf("Sell Orders:             %d\n", sell_count);
-    printf("Winning Trades:          %d\n", winning_trades);
-    printf("Losing Trades:           %d\n", losing_trades);
-    if (sell_count > 0) {
-        printf("Win Rate:                %.2f%%\n", (double)winning_trades / sell_count * 100.0);
-        printf("Average Profit per Trade: $%.2f\n", total_realized_profit / sell_count);
-    }
-    printf("Total Money Invested:    $%.2f\n", total_invested);
-    printf("\n");
-
-    printf("CURRENT OPEN POSITIONS:\n");
-    printf("--------------------------------------------------------------------------------\n");
-    int has_positions = 0;
+    release_run_columns(&columns, cache);
+    return status;
+}
+
+// Cash plus open positions marked at each symbol's last close
+double portfolio_value(const Portfolio *portfolio, Stock stocks[], int stock_count) {
+    if (portfolio->fixed_point) {
+        long long value = portfolio->cash_ticks;
+        for (int i = 0; i < stock_count; i++) {
+            if (portfolio->positions[i] > 0) {
+                int last_day = stocks[i].day_count - 1;
+                value += portfolio->positions[i] * price_ticks(stocks[i].prices[last_day].close);
+            }
+        }
+        return (double)value / PRICE_SCALE;
+    }
+
+    double value = portfolio->cash;
     for (int i = 0; i < stock_count; i++) {
         if (portfolio->positions[i] > 0) {
-            has_positions = 1;
             int last_day = stocks[i].day_count - 1;
-            double current_price = stocks[i].prices[last_day].close;
-            double current_value = portfolio->positions[i] * current_price;
-            double unrealized = (current_price - portfolio->avg_buy_price[i]) * portfolio->positions[i];
-            double unrealized_pct = (unrealized / (portfolio->avg_buy_price[i] * portfolio->positions[i])) * 100.0;
-            
-            printf("%s:\n", stocks[i].symbol);
-            printf("  Quantity:              %d shares\n", portfolio->positions[i]);
-            printf("  Average Buy Price:     $%.2f\n", portfolio->avg_buy_price[i]);
-            printf("  Current Price:         $%.2f\n", current_price);
-            printf("  Position Value:        $%.2f\n", current_value);
-            printf("  Unrealized P/L:        $%.2f (%.2f%%)\n\n", unrealized, unrealized_pct);
+            value += portfolio->positions[i] * stocks[i].prices[last_day].close;
         }
     }
-    if (!has_positions) {
-        printf("No open positions - All cash\n\n");
-    }
-
-    printf("================================================================================\n");
+    return value;
 }
 
 void calculate_strategy_result(Portfolio *portfolio, Stock stocks[], int stock_count, 
                                double initial_cash, Strategy strategy, 
-                               StrategyResult *result, char *username) {
+                               StrategyResult *result, const char *username) {
     strcpy(result->strategy_name, strategy.name);
     strcpy(result->username, username);
     result->initial_capital = initial_cash;
     
-    double portfolio_value = portfolio->cash;
-    int winning = 0, losing = 0;
-    double realized_profit = 0.0;
-    
-    for (int i = 0; i < stock_count; i++) {
-        if (portfolio->positions[i] > 0) {
-            int last_day = stocks[i].day_count - 1;
-            portfolio_value += portfolio->positions[i] * stocks[i].prices[last_day].close;
-        }
-    }
-    
-    for (int i = 0; i < portfolio->trade_count; i++) {
-        if (strcmp(portfolio->trades[i].type, "SELL") == 0) {
-            realized_profit += portfolio->trades[i].profit_loss;
-            if (portfolio->trades[i].profit_loss > 0) winning++;
-            else losing++;
-        }
-    }
-    
-    result->final_value = portfolio_value;
-    result->total_return = portfolio_value - initial_cash;
+    double value = portfolio_value(portfolio, stocks, stock_count);
+    int winning = portfolio->winning_trades, losing = portfolio->losing_trades;
+
+    // The running totals cover trades past the end of the log as well
+    result->final_value = value;
+    result->total_return = value - initial_cash;
     result->return_pct = (result->total_return / initial_cash) * 100.0;
-    result->total_trades = portfolio->trade_count;
+    result->total_trades = portfolio->trades_made;
     result->winning_trades = winning;
     result->losing_trades = losing;
     result->win_rate = (winning + losing > 0) ? (double)winning / (winning + losing) * 100.0 : 0.0;
-    result->total_realized_profit = realized_profit;
+    result->total_realized_profit = portfolio->realized_profit;
+    result->max_drawdown_pct = portfolio->max_drawdown * 100.0;
 }
 
-void compare_strategies(StrategyResult results[], int result_count) {
-    printf("\n\n");
-    printf("================================================================================\n");
-    printf("                        STRATEGY COMPARISON REPORT                              \n");
-    printf("================================================================================\n\n");
+// The built-in strategies every comparison is run against
+void get_preset_strategies(Strategy presets[PRESET_STRATEGY_COUNT]) {
+    strcpy(presets[0].name, "SMA Crossover");
+    presets[0].sma_short_period = 5;
+    presets[0].sma_long_period = 20;
+    presets[0].rsi_oversold = 0;
+    presets[0].rsi_overbought = 100;
+    presets[0].stop_loss_pct = 5.0;
+    presets[0].take_profit_pct = 10.0;
+    presets[0].max_holding_days = 15;
     
-    int best_idx = 0;
-    for (int i = 1; i < result_count; i++) {
-        if (results[i].return_pct > results[best_idx].return_pct) {
-            best_idx = i;
-        }
-    }
+    strcpy(presets[1].name, "RSI Strategy");
+    presets[1].rsi_oversold = 30;
+    presets[1].rsi_overbought = 70;
+    presets[1].sma_short_period = 0;
+    presets[1].sma_long_period = 0;
+    presets[1].stop_loss_pct = 4.0;
+    presets[1].take_profit_pct = 8.0;
+    presets[1].max_holding_days = 10;
     
-    printf("PERFORMANCE COMPARISON:\n");
-    printf("================================================================================\n\n");
-    
-    for (int i = 0; i < result_count; i++) {
-        StrategyResult *r = &results[i];
-        printf("STRATEGY #%d: %s", i + 1, r->strategy_name);
-        if (i == best_idx) printf(" ⭐ BEST PERFORMER");
-        printf("\n");
-        printf("--------------------------------------------------------------------------------\n");
-        printf("User:                    %s\n", r->username);
-        printf("Initial Capital:         $%.2f\n", r->initial_capital);
-        printf("Final Value:             $%.2f\n", r->final_value);
-        printf("Total Return:            $%.2f (%.2f%%)\n", r->total_return, r->return_pct);
-        printf("Total Trades:            %d\n", r->total_trades);
-        printf("Winning Trades:          %d\n", r->winning_trades);
-        printf("Losing Trades:           %d\n", r->losing_trades);
-        printf("Win Rate:                %.2f%%\n", r->win_rate);
-        printf("Realized Profit:         $%.2f\n", r->total_realized_profit);
-        printf("\n");
-    }
+    strcpy(presets[2].name, "Combined Strategy");
+    presets[2].sma_short_period = 5;
+    presets[2].sma_long_period = 20;
+    presets[2].rsi_oversold = 30;
+    presets[2].rsi_overbought = 70;
+    presets[2].stop_loss_pct = 5.0;
+    presets[2].take_profit_pct = 12.0;
+    presets[2].max_holding_days = 20;
     
-    printf("================================================================================\n");
-    printf("                            RANKING BY RETURN %%                                \n");
-    printf("================================================================================\n\n");
-    
-    StrategyResult sorted[10];
-    memcpy(sorted, results, result_count * sizeof(StrategyResult));
-    
-    for (int i = 0; i < result_count - 1; i++) {
-        for (int j = 0; j < result_count - i - 1; j++) {
-            if (sorted[j].return_pct < sorted[j + 1].return_pct) {
-                StrategyResult temp = sorted[j];
-                sorted[j] = sorted[j + 1];
-                sorted[j + 1] = temp;
-            }
-        }
+    for (int i = 0; i < PRESET_STRATEGY_COUNT; i++) {
+        presets[i].entry_rule[0] = '\0';
+        presets[i].exit_rule[0] = '\0';
     }
-    
-    printf("Rank | Strategy Name                    | Return %%   | Total Return\n");
-    printf("--------------------------------------------------------------------------------\n");
-    for (int i = 0; i < result_count; i++) {
-        printf("%-4d | %-32s | %8.2f%% | $%.2f\n", 
-               i + 1, sorted[i].strategy_name, sorted[i].return_pct, sorted[i].total_return);
-    }
-    printf("\n");
-}
-
-void get_preset_strategy(Strategy *strategy) {
-    int choice;
-    
-    printf("\nSelect Preset Trading Strategy:\n");
-    printf("1. Simple Moving Average Crossover\n");
-    printf("2. RSI-based Strategy\n");
-    printf("3. Combined Strategy (SMA + RSI)\n");
-    printf("Enter choice (1-3): ");
-    scanf("%d", &choice);
-
-    switch (choice) {
-        case 1:
-            strcpy(strategy->name, "SMA Crossover");
-            strategy->sma_short_period = 5;
-            strategy->sma_long_period = 20;
-            strategy->rsi_oversold = 0;
-            strategy->rsi_overbought = 100;
-            strategy->stop_loss_pct = 5.0;
-            strategy->take_profit_pct = 10.0;
-            strategy->max_holding_days = 15;
-            break;
-        case 2:
-            strcpy(strategy->name, "RSI Strategy");
-            strategy->rsi_oversold = 30;
-            strategy->rsi_overbought = 70;
-            strategy->sma_short_period = 0;
-            strategy->sma_long_period = 0;
-            strategy->stop_loss_pct = 4.0;
-            strategy->take_profit_pct = 8.0;
-            strategy->max_holding_days = 10;
-            break;
-        case 3:
-            strcpy(strategy->name, "Combined Strategy");
-            strategy->sma_short_period = 5;
-            strategy->sma_long_period = 20;
-            strategy->rsi_oversold = 30;
-            strategy->rsi_overbought = 70;
-            strategy->stop_loss_pct = 5.0;
-            strategy->take_profit_pct = 12.0;
-            strategy->max_holding_days = 20;
-            break;
-        default:
-            strcpy(strategy->name, "Combined Strategy");
-            strategy->sma_short_period = 5;
-            strategy->sma_long_period = 20;
-            strategy->rsi_oversold = 30;
-            strategy->rsi_overbought = 70;
-            strategy->stop_loss_pct = 5.0;
-            strategy->take_profit_pct = 12.0;
-            strategy->max_holding_days = 20;
-    }
-
-    printf("\n=== STRATEGY CONFIGURED ===\n");
-    printf("Name: %s\n", strategy->name);
-    if (strategy->sma_short_period > 0) {
-        printf("SMA Short Period: %d days\n", strategy->sma_short_period);
-        printf("SMA Long Period: %d days\n", strategy->sma_long_period);
-    }
-    if (strategy->rsi_oversold > 0) {
-        printf("RSI Oversold: %.0f\n", strategy->rsi_oversold);
-        printf("RSI Overbought: %.0f\n", strategy->rsi_overbought);
-    }
-    printf("Stop Loss: %.2f%%\n", strategy->stop_loss_pct);
-    printf("Take Profit: %.2f%%\n", strategy->take_profit_pct);
-    printf("Max Holding: %d days\n", strategy->max_holding_days);
-}
-
-void run_comparison_backtest(Stock stocks[], int stock_count, User *user, double initial_cash) {
-    printf("\n=== RUNNING COMPARISON BACKTEST ===\n");
-    printf("Testing all strategies against the same stock data...\n\n");
-    
-    StrategyResult results[10];
-    int result_count = 0;
-    
-    Strategy preset_strategies[3];
-    
-    strcpy(preset_strategies[0].name, "SMA Crossover");
-    preset_strategies[0].sma_short_period = 5;
-    preset_strategies[0].sma_long_period = 20;
-    preset_strategies[0].rsi_oversold = 0;
-    preset_strategies[0].rsi_overbought = 100;
-    preset_strategies[0].stop_loss_pct = 5.0;
-    preset_strategies[0].take_profit_pct = 10.0;
-    preset_strategies[0].max_holding_days = 15;
-    
-    strcpy(preset_strategies[1].name, "RSI Strategy");
-    preset_strategies[1].rsi_oversold = 30;
-    preset_strategies[1].rsi_overbought = 70;
-    preset_strategies[1].sma_short_period = 0;
-    preset_strategies[1].sma_long_period = 0;
-    preset_strategies[1].stop_loss_pct = 4.0;
-    preset_strategies[1].take_profit_pct = 8.0;
-    preset_strategies[1].max_holding_days = 10;
-    
-    strcpy(preset_strategies[2].name, "Combined Strategy");
-    preset_strategies[2].sma_short_period = 5;
-    preset_strategies[2].sma_long_period = 20;
-    preset_strategies[2].rsi_oversold = 30;
-    preset_strategies[2].rsi_overbought = 70;
-    preset_strategies[2].stop_loss_pct = 5.0;
-    preset_strategies[2].take_profit_pct = 12.0;
-    preset_strategies[2].max_holding_days = 20;
-    
-    for (int i = 0; i < 3; i++) {
-        Portfolio portfolio;
-        portfolio.cash = initial_cash;
-        portfolio.trade_count = 0;
-        for (int j = 0; j < MAX_STOCKS; j++) {
-            portfolio.positions[j] = 0;
-            portfolio.avg_buy_price[j] = 0.0;
-            portfolio.buy_day[j] = -1;
-        }
-        
-        backtest(stocks, stock_count, preset_strategies[i], &portfolio);
-        calculate_strategy_result(&portfolio, stocks, stock_count, initial_cash, 
-                                 preset_strategies[i], &results[result_count], "System");
-        result_count++;
-        printf("Completed: %s\n", preset_strategies[i].name);
-    }
-    
-    for (int i = 0; i < user->strategy_count; i++) {
-        Portfolio portfolio;
-        portfolio.cash = initial_cash;
-        portfolio.trade_count = 0;
-        for (int j = 0; j < MAX_STOCKS; j++) {
-            portfolio.positions[j] = 0;
-            portfolio.avg_buy_price[j] = 0.0;
-            portfolio.buy_day[j] = -1;
-        }
-        
-        backtest(stocks, stock_count, user->custom_strategies[i], &portfolio);
-        calculate_strategy_result(&portfolio, stocks, stock_count, initial_cash, 
-                                 user->custom_strategies[i], &results[result_count], user->username);
-        result_count++;
-        printf("Completed: %s (User: %s)\n", user->custom_strategies[i].name, user->username);
-    }
-    
-    compare_strategies(results, result_count);
 }
\ No newline at end of file
@@ -2,16 +2,80 @@
 #define BACKTEST_H
 
 #include "structures.h"
+#include "indicator_cache.h"
+#include "order_book.h"
+
+// Bars before this one only warm up the indicators
+#define BACKTEST_FIRST_DAY 20
+#define PRESET_STRATEGY_COUNT 3
+// Most strategies one fused pass evaluates
+#define BACKTEST_FUSED_WIDTH 64
+
+// One distinct exit decision while a variant run resolves a bar
+typedef struct {
+    int kind;
+    double price;                       // fill price, in the book's unit
+    int lead;                           // first member taking it
+    int node;
+    int tail;                           // last member relinked onto node
+} VariantOutcome;
+
+// Exit-parameter variants of one entry configuration, run as a tree of
+// shared histories. All members start on one portfolio, and a member moves
+// to a copy of it only on the bar where its exit first differs.
+typedef struct {
+    int count;                          // members
+    const Strategy **strategies;
+    int node_count;                     // distinct histories so far
+    Portfolio **nodes;
+    int *node_head;                     // first member on each node
+    int *member_node;
+    int *member_next;                   // next member on the same node, -1 ends
+    int *member_outcome;
+    VariantOutcome *outcomes;
+    OrderBook *books;                   // per member: its own protective orders
+    int forks;
+} VariantRun;
+
+// Status codes of the backtest runners
+#define BACKTEST_OK 0
+#define BACKTEST_ERROR_MEMORY -1
+#define BACKTEST_ERROR_RULE -2
 
 double calculate_sma(double prices[], int current_day, int period);
 double calculate_rsi(double prices[], int current_day, int period);
-void backtest(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio);
-void print_detailed_results(Portfolio *portfolio, Stock stocks[], int stock_count, double initial_cash);
+long long price_ticks(double price);
+void init_portfolio_mode(Portfolio *portfolio, double initial_cash, int fixed_point);
+int backtest(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio);
+int backtest_range(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio,
+                   int first_day);
+int backtest_window(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio,
+                    int first_day, int end_day);
+int backtest_window_cached(Stock stocks[], int stock_count, Strategy strategy, Portfolio *portfolio,
+                           int first_day, int end_day, IndicatorCache *cache,
+                           const unsigned long long fingerprints[]);
+int strategy_is_fusable(const Strategy *strategy);
+int backtest_fused_window(Stock stocks[], int stock_count, const Strategy *const strategies[],
+                          Portfolio *const portfolios[], int count, int first_day, int end_day,
+                          IndicatorCache *cache, const unsigned long long fingerprints[]);
+unsigned long long strategy_entry_hash(const Strategy *strategy);
+int strategies_share_entry(const Strategy *a, const Strategy *b);
+int variant_run_init(VariantRun *run, const Strategy *const strategies[], int count, double initial_cash,
+                     int fixed_point);
+int backtest_variants_window(VariantRun *run, Stock stocks[], int stock_count, int first_day, int end_day,
+                             IndicatorCache *cache, const unsigned long long fingerprints[]);
+Portfolio *variant_portfolio(const VariantRun *run, int member);
+void variant_run_free(VariantRun *run);
+unsigned long long strategy_hash(const Strategy *strategy);
+int strategies_equal(const Strategy *a, const Strategy *b);
+int dedupe_strategies(const Strategy strategies[], int count, int first[]);
+int strategy_kernel_index(const Strategy *strategy, int max_days);
+double portfolio_value(const Portfolio *portfolio, Stock stocks[], int stock_count);
 void calculate_strategy_result(Portfolio *portfolio, Stock stocks[], int stock_count, 
                                double initial_cash, Strategy strategy, 
-                               StrategyResult *result, char *username);
-void compare_strategies(StrategyResult results[], int result_count);
-void run_comparison_backtest(Stock stocks[], int stock_count, User *user, double initial_cash);
-void get_preset_strategy(Strategy *strategy);
+                               StrategyResult *result, const char *username);
+void share_strategy_result(StrategyResult *result, const StrategyResult *source, const char *name,
+                           const char *username);
+void get_preset_strategies(Strategy presets[PRESET_STRATEGY_COUNT]);
 
 #endif
\ No newline at end of file
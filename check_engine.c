@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libbacktest.h"
+#include "backtest.h"
+#include "market_gen.h"
+#include "scheduler.h"
+#include "sweep.h"
+#include "structures.h"
+
+// Consistency check behind "make check". Every way the engine can run a
+// strategy must leave exactly the portfolio, trade log and result that a
+// plain backtest_window() run leaves. The presets and an exit-parameter
+// grid around each are run alone, fused and as variant runs, in both
+// accounting modes, and then through bt_run_batch with and without a
+// scheduler. Everything is compared field by field, with no tolerance.
+#define CHECK_DATA_PATH "check_engine_data.csv"
+#define CHECK_SYMBOLS 6
+#define CHECK_DAYS 600
+#define CHECK_SEED 20240611ULL
+#define CHECK_INITIAL_CASH 100000.0
+#define CHECK_WORKERS 4
+#define CHECK_MAX_STRATEGIES 256
+#define CHECK_MAX_REPORTS 20
+
+typedef struct {
+    Strategy *strategies;
+    int count;
+    int family_start[PRESET_STRATEGY_COUNT + 1];    // variants of preset f are [start[f], start[f + 1])
+    StrategyResult *expected;
+    Portfolio *reference;
+    Portfolio *candidate;
+    int failures;
+} CheckRun;
+
+static int report_difference(CheckRun *check, const char *label, const char *name, const char *field) {
+    // Only the first few are printed; the count still covers all of them
+    if (check->failures < CHECK_MAX_REPORTS) {
+        printf("  FAIL %s: '%s' differs in %s\n", label, name, field);
+    }
+    check->failures++;
+    return 1;
+}
+
+static int compare_trades(CheckRun *check, const char *label, const char *name, const Trade *a,
+                          const Trade *b) {
+    if (a->symbol_id != b->symbol_id) return report_difference(check, label, name, "trade symbol");
+    if (strcmp(a->date, b->date) != 0) return report_difference(check, label, name, "trade date");
+    if (a->day != b->day) return report_difference(check, label, name, "trade day");
+    if (strcmp(a->type, b->type) != 0) return report_difference(check, label, name, "trade type");
+    if (a->price != b->price) return report_difference(check, label, name, "trade price");
+    if (a->quantity != b->quantity) return report_difference(check, label, name, "trade quantity");
+    if (a->total_value != b->total_value) return report_difference(check, label, name, "trade value");
+    if (a->portfolio_cash_before != b->portfolio_cash_before) {
+        return report_difference(check, label, name, "cash before a trade");
+    }
+    if (a->portfolio_cash_after != b->portfolio_cash_after) {
+        return report_difference(check, label, name, "cash after a trade");
+    }
+    if (a->profit_loss != b->profit_loss) return report_difference(check, label, name, "trade profit/loss");
+    if (strcmp(a->reason, b->reason) != 0) return report_difference(check, label, name, "trade reason");
+    return 0;
+}
+
+static void compare_portfolios(CheckRun *check, const char *label, const char *name, const Portfolio *a,
+                               const Portfolio *b) {
+    if (a->cash != b->cash || a->cash_ticks != b->cash_ticks) {
+        report_difference(check, label, name, "cash");
+        return;
+    }
+    if (a->trade_count != b->trade_count || a->trades_made != b->trades_made ||
+        a->realized_profit != b->realized_profit || a->max_drawdown != b->max_drawdown) {
+        report_difference(check, label, name, "trade count");
+        return;
+    }
+    for (int s = 0; s < MAX_STOCKS; s++) {
+        if (a->positions[s] != b->positions[s] || a->buy_day[s] != b->buy_day[s] ||
+            a->avg_buy_price[s] != b->avg_buy_price[s] || a->avg_buy_ticks[s] != b->avg_buy_ticks[s]) {
+            report_difference(check, label, name, "open positions");
+            return;
+        }
+    }
+    for (int t = 0; t < a->trade_count; t++) {
+        if (compare_trades(check, label, name, &a->trades[t], &b->trades[t])) return;
+    }
+}
+
+static void compare_results(CheckRun *check, const char *label, const StrategyResult *a,
+                            const StrategyResult *b) {
+    const char *name = a->strategy_name;
+    if (strcmp(a->strategy_name, b->strategy_name) != 0) report_difference(check, label, name, "name");
+    else if (strcmp(a->username, b->username) != 0) report_difference(check, label, name, "owner");
+    else if (a->initial_capital != b->initial_capital) report_difference(check, label, name, "initial capital");
+    else if (a->final_value != b->final_value) report_difference(check, label, name, "final value");
+    else if (a->total_return != b->total_return) report_difference(check, label, name, "total return");
+    else if (a->return_pct != b->return_pct) report_difference(check, label, name, "return %");
+    else if (a->total_trades != b->total_trades) report_difference(check, label, name, "total trades");
+    else if (a->winning_trades != b->winning_trades) report_difference(check, label, name, "winning trades");
+    else if (a->losing_trades != b->losing_trades) report_difference(check, label, name, "losing trades");
+    else if (a->win_rate != b->win_rate) report_difference(check, label, name, "win rate");
+    else if (a->total_realized_profit != b->total_realized_profit) {
+        report_difference(check, label, name, "realized profit");
+    } else if (a->max_drawdown_pct != b->max_drawdown_pct) {
+        report_difference(check, label, name, "max drawdown");
+    }
+}
+
+static void print_outcome(const CheckRun *check, const char *label, int before) {
+    printf("%s %s\n", check->failures == before ? "ok  " : "FAIL", label);
+}
+
+// The line-up: each preset followed by an exit grid around it
+static int build_lineup(CheckRun *check) {
+    Strategy presets[PRESET_STRATEGY_COUNT];
+    ExitSweep sweep = { { 2.0, 8.0, 2.0 }, { 4.0, 16.0, 4.0 }, { 5.0, 25.0, 10.0 } };
+
+    get_preset_strategies(presets);
+    check->count = 0;
+    check->strategies = malloc(sizeof(Strategy) * CHECK_MAX_STRATEGIES);
+    if (check->strategies == NULL) return -1;
+    for (int f = 0; f < PRESET_STRATEGY_COUNT; f++) {
+        Strategy *grid;
+        int grid_count = build_exit_sweep(&presets[f], &sweep, &grid);
+        if (grid_count < 0 || check->count + 1 + grid_count > CHECK_MAX_STRATEGIES) {
+            if (grid_count >= 0) free(grid);
+            return -1;
+        }
+        check->family_start[f] = check->count;
+        check->strategies[check->count++] = presets[f];
+        memcpy(&check->strategies[check->count], grid, sizeof(Strategy) * (size_t)grid_count);
+        check->count += grid_count;
+        free(grid);
+    }
+    check->family_start[PRESET_STRATEGY_COUNT] = check->count;
+    return 0;
+}
+
+// Reference: each strategy alone, over the whole history in one window
+static int run_alone(CheckRun *check, const BtDataset *dataset, int fixed_point) {
+    int max_days = dataset->stocks[0].day_count;
+
+    for (int i = 0; i < check->count; i++) {
+        Portfolio *portfolio = &check->reference[i];
+        init_portfolio_mode(portfolio, CHECK_INITIAL_CASH, fixed_point);
+        if (backtest_window(dataset->stocks, dataset->stock_count, check->strategies[i], portfolio,
+                            BACKTEST_FIRST_DAY, max_days) != BACKTEST_OK) {
+            return -1;
+        }
+        calculate_strategy_result(portfolio, dataset->stocks, dataset->stock_count, CHECK_INITIAL_CASH,
+                                  check->strategies[i], &check->expected[i], "-");
+    }
+    return 0;
+}
+
+// Every strategy in one fused call, which splits them into passes itself
+static int check_fused(CheckRun *check, const BtDataset *dataset, IndicatorCache *cache, int fixed_point,
+                       const char *label) {
+    const Strategy **lanes = malloc(sizeof(*lanes) * (size_t)check->count);
+    Portfolio **portfolios = malloc(sizeof(*portfolios) * (size_t)check->count);
+    int before = check->failures, status = -1;
+
+    if (lanes != NULL && portfolios != NULL) {
+        for (int i = 0; i < check->count; i++) {
+            lanes[i] = &check->strategies[i];
+            portfolios[i] = &check->candidate[i];
+            init_portfolio_mode(portfolios[i], CHECK_INITIAL_CASH, fixed_point);
+        }
+        status = backtest_fused_window(dataset->stocks, dataset->stock_count, lanes, portfolios, check->count,
+                                       BACKTEST_FIRST_DAY, dataset->stocks[0].day_count, cache,
+                                       dataset->fingerprints);
+    }
+    if (status == BACKTEST_OK) {
+        for (int i = 0; i < check->count; i++) {
+            compare_portfolios(check, label, check->strategies[i].name, &check->candidate[i],
+                               &check->reference[i]);
+        }
+        print_outcome(check, label, before);
+    }
+    free(lanes);
+    free(portfolios);
+    return status == BACKTEST_OK ? 0 : -1;
+}
+
+// Each preset's exit grid as one variant run
+static int check_variants(CheckRun *check, const BtDataset *dataset, IndicatorCache *cache, int fixed_point,
+                          const char *label) {
+    const Strategy **members = malloc(sizeof(*members) * (size_t)check->count);
+    int before = check->failures;
+
+    if (members == NULL) return -1;
+    for (int f = 0; f < PRESET_STRATEGY_COUNT; f++) {
+        int start = check->family_start[f], count = check->family_start[f + 1] - start;
+        VariantRun run;
+
+        for (int k = 0; k < count; k++) members[k] = &check->strategies[start + k];
+        if (variant_run_init(&run, members, count, CHECK_INITIAL_CASH, fixed_point) != BACKTEST_OK) {
+            free(members);
+            return -1;
+        }
+        int status = backtest_variants_window(&run, dataset->stocks, dataset->stock_count, BACKTEST_FIRST_DAY,
+                                              dataset->stocks[0].day_count, cache, dataset->fingerprints);
+        for (int k = 0; k < count && status == BACKTEST_OK; k++) {
+            compare_portfolios(check, label, members[k]->name, variant_portfolio(&run, k),
+                               &check->reference[start + k]);
+        }
+        variant_run_free(&run);
+        if (status != BACKTEST_OK) {
+            free(members);
+            return -1;
+        }
+    }
+    print_outcome(check, label, before);
+    free(members);
+    return 0;
+}
+
+// The same line-up through the library, in blocks, on one thread or a scheduler
+static int check_batch(CheckRun *check, const BtDataset *dataset, BtRunOptions *options, const char *label) {
+    StrategyResult *results = calloc((size_t)check->count, sizeof(StrategyResult));
+    int before = check->failures;
+
+    if (results == NULL) return -1;
+    int status = bt_run_batch(dataset, check->strategies, check->count, NULL, options, results);
+    if (status == BT_OK) {
+        for (int i = 0; i < check->count; i++) compare_results(check, label, &results[i], &check->expected[i]);
+        print_outcome(check, label, before);
+    } else {
+        printf("FAIL %s: %s\n", label, bt_error_string(status));
+        check->failures++;
+    }
+    free(results);
+    return 0;
+}
+
+// Returns -1 if a run could not be carried out at all
+static int run_checks(CheckRun *check, const BtDataset *dataset, Scheduler *scheduler) {
+    IndicatorCache cache;
+    int status = 0;
+
+    if (indicator_cache_init(&cache, INDICATOR_CACHE_DEFAULT_BUDGET) != 0) return -1;
+    for (int fixed_point = 0; fixed_point <= 1 && status == 0; fixed_point++) {
+        const char *mode = fixed_point ? "fixed point" : "floating point";
+        char label[96];
+
+        status = run_alone(check, dataset, fixed_point);
+        if (status == 0) {
+            snprintf(label, sizeof(label), "fused vs alone, %s", mode);
+            status = check_fused(check, dataset, &cache, fixed_point, label);
+        }
+        if (status == 0) {
+            snprintf(label, sizeof(label), "variants vs alone, %s", mode);
+            status = check_variants(check, dataset, &cache, fixed_point, label);
+        }
+        for (int way = 0; way < 6 && status == 0; way++) {
+            BtRunOptions options;
+            bt_default_options(&options);
+            options.initial_cash = CHECK_INITIAL_CASH;
+            options.fixed_point = fixed_point;
+            options.fused = way % 3 >= 1;
+            options.prefix_sharing = way % 3 == 2;
+            options.scheduler = way >= 3 ? scheduler : NULL;
+            snprintf(label, sizeof(label), "bt_run_batch%s%s%s vs alone, %s",
+                     options.fused ? " fused" : "", options.prefix_sharing ? " with variants" : "",
+                     options.scheduler != NULL ? " on the scheduler" : "", mode);
+            status = check_batch(check, dataset, &options, label);
+        }
+    }
+    indicator_cache_free(&cache);
+    return status;
+}
+
+int main(void) {
+    MarketGenConfig config;
+    BtDataset dataset;
+    SchedulerOptions scheduler_options = { CHECK_WORKERS, SCHEDULER_PIN_NONE };
+    Scheduler scheduler;
+    CheckRun check;
+
+    memset(&check, 0, sizeof(check));
+    default_market_gen_config(&config);
+    config.symbol_count = CHECK_SYMBOLS;
+    config.day_count = CHECK_DAYS;
+    config.seed = CHECK_SEED;
+    if (generate_market_data(&config, CHECK_DATA_PATH) != 0) return 1;
+    int status = bt_dataset_load(&dataset, CHECK_DATA_PATH, NULL);
+    remove(CHECK_DATA_PATH);
+    if (status != BT_OK) {
+        printf("Error loading the check data: %s!\n", bt_error_string(status));
+        return 1;
+    }
+
+    check.expected = malloc(sizeof(StrategyResult) * CHECK_MAX_STRATEGIES);
+    check.reference = malloc(sizeof(Portfolio) * CHECK_MAX_STRATEGIES);
+    check.candidate = malloc(sizeof(Portfolio) * CHECK_MAX_STRATEGIES);
+    if (check.expected == NULL || check.reference == NULL || check.candidate == NULL ||
+        build_lineup(&check) != 0 || scheduler_init(&scheduler, &scheduler_options) != 0) {
+        printf("Error setting up the check!\n");
+        return 1;
+    }
+    printf("Checking %d strategies over %d symbols x %d bars\n", check.count, dataset.stock_count,
+           dataset.stocks[0].day_count);
+
+    status = run_checks(&check, &dataset, &scheduler);
+    scheduler_free(&scheduler);
+    bt_dataset_free(&dataset);
+    free(check.strategies);
+    free(check.expected);
+    free(check.reference);
+    free(check.candidate);
+
+    if (status != 0) {
+        printf("Error running the check!\n");
+        return 1;
+    }
+    if (check.failures > 0) {
+        printf("\n%d differences found\n", check.failures);
+        return 1;
+    }
+    printf("\nAll runs match\n");
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "backtest.h"
+#include "stock_data.h"
+#include "symbols.h"
+#include "structures.h"
+
+#define CHECKPOINT_MAGIC "BTCKPT04"
+
+// End-of-run engine state. The trade log follows the header on disk.
+// Indicator state is not stored: every indicator is a function of a short
+// trailing window, which the resumed run rebuilds from the bars it already
+// has. The fingerprints detect restated history, which invalidates the file.
+// Symbols are stored by name and the per-stock arrays in the order of
+// symbols[]; a stored trade's symbol_id is its index there. Loading maps
+// both onto the current symbol ids, so the stocks may come in any order.
+typedef struct {
+    char magic[8];
+    int trade_size;
+    int stock_count;
+    unsigned long long strategy_hash;
+    double initial_cash;
+    int next_day;                                   // first bar not yet processed
+    char last_date[MAX_DATE];
+    char symbols[MAX_STOCKS][MAX_STOCK_NAME];
+    int covered_days[MAX_STOCKS];
+    unsigned long long fingerprints[MAX_STOCKS];
+    double cash;
+    int positions[MAX_STOCKS];
+    double avg_buy_price[MAX_STOCKS];
+    int buy_day[MAX_STOCKS];
+    int trade_count;
+    int fixed_point;
+    long long cash_ticks;
+    long long avg_buy_ticks[MAX_STOCKS];
+    int trades_made;
+    int winning_trades;
+    int losing_trades;
+    double realized_profit;
+    double peak_equity;
+    double max_drawdown;
+} CheckpointHeader;
+
+static int covered_days(const Stock *stock, int next_day) {
+    return stock->day_count < next_day ? stock->day_count : next_day;
+}
+
+// Position of the stock with this symbol id, or -1
+static int stock_index(Stock stocks[], int stock_count, int symbol_id) {
+    for (int s = 0; s < stock_count; s++) {
+        if (stocks[s].symbol_id == symbol_id) return s;
+    }
+    return -1;
+}
+
+int save_checkpoint(const char *path, Stock stocks[], int stock_count, const Strategy *strategy,
+                    double initial_cash, const Portfolio *portfolio) {
+    CheckpointHeader header;
+    int next_day = stocks[0].day_count;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.trade_size = (int)sizeof(Trade);
+    header.stock_count = stock_count;
+    header.strategy_hash = strategy_hash(strategy);
+    header.initial_cash = initial_cash;
+    header.next_day = next_day;
+    if (next_day > 0) strcpy(header.last_date, stocks[0].prices[next_day - 1].date);
+
+    for (int s = 0; s < stock_count; s++) {
+        strcpy(header.symbols[s], symbol_name(stocks[s].symbol_id));
+        header.covered_days[s] = covered_days(&stocks[s], next_day);
+        header.fingerprints[s] = stock_fingerprint(&stocks[s], header.covered_days[s]);
+    }
+    header.cash = portfolio->cash;
+    memcpy(header.positions, portfolio->positions, sizeof(header.positions));
+    memcpy(header.avg_buy_price, portfolio->avg_buy_price, sizeof(header.avg_buy_price));
+    memcpy(header.buy_day, portfolio->buy_day, sizeof(header.buy_day));
+    header.trade_count = portfolio->trade_count;
+    header.fixed_point = portfolio->fixed_point;
+    header.cash_ticks = portfolio->cash_ticks;
+    memcpy(header.avg_buy_ticks, portfolio->avg_buy_ticks, sizeof(header.avg_buy_ticks));
+    header.trades_made = portfolio->trades_made;
+    header.winning_trades = portfolio->winning_trades;
+    header.losing_trades = portfolio->losing_trades;
+    header.realized_profit = portfolio->realized_profit;
+    header.peak_equity = portfolio->peak_equity;
+    header.max_drawdown = portfolio->max_drawdown;
+
+    // Write to a temporary file and rename, so a crash never leaves a
+    // half-written checkpoint behind
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE *fp = fopen(temp_path, "wb");
+    if (fp == NULL) {
+        printf("Error writing checkpoint '%s'!\n", path);
+        return -1;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for (int t = 0; ok && t < portfolio->trade_count; t++) {
+        Trade trade = portfolio->trades[t];
+        trade.symbol_id = stock_index(stocks, stock_count, trade.symbol_id);
+        ok = fwrite(&trade, sizeof(Trade), 1, fp) == 1;
+    }
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok || rename(temp_path, path) != 0) {
+        printf("Error writing checkpoint '%s'!\n", path);
+        remove(temp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Finds each stored symbol among the stocks. Returns -1 unless every one
+// is there exactly once.
+static int map_stored_symbols(const CheckpointHeader *header, Stock stocks[], int stock_count,
+                              int stock_of[MAX_STOCKS]) {
+    int taken[MAX_STOCKS] = { 0 };
+
+    for (int h = 0; h < stock_count; h++) {
+        char name[MAX_STOCK_NAME];
+        memcpy(name, header->symbols[h], MAX_STOCK_NAME);
+        name[MAX_STOCK_NAME - 1] = '\0';
+
+        int id = symbol_find(name);
+        int s = id >= 0 ? stock_index(stocks, stock_count, id) : -1;
+        if (s < 0 || taken[s]) return -1;
+        taken[s] = 1;
+        stock_of[h] = s;
+    }
+    return 0;
+}
+
+// Restores the portfolio if the checkpoint matches this strategy, the
+// portfolio's accounting mode and the history it covered. Returns 0 and the
+// first bar to process, or -1 if there is no usable checkpoint.
+int load_checkpoint(const char *path, Stock stocks[], int stock_count, const Strategy *strategy,
+                    double initial_cash, Portfolio *portfolio, int *next_day) {
+    CheckpointHeader header;
+    int stock_of[MAX_STOCKS];
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return -1;
+
+    int valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+                memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+                header.trade_size == (int)sizeof(Trade) &&
+                header.stock_count == stock_count &&
+                header.strategy_hash == strategy_hash(strategy) &&
+                header.initial_cash == initial_cash &&
+                header.fixed_point == portfolio->fixed_point &&
+                header.next_day > 0 && header.next_day <= stocks[0].day_count &&
+                header.trade_count >= 0 && header.trade_count <= MAX_TRADES &&
+                header.trades_made >= header.trade_count &&
+                strcmp(header.last_date, stocks[0].prices[header.next_day - 1].date) == 0 &&
+                map_stored_symbols(&header, stocks, stock_count, stock_of) == 0;
+
+    for (int h = 0; valid && h < stock_count; h++) {
+        const Stock *stock = &stocks[stock_of[h]];
+        valid = header.covered_days[h] == covered_days(stock, header.next_day) &&
+                header.fingerprints[h] == stock_fingerprint(stock, header.covered_days[h]);
+    }
+    for (int t = 0; valid && t < header.trade_count; t++) {
+        Trade *trade = &portfolio->trades[t];
+        valid = fread(trade, sizeof(Trade), 1, fp) == 1 && trade->symbol_id >= 0 &&
+                trade->symbol_id < stock_count;
+        if (valid) trade->symbol_id = stocks[stock_of[trade->symbol_id]].symbol_id;
+    }
+    fclose(fp);
+    if (!valid) return -1;
+
+    portfolio->cash = header.cash;
+    for (int h = 0; h < stock_count; h++) {
+        int s = stock_of[h];
+        portfolio->positions[s] = header.positions[h];
+        portfolio->avg_buy_price[s] = header.avg_buy_price[h];
+        portfolio->buy_day[s] = header.buy_day[h];
+        portfolio->avg_buy_ticks[s] = header.avg_buy_ticks[h];
+    }
+    portfolio->trade_count = header.trade_count;
+    portfolio->cash_ticks = header.cash_ticks;
+    portfolio->trades_made = header.trades_made;
+    portfolio->winning_trades = header.winning_trades;
+    portfolio->losing_trades = header.losing_trades;
+    portfolio->realized_profit = header.realized_profit;
+    portfolio->peak_equity = header.peak_equity;
+    portfolio->max_drawdown = header.max_drawdown;
+    *next_day = header.next_day;
+    return 0;
+}
+
+// Brings a strategy's results up to date, processing only bars appended
+// since its last checkpoint. Returns the number of bars processed, or -1
+// if the backtest failed, in which case the checkpoint is left as it was.
+int backtest_incremental(Stock stocks[], int stock_count, Strategy strategy, double initial_cash,
+                         int fixed_point, Portfolio *portfolio, const char *path) {
+    int first_day = BACKTEST_FIRST_DAY;
+    int next_day;
+
+    // Initialized first so the checkpoint can be matched against its mode
+    init_portfolio_mode(portfolio, initial_cash, fixed_point);
+    if (load_checkpoint(path, stocks, stock_count, &strategy, initial_cash, portfolio, &next_day) == 0) {
+        first_day = next_day > BACKTEST_FIRST_DAY ? next_day : BACKTEST_FIRST_DAY;
+    } else {
+        init_portfolio_mode(portfolio, initial_cash, fixed_point);  // a rejected file may have been partly read
+    }
+
+    int max_days = stocks[0].day_count;
+    if (backtest_range(stocks, stock_count, strategy, portfolio, first_day) != BACKTEST_OK) {
+        printf("Error backtesting strategy '%s'!\n", strategy.name);
+        return -1;
+    }
+    save_checkpoint(path, stocks, stock_count, &strategy, initial_cash, portfolio);
+    return max_days > first_day ? max_days - first_day : 0;
+}
@@ -0,0 +1,13 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "structures.h"
+
+int save_checkpoint(const char *path, Stock stocks[], int stock_count, const Strategy *strategy,
+                    double initial_cash, const Portfolio *portfolio);
+int load_checkpoint(const char *path, Stock stocks[], int stock_count, const Strategy *strategy,
+                    double initial_cash, Portfolio *portfolio, int *next_day);
+int backtest_incremental(Stock stocks[], int stock_count, Strategy strategy, double initial_cash,
+                         int fixed_point, Portfolio *portfolio, const char *path);
+
+#endif
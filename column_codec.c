@@ -0,0 +1,555 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "column_codec.h"
+#include "stock_data.h"
+#include "feed_ingest.h"
+#include "backtest.h"
+#include "symbols.h"
+#include "structures.h"
+
+static unsigned long long zigzag(long long value) {
+    return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+static long long unzigzag(unsigned long long value) {
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+static unsigned char *put_varint(unsigned char *p, unsigned long long value) {
+    while (value >= 0x80) {
+        *p++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char)value;
+    return p;
+}
+
+// Returns the position after the varint, or NULL if it runs past end
+static const unsigned char *get_varint(const unsigned char *p, const unsigned char *end,
+                                       unsigned long long *value) {
+    unsigned long long result = 0;
+    int shift = 0;
+    while (p < end && shift < 64) {
+        unsigned char byte = *p++;
+        result |= (unsigned long long)(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            *value = result;
+            return p;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+// Writes value as exactly width decimal digits
+static void put_digits(char *p, int value, int width) {
+    while (width-- > 0) {
+        p[width] = (char)('0' + value % 10);
+        value /= 10;
+    }
+}
+
+// Last calendar day formatted. A later day in the same month only rewrites
+// the day digits, so daily bars skip the calendar arithmetic.
+typedef struct {
+    long long day;
+    int month_day;
+    int month_length;
+    char text[MAX_DATE];
+} DateCache;
+
+static int month_length(int year, int month) {
+    static const int lengths[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return lengths[month - 1] + (month == 2 && leap);
+}
+
+static void format_minutes(DateCache *cache, long long minutes, int has_time, char date[MAX_DATE]) {
+    long long days = minutes >= 0 ? minutes / 1440 : -((-minutes + 1439) / 1440);
+    int minute_of_day = (int)(minutes - days * 1440);
+
+    // month_length is 0 until the first day is formatted
+    if (cache->month_length > 0 && days > cache->day &&
+        days - cache->day <= cache->month_length - cache->month_day) {
+        cache->month_day += (int)(days - cache->day);
+        put_digits(cache->text + 8, cache->month_day, 2);
+        cache->day = days;
+    } else if (cache->month_length == 0 || days != cache->day) {
+        int year, month, day;
+        civil_from_days(days, &year, &month, &day);
+        put_digits(cache->text, (year % 10000 + 10000) % 10000, 4);
+        cache->text[4] = '-';
+        put_digits(cache->text + 5, month, 2);
+        cache->text[7] = '-';
+        put_digits(cache->text + 8, day, 2);
+        cache->day = days;
+        cache->month_day = day;
+        cache->month_length = month_length(year, month);
+    }
+    memcpy(date, cache->text, 10);
+    if (has_time) {
+        date[10] = ' ';
+        put_digits(date + 11, minute_of_day / 60 % 24, 2);
+        date[13] = ':';
+        put_digits(date + 14, minute_of_day % 60, 2);
+        date[16] = '\0';
+    } else {
+        date[10] = '\0';
+    }
+}
+
+// Frame-of-reference packing: values go in frames of CODEC_FRAME_ROWS, each
+// stored as the frame minimum, a bit width, and every value's offset from
+// the minimum in that many bits. One outlier only widens its own frame.
+static unsigned char *put_packed(unsigned char *p, const long long values[], int n) {
+    for (int start = 0; start < n; start += CODEC_FRAME_ROWS) {
+        const long long *frame = values + start;
+        int count = n - start < CODEC_FRAME_ROWS ? n - start : CODEC_FRAME_ROWS;
+        long long min = frame[0], max = frame[0];
+
+        for (int i = 1; i < count; i++) {
+            if (frame[i] < min) min = frame[i];
+            if (frame[i] > max) max = frame[i];
+        }
+        unsigned long long range = (unsigned long long)max - (unsigned long long)min;
+        int width = 0;
+        while (width < 64 && (range >> width) != 0) width++;
+        p = put_varint(p, zigzag(min));
+        *p++ = (unsigned char)width;
+
+        // Values wider than 32 bits go in two pieces so the buffer never overflows
+        unsigned long long bits = 0;
+        int used = 0;
+        for (int i = 0; i < count; i++) {
+            unsigned long long value = (unsigned long long)frame[i] - (unsigned long long)min;
+            for (int left = width; left > 0;) {
+                int take = left < 32 ? left : 32;
+                bits |= (value & ((1ULL << take) - 1)) << used;
+                used += take;
+                value >>= take;
+                left -= take;
+                while (used >= 8) {
+                    *p++ = (unsigned char)bits;
+                    bits >>= 8;
+                    used -= 8;
+                }
+            }
+        }
+        if (used > 0) *p++ = (unsigned char)bits;
+    }
+    return p;
+}
+
+// Returns the position after the frames, or NULL if they run past end
+static const unsigned char *get_packed(const unsigned char *p, const unsigned char *end,
+                                       long long values[], int n) {
+    for (int start = 0; start < n; start += CODEC_FRAME_ROWS) {
+        int count = n - start < CODEC_FRAME_ROWS ? n - start : CODEC_FRAME_ROWS;
+        unsigned long long min;
+
+        if ((p = get_varint(p, end, &min)) == NULL || p == end || *p > 64) return NULL;
+        int width = *p++;
+        if ((size_t)(end - p) < ((size_t)count * (size_t)width + 7) / 8) return NULL;
+
+        // The low 32 bits of each value, then any above them
+        int low = width < 32 ? width : 32;
+        int high = width - low;
+        unsigned long long low_mask = (1ULL << low) - 1;
+        unsigned long long high_mask = (1ULL << high) - 1;
+        unsigned long long base = (unsigned long long)unzigzag(min);
+        unsigned long long bits = 0;
+        int used = 0;
+        for (int i = 0; i < count; i++) {
+            while (used < low) {
+                bits |= (unsigned long long)*p++ << used;
+                used += 8;
+            }
+            unsigned long long value = bits & low_mask;
+            bits >>= low;
+            used -= low;
+            if (high > 0) {
+                while (used < high) {
+                    bits |= (unsigned long long)*p++ << used;
+                    used += 8;
+                }
+                value |= (bits & high_mask) << 32;
+                bits >>= high;
+                used -= high;
+            }
+            values[start + i] = (long long)(base + value);
+        }
+    }
+    return p;
+}
+
+static long long body_top(long long open, long long close) {
+    return open > close ? open : close;
+}
+
+static long long body_bottom(long long open, long long close) {
+    return open < close ? open : close;
+}
+
+// Rows of the block being built, already converted to integers
+typedef struct {
+    FILE *out;
+    CompressedBlockHeader header;
+    long long minutes[CODEC_BLOCK_ROWS];
+    long long open[CODEC_BLOCK_ROWS];
+    long long high[CODEC_BLOCK_ROWS];
+    long long low[CODEC_BLOCK_ROWS];
+    long long close[CODEC_BLOCK_ROWS];
+    long long volume[CODEC_BLOCK_ROWS];
+    long long column[CODEC_BLOCK_ROWS];     // deltas or offsets being packed
+    unsigned char payload[CODEC_MAX_PAYLOAD];
+} BlockWriter;
+
+static int flush_block(BlockWriter *writer, CodecStats *stats) {
+    CompressedBlockHeader *header = &writer->header;
+    int n = header->row_count;
+    if (n == 0) return 0;
+
+    unsigned char *p = writer->payload;
+
+    // Dates: (delta, run length) pairs; daily data is mostly runs of 1 and 3
+    for (int i = 1; i < n;) {
+        long long delta = writer->minutes[i] - writer->minutes[i - 1];
+        int run = 1;
+        while (i + run < n && writer->minutes[i + run] - writer->minutes[i + run - 1] == delta) run++;
+        p = put_varint(p, zigzag(delta));
+        p = put_varint(p, (unsigned long long)run);
+        i += run;
+    }
+
+    // Closes and volumes: the first value, then the packed deltas
+    long long *column = writer->column;
+    p = put_varint(p, zigzag(writer->close[0]));
+    for (int i = 1; i < n; i++) column[i - 1] = writer->close[i] - writer->close[i - 1];
+    p = put_packed(p, column, n - 1);
+    // Opens against the previous close (the first against its own), highs
+    // and lows against the body of the bar, all of which stay small
+    for (int i = 0; i < n; i++) column[i] = writer->open[i] - writer->close[i > 0 ? i - 1 : 0];
+    p = put_packed(p, column, n);
+    for (int i = 0; i < n; i++) column[i] = writer->high[i] - body_top(writer->open[i], writer->close[i]);
+    p = put_packed(p, column, n);
+    for (int i = 0; i < n; i++) column[i] = body_bottom(writer->open[i], writer->close[i]) - writer->low[i];
+    p = put_packed(p, column, n);
+    p = put_varint(p, zigzag(writer->volume[0]));
+    for (int i = 1; i < n; i++) column[i - 1] = writer->volume[i] - writer->volume[i - 1];
+    p = put_packed(p, column, n - 1);
+
+    header->byte_count = (int)(p - writer->payload);
+    header->first_minute = writer->minutes[0];
+    header->last_minute = writer->minutes[n - 1];
+    if (fwrite(header, sizeof(*header), 1, writer->out) != 1 ||
+        fwrite(writer->payload, 1, (size_t)header->byte_count, writer->out) != (size_t)header->byte_count) {
+        return -1;
+    }
+
+    stats->rows += n;
+    stats->blocks++;
+    stats->bytes_out += (long long)sizeof(*header) + header->byte_count;
+    header->row_count = 0;
+    return 0;
+}
+
+// Adds one bar, flushing the block when it is full or the symbol changes
+static int add_block_row(BlockWriter *writer, CodecStats *stats, int symbol_id, long long minutes,
+                         int has_time, const PriceData *data) {
+    CompressedBlockHeader *header = &writer->header;
+    const char *symbol = symbol_name(symbol_id);
+
+    if (header->row_count == CODEC_BLOCK_ROWS ||
+        (header->row_count > 0 && (strcmp(header->symbol, symbol) != 0 || header->has_time != has_time))) {
+        if (flush_block(writer, stats) != 0) return -1;
+    }
+    if (header->row_count == 0) {
+        memset(header, 0, sizeof(*header));
+        strcpy(header->symbol, symbol);
+        header->has_time = has_time;
+    }
+
+    int i = header->row_count++;
+    writer->minutes[i] = minutes;
+    writer->open[i] = price_ticks(data->open);
+    writer->high[i] = price_ticks(data->high);
+    writer->low[i] = price_ticks(data->low);
+    writer->close[i] = price_ticks(data->close);
+    writer->volume[i] = data->volume;
+    return 0;
+}
+
+static int start_output(BlockWriter *writer, CompressedFileHeader *file_header, CodecStats *stats) {
+    memset(file_header, 0, sizeof(*file_header));
+    memcpy(file_header->magic, COMPRESSED_MAGIC, sizeof(file_header->magic));
+    file_header->block_rows = CODEC_BLOCK_ROWS;
+    file_header->price_scale = PRICE_SCALE;
+
+    memset(stats, 0, sizeof(CodecStats));
+    memset(&writer->header, 0, sizeof(writer->header));
+    stats->bytes_out = sizeof(*file_header);
+    return fwrite(file_header, sizeof(*file_header), 1, writer->out) == 1 ? 0 : -1;
+}
+
+// Streams rows straight into blocks while the CSV is grouped by symbol and
+// in date order. Returns 1, having written nothing final, at the first row
+// that breaks that order.
+static int stream_grouped_rows(FILE *in, BlockWriter *writer, CodecStats *stats) {
+    unsigned char *finished = calloc(MAX_SYMBOLS, 1);
+    int current = -1;
+    long long last_minutes = 0;
+    char line[256];
+
+    if (finished == NULL) return -1;
+    if (fgets(line, sizeof(line), in) != NULL) stats->bytes_in += (long long)strlen(line);
+
+    while (fgets(line, sizeof(line), in)) {
+        char symbol[MAX_STOCK_NAME];
+        PriceData data;
+        long long minutes;
+        int has_time, symbol_id;
+
+        stats->bytes_in += (long long)strlen(line);
+        if (sscanf(line, "%19[^,],%19[^,],%lf,%lf,%lf,%lf,%d",
+                   symbol, data.date, &data.open, &data.high, &data.low, &data.close, &data.volume) != 7 ||
+            date_to_minutes(data.date, &minutes, &has_time) != 0 || (symbol_id = symbol_intern(symbol)) < 0) {
+            continue;
+        }
+        if (symbol_id != current) {
+            if (current >= 0) finished[current] = 1;
+            if (finished[symbol_id]) break;
+            current = symbol_id;
+        } else if (minutes < last_minutes) {
+            break;
+        }
+        last_minutes = minutes;
+        if (add_block_row(writer, stats, symbol_id, minutes, has_time, &data) != 0) {
+            free(finished);
+            return -1;
+        }
+    }
+    free(finished);
+    if (!feof(in)) return ferror(in) ? -1 : 1;
+    return flush_block(writer, stats);
+}
+
+// Regroups a CSV in any order through the feed ingester, which holds the
+// whole file in memory
+static int write_regrouped_rows(FILE *in, BlockWriter *writer, CodecStats *stats) {
+    FeedTable table;
+    if (feed_read_csv(in, 0, &table) != 0) return -1;
+
+    int status = 0;
+    stats->bytes_in = table.bytes;
+    for (int r = 0; r < table.run_count && status == 0; r++) {
+        const FeedRun *run = &table.runs[r];
+        for (long long i = 0; i < run->row_count && status == 0; i++) {
+            const FeedRow *row = &run->rows[i];
+            PriceData data;
+
+            data.open = row->open;
+            data.high = row->high;
+            data.low = row->low;
+            data.close = row->close;
+            data.volume = row->volume;
+            status = add_block_row(writer, stats, row->symbol_id, row->minutes, row->has_time, &data);
+        }
+    }
+    if (status == 0) status = flush_block(writer, stats);
+    feed_table_free(&table);
+    return status;
+}
+
+// Converts a CSV in the stock_data.csv layout. A file grouped by symbol is
+// streamed, holding only one block in memory regardless of input size; any
+// other order (a date-major feed, say) is regrouped first.
+int compress_stock_csv(const char *csv_path, const char *out_path, CodecStats *stats) {
+    FILE *in = fopen(csv_path, "r");
+    if (in == NULL) {
+        printf("Error opening CSV file '%s'!\n", csv_path);
+        return -1;
+    }
+    FILE *out = fopen(out_path, "wb");
+    if (out == NULL) {
+        printf("Error creating '%s'!\n", out_path);
+        fclose(in);
+        return -1;
+    }
+    BlockWriter *writer = malloc(sizeof(BlockWriter));
+    if (writer == NULL) {
+        printf("Error allocating block buffers!\n");
+        fclose(in);
+        fclose(out);
+        return -1;
+    }
+
+    CompressedFileHeader file_header;
+    writer->out = out;
+    int status = start_output(writer, &file_header, stats);
+    if (status == 0) status = stream_grouped_rows(in, writer, stats);
+    if (status == 1) {
+        // Start over: the blocks written so far are discarded
+        rewind(in);
+        status = fseek(out, 0, SEEK_SET) == 0 && ftruncate(fileno(out), 0) == 0
+               ? start_output(writer, &file_header, stats) : -1;
+        if (status == 0) status = write_regrouped_rows(in, writer, stats);
+        stats->regrouped = 1;
+    }
+
+    // Counts are only known at the end
+    file_header.row_count = stats->rows;
+    file_header.block_count = stats->blocks;
+    int ok = status == 0;
+    if (ok && (fseek(out, 0, SEEK_SET) != 0 || fwrite(&file_header, sizeof(file_header), 1, out) != 1)) ok = 0;
+    if (fclose(out) != 0) ok = 0;
+    fclose(in);
+    free(writer);
+
+    if (!ok) {
+        printf("Error writing '%s'!\n", out_path);
+        return -1;
+    }
+    return 0;
+}
+
+int decode_price_block(const CompressedBlockHeader *header, const unsigned char *payload,
+                       PriceData rows[]) {
+    const unsigned char *p = payload;
+    const unsigned char *end = payload + header->byte_count;
+    int n = header->row_count;
+    unsigned long long value;
+    long long minutes = header->first_minute;
+    char symbol[MAX_STOCK_NAME];
+
+    if (n <= 0 || n > CODEC_BLOCK_ROWS) return -1;
+    memcpy(symbol, header->symbol, MAX_STOCK_NAME);
+    symbol[MAX_STOCK_NAME - 1] = '\0';
+    int symbol_id = symbol_intern(symbol);
+    if (symbol_id < 0) return -1;
+
+    DateCache dates;
+    memset(&dates, 0, sizeof(dates));
+    format_minutes(&dates, minutes, header->has_time, rows[0].date);
+    for (int i = 1; i < n;) {
+        unsigned long long run;
+        if ((p = get_varint(p, end, &value)) == NULL || (p = get_varint(p, end, &run)) == NULL ||
+            run == 0 || run > (unsigned long long)(n - i)) {
+            return -1;
+        }
+        long long delta = unzigzag(value);
+        for (unsigned long long r = 0; r < run; r++, i++) {
+            minutes += delta;
+            format_minutes(&dates, minutes, header->has_time, rows[i].date);
+        }
+    }
+
+    // Prices are rebuilt from integer ticks so they round-trip exactly
+    long long close[CODEC_BLOCK_ROWS];
+    long long column[CODEC_BLOCK_ROWS];
+    if ((p = get_varint(p, end, &value)) == NULL || (p = get_packed(p, end, column, n - 1)) == NULL) return -1;
+    close[0] = unzigzag(value);
+    for (int i = 1; i < n; i++) close[i] = close[i - 1] + column[i - 1];
+    for (int i = 0; i < n; i++) rows[i].close = (double)close[i] / PRICE_SCALE;
+
+    long long open[CODEC_BLOCK_ROWS];
+    if ((p = get_packed(p, end, column, n)) == NULL) return -1;
+    for (int i = 0; i < n; i++) {
+        open[i] = close[i > 0 ? i - 1 : 0] + column[i];
+        rows[i].open = (double)open[i] / PRICE_SCALE;
+    }
+    if ((p = get_packed(p, end, column, n)) == NULL) return -1;
+    for (int i = 0; i < n; i++) rows[i].high = (double)(body_top(open[i], close[i]) + column[i]) / PRICE_SCALE;
+    if ((p = get_packed(p, end, column, n)) == NULL) return -1;
+    for (int i = 0; i < n; i++) rows[i].low = (double)(body_bottom(open[i], close[i]) - column[i]) / PRICE_SCALE;
+
+    if ((p = get_varint(p, end, &value)) == NULL || (p = get_packed(p, end, column, n - 1)) == NULL) return -1;
+    long long volume = unzigzag(value);
+    for (int i = 0; i < n; i++) {
+        if (i > 0) volume += column[i - 1];
+        rows[i].volume = (int)volume;
+        rows[i].symbol_id = symbol_id;
+    }
+    return p == end ? 0 : -1;
+}
+
+int load_compressed_stock_data(const char *path, Stock stocks[], int *stock_count) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        printf("Error opening data file '%s'!\n", path);
+        return -1;
+    }
+
+    CompressedFileHeader file_header;
+    if (fread(&file_header, sizeof(file_header), 1, fp) != 1 ||
+        memcmp(file_header.magic, COMPRESSED_MAGIC, sizeof(file_header.magic)) != 0 ||
+        file_header.block_rows > CODEC_BLOCK_ROWS || file_header.price_scale != PRICE_SCALE) {
+        printf("Error: '%s' is not a compatible compressed data file!\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    unsigned char *payload = malloc(CODEC_MAX_PAYLOAD);
+    PriceData *scratch = malloc(sizeof(PriceData) * CODEC_BLOCK_ROWS);
+    if (payload == NULL || scratch == NULL) {
+        printf("Error allocating block buffers!\n");
+        free(payload);
+        free(scratch);
+        fclose(fp);
+        return -1;
+    }
+
+    int stock_idx = -1;
+    int status = 0;
+    CompressedBlockHeader header;
+
+    for (long long b = 0; b < file_header.block_count; b++) {
+        if (fread(&header, sizeof(header), 1, fp) != 1 ||
+            header.row_count <= 0 || header.row_count > CODEC_BLOCK_ROWS ||
+            header.byte_count < 0 || header.byte_count > CODEC_MAX_PAYLOAD ||
+            fread(payload, 1, (size_t)header.byte_count, fp) != (size_t)header.byte_count) {
+            status = -1;
+            break;
+        }
+        header.symbol[MAX_STOCK_NAME - 1] = '\0';
+        int symbol_id = symbol_intern(header.symbol);
+        if (symbol_id < 0) {
+            status = -1;
+            break;
+        }
+
+        if (stock_idx < 0 || stocks[stock_idx].symbol_id != symbol_id) {
+            if (stock_idx + 1 >= MAX_STOCKS) continue;
+            stock_idx++;
+            stocks[stock_idx].symbol_id = symbol_id;
+            stocks[stock_idx].day_count = 0;
+        }
+
+        // Decode in place when the block fits, otherwise keep what does
+        Stock *stock = &stocks[stock_idx];
+        int room = MAX_DAYS - stock->day_count;
+        if (room >= header.row_count) {
+            if (decode_price_block(&header, payload, &stock->prices[stock->day_count]) != 0) {
+                status = -1;
+                break;
+            }
+            stock->day_count += header.row_count;
+        } else if (room > 0) {
+            if (decode_price_block(&header, payload, scratch) != 0) {
+                status = -1;
+                break;
+            }
+            memcpy(&stock->prices[stock->day_count], scratch, sizeof(PriceData) * (size_t)room);
+            stock->day_count = MAX_DAYS;
+        }
+    }
+
+    if (status != 0) printf("Error: '%s' is truncated or corrupt!\n", path);
+    *stock_count = stock_idx + 1;
+    free(payload);
+    free(scratch);
+    fclose(fp);
+    return status;
+}
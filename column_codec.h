@@ -0,0 +1,50 @@
+#ifndef COLUMN_CODEC_H
+#define COLUMN_CODEC_H
+
+#include "structures.h"
+
+// Compressed market data store: a file header followed by independent
+// blocks of up to CODEC_BLOCK_ROWS bars of one symbol. Each block stores
+// its columns one after another: dates as run-length encoded deltas, closes
+// as deltas in ticks, open/high/low as offsets from the close and volume as
+// deltas from the previous bar. Value columns are bit-packed in frames of
+// CODEC_FRAME_ROWS against the frame minimum.
+#define COMPRESSED_MAGIC "BTSTKZ02"
+#define CODEC_BLOCK_ROWS 1024
+#define CODEC_FRAME_ROWS 128
+// Worst case per row: two date varints plus five 64-bit packed values, well
+// above the few bytes per frame header
+#define CODEC_MAX_PAYLOAD (CODEC_BLOCK_ROWS * 7 * 10)
+
+typedef struct {
+    char magic[8];
+    int block_rows;
+    int price_scale;
+    long long row_count;
+    long long block_count;
+} CompressedFileHeader;
+
+typedef struct {
+    char symbol[MAX_STOCK_NAME];
+    int row_count;
+    int byte_count;             // payload size following this header
+    int has_time;               // dates carry "HH:MM"
+    int reserved;
+    long long first_minute;     // first and last bar, minutes since epoch
+    long long last_minute;
+} CompressedBlockHeader;
+
+typedef struct {
+    long long rows;
+    long long blocks;
+    long long bytes_in;
+    long long bytes_out;
+    int regrouped;              // the input was not grouped by symbol
+} CodecStats;
+
+int compress_stock_csv(const char *csv_path, const char *out_path, CodecStats *stats);
+int decode_price_block(const CompressedBlockHeader *header, const unsigned char *payload,
+                       PriceData rows[]);
+int load_compressed_stock_data(const char *path, Stock stocks[], int *stock_count);
+
+#endif
@@ -0,0 +1,366 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "data_index.h"
+#include "column_codec.h"
+#include "stock_data.h"
+#include "symbols.h"
+#include "structures.h"
+
+typedef struct {
+    IndexEntry *entries;
+    long long count;
+    long long capacity;
+} EntryList;
+
+static IndexEntry *new_entry(EntryList *list) {
+    if (list->count == list->capacity) {
+        long long capacity = list->capacity > 0 ? list->capacity * 2 : 256;
+        IndexEntry *grown = realloc(list->entries, sizeof(IndexEntry) * (size_t)capacity);
+        if (grown == NULL) return NULL;
+        list->entries = grown;
+        list->capacity = capacity;
+    }
+    IndexEntry *entry = &list->entries[list->count++];
+    memset(entry, 0, sizeof(IndexEntry));
+    return entry;
+}
+
+// One entry per run of up to INDEX_CSV_CHUNK_ROWS rows of one symbol
+static int index_csv(FILE *fp, EntryList *list) {
+    char line[256];
+    long long offset = 0;
+    IndexEntry *entry = NULL;
+
+    if (fgets(line, sizeof(line), fp) != NULL) offset += (long long)strlen(line);
+
+    while (fgets(line, sizeof(line), fp)) {
+        long long line_offset = offset;
+        char symbol[MAX_STOCK_NAME], date[MAX_DATE];
+        long long minutes;
+
+        offset += (long long)strlen(line);
+        if (sscanf(line, "%19[^,],%19[^,]", symbol, date) != 2 ||
+            date_to_minutes(date, &minutes, NULL) != 0) {
+            continue;
+        }
+
+        if (entry == NULL || entry->row_count == INDEX_CSV_CHUNK_ROWS || strcmp(entry->symbol, symbol) != 0) {
+            if ((entry = new_entry(list)) == NULL) return -1;
+            strcpy(entry->symbol, symbol);
+            entry->offset = line_offset;
+            entry->first_minute = entry->last_minute = minutes;
+        }
+        entry->row_count++;
+        entry->byte_count = offset - entry->offset;
+        if (minutes < entry->first_minute) entry->first_minute = minutes;
+        if (minutes > entry->last_minute) entry->last_minute = minutes;
+    }
+    return 0;
+}
+
+// Binary records are fixed-size, so entries are runs of up to
+// INDEX_CSV_CHUNK_ROWS records of one symbol, as for CSV. A record whose
+// date does not parse stays in its run but does not widen the date span.
+static int index_binary(FILE *fp, EntryList *list) {
+    StockFileHeader file_header;
+    if (fread(&file_header, sizeof(file_header), 1, fp) != 1 ||
+        file_header.record_size != (int)sizeof(StockRecord)) {
+        return -1;
+    }
+
+    StockRecord records[256];
+    long long offset = (long long)sizeof(file_header);
+    long long remaining = file_header.record_count;
+    IndexEntry *entry = NULL;
+
+    while (remaining > 0) {
+        size_t want = remaining < 256 ? (size_t)remaining : 256;
+        size_t got = fread(records, sizeof(StockRecord), want, fp);
+        if (got == 0) break;
+        for (size_t i = 0; i < got; i++, offset += (long long)sizeof(StockRecord)) {
+            PriceData data;
+            const char *symbol = unpack_stock_record(&records[i], &data);
+            long long minutes;
+
+            if (entry == NULL || entry->row_count == INDEX_CSV_CHUNK_ROWS || strcmp(entry->symbol, symbol) != 0) {
+                if ((entry = new_entry(list)) == NULL) return -1;
+                strcpy(entry->symbol, symbol);
+                entry->offset = offset;
+                entry->first_minute = LLONG_MAX;
+                entry->last_minute = LLONG_MIN;
+            }
+            entry->row_count++;
+            entry->byte_count += (long long)sizeof(StockRecord);
+            if (date_to_minutes(data.date, &minutes, NULL) != 0) continue;
+            if (minutes < entry->first_minute) entry->first_minute = minutes;
+            if (minutes > entry->last_minute) entry->last_minute = minutes;
+        }
+        remaining -= (long long)got;
+    }
+    return 0;
+}
+
+// Compressed blocks already carry their symbol and span; only the block
+// headers are read
+static int index_compressed(FILE *fp, EntryList *list) {
+    CompressedFileHeader file_header;
+    if (fread(&file_header, sizeof(file_header), 1, fp) != 1) return -1;
+
+    for (long long b = 0; b < file_header.block_count; b++) {
+        CompressedBlockHeader header;
+        long long offset = (long long)ftell(fp);
+
+        if (fread(&header, sizeof(header), 1, fp) != 1 || header.byte_count < 0 ||
+            fseek(fp, header.byte_count, SEEK_CUR) != 0) {
+            return -1;
+        }
+        IndexEntry *entry = new_entry(list);
+        if (entry == NULL) return -1;
+        memcpy(entry->symbol, header.symbol, MAX_STOCK_NAME - 1);
+        entry->row_count = header.row_count;
+        entry->offset = offset;
+        entry->byte_count = (long long)sizeof(header) + header.byte_count;
+        entry->first_minute = header.first_minute;
+        entry->last_minute = header.last_minute;
+    }
+    return 0;
+}
+
+static int data_identity(const char *data_path, IndexHeader *header) {
+    struct stat info;
+    char magic[8];
+
+    if (stat(data_path, &info) != 0) return -1;
+    FILE *fp = fopen(data_path, "rb");
+    if (fp == NULL) return -1;
+    int has_magic = fread(magic, sizeof(magic), 1, fp) == 1;
+    fclose(fp);
+
+    memset(header, 0, sizeof(IndexHeader));
+    memcpy(header->magic, DATA_INDEX_MAGIC, sizeof(header->magic));
+    header->format = DATA_FORMAT_CSV;
+    if (has_magic && memcmp(magic, COMPRESSED_MAGIC, sizeof(magic)) == 0) {
+        header->format = DATA_FORMAT_COMPRESSED;
+    } else if (has_magic && memcmp(magic, STOCK_BINARY_MAGIC, sizeof(magic)) == 0) {
+        header->format = DATA_FORMAT_BINARY;
+    }
+    header->data_size = (long long)info.st_size;
+    header->data_mtime_ns = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+    return 0;
+}
+
+// Scans the data file and returns a freshly built index (caller frees)
+int build_data_index(const char *data_path, IndexHeader *header, IndexEntry **entries) {
+    EntryList list = { NULL, 0, 0 };
+
+    if (data_identity(data_path, header) != 0) {
+        printf("Error opening data file '%s'!\n", data_path);
+        return -1;
+    }
+    FILE *fp = fopen(data_path, "rb");
+    if (fp == NULL) {
+        printf("Error opening data file '%s'!\n", data_path);
+        return -1;
+    }
+    int status;
+    if (header->format == DATA_FORMAT_COMPRESSED) status = index_compressed(fp, &list);
+    else if (header->format == DATA_FORMAT_BINARY) status = index_binary(fp, &list);
+    else status = index_csv(fp, &list);
+    fclose(fp);
+    if (status != 0) {
+        printf("Error indexing '%s'!\n", data_path);
+        free(list.entries);
+        return -1;
+    }
+
+    header->entry_count = list.count;
+    *entries = list.entries;
+    return 0;
+}
+
+// Reads the sidecar index, rebuilding and rewriting it if it is missing or
+// was built for a different version of the data file
+int load_data_index(const char *data_path, IndexHeader *header, IndexEntry **entries) {
+    char index_path[512];
+    IndexHeader expected, stored;
+
+    if (data_identity(data_path, &expected) != 0) {
+        printf("Error opening data file '%s'!\n", data_path);
+        return -1;
+    }
+    snprintf(index_path, sizeof(index_path), "%s.idx", data_path);
+
+    FILE *fp = fopen(index_path, "rb");
+    if (fp != NULL) {
+        if (fread(&stored, sizeof(stored), 1, fp) == 1 &&
+            memcmp(stored.magic, DATA_INDEX_MAGIC, sizeof(stored.magic)) == 0 &&
+            stored.format == expected.format && stored.data_size == expected.data_size &&
+            stored.data_mtime_ns == expected.data_mtime_ns && stored.entry_count >= 0) {
+            *entries = malloc(sizeof(IndexEntry) * (size_t)(stored.entry_count + 1));
+            if (*entries != NULL &&
+                fread(*entries, sizeof(IndexEntry), (size_t)stored.entry_count, fp) == (size_t)stored.entry_count) {
+                fclose(fp);
+                *header = stored;
+                return 0;
+            }
+            free(*entries);
+        }
+        fclose(fp);
+    }
+
+    if (build_data_index(data_path, header, entries) != 0) return -1;
+
+    // A read-only location just means the index is rebuilt next time
+    fp = fopen(index_path, "wb");
+    if (fp != NULL) {
+        int ok = fwrite(header, sizeof(IndexHeader), 1, fp) == 1 &&
+                 fwrite(*entries, sizeof(IndexEntry), (size_t)header->entry_count, fp) ==
+                     (size_t)header->entry_count;
+        if (fclose(fp) != 0 || !ok) remove(index_path);
+    }
+    return 0;
+}
+
+static int symbol_selected(const char *symbol, const char *const symbols[], int symbol_count) {
+    if (symbol_count == 0) return 1;
+    for (int i = 0; i < symbol_count; i++) {
+        if (strcmp(symbols[i], symbol) == 0) return 1;
+    }
+    return 0;
+}
+
+static void keep_row(Stock stocks[], int *stock_idx, int symbol_id, const PriceData *row,
+                     long long from, long long to, int whole_chunk, SubsetStats *stats) {
+    long long minutes;
+    if (!whole_chunk && (date_to_minutes(row->date, &minutes, NULL) != 0 || minutes < from || minutes > to)) {
+        return;
+    }
+    // Rows of an interleaved CSV rejoin the stock their symbol already has
+    int s = 0;
+    while (s <= *stock_idx && stocks[s].symbol_id != symbol_id) s++;
+    if (s <= *stock_idx) {
+        append_price_row(stocks, &s, symbol_id, row);
+    } else {
+        append_price_row(stocks, stock_idx, symbol_id, row);
+    }
+    stats->rows_kept++;
+}
+
+// Loads only the chunks holding the requested symbols (all if symbol_count
+// is 0) within [from_date, to_date] (either may be NULL for open-ended).
+// Dates without a time cover the whole day.
+int load_stock_subset(const char *data_path, const char *const symbols[], int symbol_count,
+                      const char *from_date, const char *to_date, Stock stocks[],
+                      int *stock_count, SubsetStats *stats) {
+    long long from = LLONG_MIN, to = LLONG_MAX;
+    int has_time;
+
+    if ((from_date != NULL && date_to_minutes(from_date, &from, NULL) != 0) ||
+        (to_date != NULL && date_to_minutes(to_date, &to, &has_time) != 0)) {
+        printf("Error: dates must be YYYY-MM-DD or YYYY-MM-DD HH:MM!\n");
+        return -1;
+    }
+    if (to_date != NULL && !has_time) to += 1439;
+
+    IndexHeader header;
+    IndexEntry *entries;
+    if (load_data_index(data_path, &header, &entries) != 0) return -1;
+
+    FILE *fp = fopen(data_path, "rb");
+    unsigned char *buffer = malloc(CODEC_MAX_PAYLOAD + 1);
+    PriceData *rows = malloc(sizeof(PriceData) * CODEC_BLOCK_ROWS);
+    if (fp == NULL || buffer == NULL || rows == NULL) {
+        printf("Error opening data file '%s'!\n", data_path);
+        if (fp != NULL) fclose(fp);
+        free(buffer);
+        free(rows);
+        free(entries);
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(SubsetStats));
+    stats->chunks_total = (int)header.entry_count;
+    int stock_idx = -1;
+    int status = 0;
+
+    for (long long e = 0; e < header.entry_count && status == 0; e++) {
+        IndexEntry *entry = &entries[e];
+        if (entry->last_minute < from || entry->first_minute > to ||
+            !symbol_selected(entry->symbol, symbols, symbol_count)) {
+            continue;
+        }
+        int whole_chunk = entry->first_minute >= from && entry->last_minute <= to;
+        stats->chunks_read++;
+
+        if (header.format == DATA_FORMAT_COMPRESSED) {
+            CompressedBlockHeader block;
+            if (fseek(fp, entry->offset, SEEK_SET) != 0 || fread(&block, sizeof(block), 1, fp) != 1 ||
+                block.byte_count < 0 || block.byte_count > CODEC_MAX_PAYLOAD ||
+                fread(buffer, 1, (size_t)block.byte_count, fp) != (size_t)block.byte_count ||
+                decode_price_block(&block, buffer, rows) != 0) {
+                status = -1;
+                break;
+            }
+            for (int i = 0; i < block.row_count; i++) {
+                keep_row(stocks, &stock_idx, rows[i].symbol_id, &rows[i], from, to, whole_chunk, stats);
+            }
+            continue;
+        }
+
+        if (header.format == DATA_FORMAT_BINARY) {
+            StockRecord *records = NULL;
+            if (entry->row_count < 0 || entry->row_count > INDEX_CSV_CHUNK_ROWS ||
+                (records = malloc(sizeof(StockRecord) * (size_t)(entry->row_count + 1))) == NULL ||
+                fseek(fp, entry->offset, SEEK_SET) != 0 ||
+                fread(records, sizeof(StockRecord), (size_t)entry->row_count, fp) != (size_t)entry->row_count) {
+                free(records);
+                status = -1;
+                break;
+            }
+            for (int i = 0; i < entry->row_count; i++) {
+                PriceData data;
+                const char *symbol = unpack_stock_record(&records[i], &data);
+                keep_row(stocks, &stock_idx, symbol_intern(symbol), &data, from, to, whole_chunk, stats);
+            }
+            free(records);
+            continue;
+        }
+
+        // CSV chunks are bounded by INDEX_CSV_CHUNK_ROWS lines
+        char *text = malloc((size_t)entry->byte_count + 1);
+        if (text == NULL || fseek(fp, entry->offset, SEEK_SET) != 0 ||
+            fread(text, 1, (size_t)entry->byte_count, fp) != (size_t)entry->byte_count) {
+            free(text);
+            status = -1;
+            break;
+        }
+        text[entry->byte_count] = '\0';
+
+        for (char *line = text; *line != '\0';) {
+            char *newline = strchr(line, '\n');
+            if (newline != NULL) *newline = '\0';
+
+            char symbol[MAX_STOCK_NAME];
+            PriceData data;
+            if (sscanf(line, "%19[^,],%19[^,],%lf,%lf,%lf,%lf,%d", symbol, data.date, &data.open,
+                       &data.high, &data.low, &data.close, &data.volume) == 7) {
+                keep_row(stocks, &stock_idx, symbol_intern(symbol), &data, from, to, whole_chunk, stats);
+            }
+            if (newline == NULL) break;
+            line = newline + 1;
+        }
+        free(text);
+    }
+
+    if (status != 0) printf("Error: '%s' does not match its index!\n", data_path);
+    *stock_count = stock_idx + 1;
+    fclose(fp);
+    free(buffer);
+    free(rows);
+    free(entries);
+    return status;
+}
@@ -0,0 +1,48 @@
+#ifndef DATA_INDEX_H
+#define DATA_INDEX_H
+
+#include "structures.h"
+
+// Sidecar index ("<data file>.idx") over a CSV, binary or compressed market
+// data file: one entry per chunk of consecutive rows of one symbol, with the
+// chunk's byte range and date span. Rebuilt when the data file changes.
+#define DATA_INDEX_MAGIC "BTINDEX2"
+#define INDEX_CSV_CHUNK_ROWS 1024
+
+typedef enum {
+    DATA_FORMAT_CSV,
+    DATA_FORMAT_COMPRESSED,
+    DATA_FORMAT_BINARY
+} DataFormat;
+
+typedef struct {
+    char symbol[MAX_STOCK_NAME];
+    int row_count;
+    long long offset;           // CSV: first line; binary: first record; compressed: block header
+    long long byte_count;       // CSV: bytes of the chunk's lines; binary: of its records
+    long long first_minute;     // date span, minutes since epoch
+    long long last_minute;
+} IndexEntry;
+
+typedef struct {
+    char magic[8];
+    int format;
+    int reserved;
+    long long data_size;        // identity of the indexed file
+    long long data_mtime_ns;    // nanoseconds, so a rewrite within the same second is caught
+    long long entry_count;
+} IndexHeader;
+
+typedef struct {
+    int chunks_read;
+    int chunks_total;
+    long long rows_kept;
+} SubsetStats;
+
+int build_data_index(const char *data_path, IndexHeader *header, IndexEntry **entries);
+int load_data_index(const char *data_path, IndexHeader *header, IndexEntry **entries);
+int load_stock_subset(const char *data_path, const char *const symbols[], int symbol_count,
+                      const char *from_date, const char *to_date, Stock stocks[],
+                      int *stock_count, SubsetStats *stats);
+
+#endif
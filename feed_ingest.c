@@ -0,0 +1,408 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "feed_ingest.h"
+#include "stock_data.h"
+#include "symbols.h"
+#include "structures.h"
+
+typedef struct {
+    FeedRow *rows;
+    long long count;
+    long long capacity;
+} RowBucket;
+
+// Phase 1: parses one line-aligned slice into a bucket per partition
+typedef struct {
+    const char *text;
+    size_t begin;
+    size_t end;
+    int partition_count;
+    RowBucket *buckets;
+    long long rows;
+    long long rejected;
+    int failed;
+} ParseWorker;
+
+// Phase 2: gathers one partition from every slice and sorts it
+typedef struct {
+    ParseWorker *parsers;
+    int parser_count;
+    int partition;
+    FeedRow *rows;
+    long long row_count;
+    FeedRun *runs;
+    int run_count;
+    int failed;
+} GroupWorker;
+
+static int partition_of(int symbol_id, int partition_count) {
+    return (int)(((unsigned int)symbol_id * 2654435761u) % (unsigned int)partition_count);
+}
+
+static FeedRow *bucket_push(RowBucket *bucket) {
+    if (bucket->count == bucket->capacity) {
+        long long capacity = bucket->capacity > 0 ? bucket->capacity * 2 : 1024;
+        FeedRow *grown = realloc(bucket->rows, sizeof(FeedRow) * (size_t)capacity);
+        if (grown == NULL) return NULL;
+        bucket->rows = grown;
+        bucket->capacity = capacity;
+    }
+    return &bucket->rows[bucket->count++];
+}
+
+// Copies the text up to the next comma; -1 if it is empty or too long,
+// as the "%19[^,]," conversion would fail
+static int take_field(char **p, char *out, size_t size) {
+    char *comma = strchr(*p, ',');
+    size_t length = comma != NULL ? (size_t)(comma - *p) : 0;
+    if (comma == NULL || length == 0 || length >= size) return -1;
+    memcpy(out, *p, length);
+    out[length] = '\0';
+    *p = comma + 1;
+    return 0;
+}
+
+static int take_number(char **p, double *value) {
+    char *end;
+    *value = strtod(*p, &end);
+    if (end == *p || *end != ',') return -1;
+    *p = end + 1;
+    return 0;
+}
+
+static int digits(const char *p, int count) {
+    int value = 0;
+    for (int i = 0; i < count; i++) {
+        if (p[i] < '0' || p[i] > '9') return -1;
+        value = value * 10 + (p[i] - '0');
+    }
+    return value;
+}
+
+// "YYYY-MM-DD" and "YYYY-MM-DD HH:MM" directly; anything else through date_to_minutes
+static int date_key(const char *date, long long *minutes, int *has_time) {
+    size_t length = strlen(date);
+    int year = digits(date, 4), month = length >= 10 ? digits(date + 5, 2) : -1;
+    int day = length >= 10 ? digits(date + 8, 2) : -1;
+    if ((length == 10 || (length == 16 && date[10] == ' ' && date[13] == ':')) &&
+        date[4] == '-' && date[7] == '-' && year >= 0 && month >= 0 && day >= 0) {
+        int hour = length == 16 ? digits(date + 11, 2) : 0;
+        int minute = length == 16 ? digits(date + 14, 2) : 0;
+        if (hour >= 0 && minute >= 0) {
+            *minutes = days_from_civil(year, month, day) * 1440 + hour * 60 + minute;
+            *has_time = length == 16;
+            return 0;
+        }
+    }
+    return date_to_minutes(date, minutes, has_time);
+}
+
+// Reads "Symbol,Date,Open,High,Low,Close,Volume" without sscanf, which
+// costs more than everything else on the row put together
+static int parse_row(char *line, char symbol[MAX_STOCK_NAME], FeedRow *row) {
+    char *p = line;
+    if (take_field(&p, symbol, MAX_STOCK_NAME) != 0 || take_field(&p, row->date, MAX_DATE) != 0 ||
+        take_number(&p, &row->open) != 0 || take_number(&p, &row->high) != 0 ||
+        take_number(&p, &row->low) != 0 || take_number(&p, &row->close) != 0) {
+        return -1;
+    }
+    char *end;
+    long parsed = strtol(p, &end, 10);
+    if (end == p) return -1;
+    row->volume = (int)parsed;
+    return date_key(row->date, &row->minutes, &row->has_time);
+}
+
+static void *parse_worker_main(void *arg) {
+    ParseWorker *worker = (ParseWorker *)arg;
+    size_t p = worker->begin;
+
+    while (p < worker->end && !worker->failed) {
+        const char *start = worker->text + p;
+        const char *newline = memchr(start, '\n', worker->end - p);
+        size_t length = newline != NULL ? (size_t)(newline - start) : worker->end - p;
+        size_t offset = p;
+        p += length + 1;
+
+        // Lines are parsed from a terminated copy, as fgets would hand them over
+        char line[256];
+        size_t copied = length < sizeof(line) - 1 ? length : sizeof(line) - 1;
+        memcpy(line, start, copied);
+        line[copied] = '\0';
+        if (copied == 0) continue;
+
+        char symbol[MAX_STOCK_NAME];
+        FeedRow row;
+        int symbol_id;
+        memset(row.date, 0, sizeof(row.date));
+        if (parse_row(line, symbol, &row) != 0 || (symbol_id = symbol_intern(symbol)) < 0) {
+            worker->rejected++;
+            continue;
+        }
+        row.symbol_id = symbol_id;
+        row.offset = (long long)offset;
+
+        FeedRow *slot = bucket_push(&worker->buckets[partition_of(symbol_id, worker->partition_count)]);
+        if (slot == NULL) {
+            worker->failed = 1;
+            break;
+        }
+        *slot = row;
+        worker->rows++;
+    }
+    return NULL;
+}
+
+static int compare_bars(const void *a, const void *b) {
+    const FeedRow *x = (const FeedRow *)a;
+    const FeedRow *y = (const FeedRow *)b;
+    if (x->minutes != y->minutes) return x->minutes < y->minutes ? -1 : 1;
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+// Scatters the partition's rows into one run per symbol, keeping file
+// order, then sorts the runs that are not already in date order. Feeds
+// that list each symbol's dates in order, grouped or date-major, need no
+// comparison sort at all.
+static void *group_worker_main(void *arg) {
+    GroupWorker *worker = (GroupWorker *)arg;
+    long long *starts = calloc(MAX_SYMBOLS, sizeof(long long));
+    long long total = 0;
+
+    if (starts == NULL) {
+        worker->failed = 1;
+        return NULL;
+    }
+    for (int t = 0; t < worker->parser_count; t++) {
+        const RowBucket *bucket = &worker->parsers[t].buckets[worker->partition];
+        for (long long i = 0; i < bucket->count; i++) starts[bucket->rows[i].symbol_id]++;
+        total += bucket->count;
+    }
+    int runs = 0;
+    for (int id = 0; id < MAX_SYMBOLS; id++) runs += starts[id] > 0;
+
+    worker->rows = malloc(sizeof(FeedRow) * (size_t)total + 1);
+    worker->runs = malloc(sizeof(FeedRun) * (size_t)runs + 1);
+    if (worker->rows == NULL || worker->runs == NULL) {
+        worker->failed = 1;
+        free(starts);
+        return NULL;
+    }
+    long long next = 0;
+    for (int id = 0; id < MAX_SYMBOLS; id++) {
+        if (starts[id] == 0) continue;
+        FeedRun *run = &worker->runs[worker->run_count++];
+        run->symbol_id = id;
+        run->rows = worker->rows + next;
+        run->row_count = starts[id];
+        starts[id] = next;
+        next += run->row_count;
+    }
+
+    // Slices are gathered in order, so each run fills in file order
+    for (int t = 0; t < worker->parser_count; t++) {
+        RowBucket *bucket = &worker->parsers[t].buckets[worker->partition];
+        for (long long i = 0; i < bucket->count; i++) {
+            worker->rows[starts[bucket->rows[i].symbol_id]++] = bucket->rows[i];
+        }
+        free(bucket->rows);
+        bucket->rows = NULL;
+        bucket->count = bucket->capacity = 0;
+    }
+    worker->row_count = total;
+    free(starts);
+
+    for (int r = 0; r < worker->run_count; r++) {
+        FeedRun *run = &worker->runs[r];
+        FeedRow *rows = worker->rows + (run->rows - worker->rows);
+        run->first_offset = rows[0].offset;
+        long long i = 1;
+        while (i < run->row_count && rows[i].minutes >= rows[i - 1].minutes) i++;
+        if (i < run->row_count) qsort(rows, (size_t)run->row_count, sizeof(FeedRow), compare_bars);
+    }
+    return NULL;
+}
+
+// The calling thread runs the first worker, plus any that failed to start
+static void run_workers(void *(*main_fn)(void *), void *workers, size_t worker_size, int count) {
+    pthread_t handles[count];
+    int started[count];
+    for (int w = 1; w < count; w++) {
+        started[w] = pthread_create(&handles[w], NULL, main_fn, (char *)workers + w * worker_size) == 0;
+    }
+    main_fn(workers);
+    for (int w = 1; w < count; w++) {
+        if (started[w]) {
+            pthread_join(handles[w], NULL);
+        } else {
+            main_fn((char *)workers + w * worker_size);
+        }
+    }
+}
+
+static int compare_runs(const void *a, const void *b) {
+    const FeedRun *x = (const FeedRun *)a;
+    const FeedRun *y = (const FeedRun *)b;
+    return (x->first_offset > y->first_offset) - (x->first_offset < y->first_offset);
+}
+
+// Groups the rows of a CSV held in memory, header line included.
+// threads <= 0 uses one per CPU. Returns -1 if memory runs out.
+int feed_group_text(const char *text, size_t length, int threads, FeedTable *table) {
+    memset(table, 0, sizeof(FeedTable));
+    table->bytes = (long long)length;
+
+    const char *header_end = memchr(text, '\n', length);
+    size_t body = header_end != NULL ? (size_t)(header_end - text) + 1 : length;
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t slices = (length - body) / FEED_MIN_SLICE + 1;
+    if ((size_t)threads > slices) threads = (int)slices;
+    if (threads <= 0) threads = 1;
+
+    ParseWorker parsers[threads];
+    GroupWorker groups[threads];
+    int status = 0;
+
+    memset(parsers, 0, sizeof(parsers));
+    memset(groups, 0, sizeof(groups));
+    size_t previous = body;
+    for (int t = 0; t < threads; t++) {
+        // Slices end just after a newline so no line is split between threads
+        size_t end = t + 1 == threads ? length : body + (length - body) * (size_t)(t + 1) / (size_t)threads;
+        while (end < length && end > previous && text[end - 1] != '\n') end++;
+        if (end < previous) end = previous;
+
+        parsers[t].text = text;
+        parsers[t].begin = previous;
+        parsers[t].end = end;
+        parsers[t].partition_count = threads;
+        parsers[t].buckets = calloc((size_t)threads, sizeof(RowBucket));
+        if (parsers[t].buckets == NULL) status = -1;
+        previous = end;
+    }
+
+    if (status == 0) {
+        run_workers(parse_worker_main, parsers, sizeof(ParseWorker), threads);
+        for (int t = 0; t < threads; t++) {
+            if (parsers[t].failed) status = -1;
+            table->rows += parsers[t].rows;
+            table->rejected += parsers[t].rejected;
+        }
+    }
+    if (status == 0) {
+        for (int p = 0; p < threads; p++) {
+            groups[p].parsers = parsers;
+            groups[p].parser_count = threads;
+            groups[p].partition = p;
+        }
+        run_workers(group_worker_main, groups, sizeof(GroupWorker), threads);
+        for (int p = 0; p < threads; p++) {
+            if (groups[p].failed) status = -1;
+            table->run_count += groups[p].run_count;
+        }
+    }
+
+    // Symbols come out in order of first appearance, as a grouped file lists them
+    table->partitions = calloc((size_t)threads, sizeof(FeedRow *));
+    table->runs = malloc(sizeof(FeedRun) * (size_t)table->run_count + 1);
+    if (table->partitions == NULL || table->runs == NULL) status = -1;
+    int run = 0;
+    for (int p = 0; p < threads; p++) {
+        if (status == 0) {
+            table->partitions[p] = groups[p].rows;
+            memcpy(table->runs + run, groups[p].runs, sizeof(FeedRun) * (size_t)groups[p].run_count);
+            run += groups[p].run_count;
+        } else {
+            free(groups[p].rows);
+        }
+        free(groups[p].runs);
+    }
+    for (int t = 0; t < threads; t++) {
+        for (int p = 0; parsers[t].buckets != NULL && p < threads; p++) free(parsers[t].buckets[p].rows);
+        free(parsers[t].buckets);
+    }
+    if (status != 0) {
+        feed_table_free(table);
+        return -1;
+    }
+    table->partition_count = threads;
+    qsort(table->runs, (size_t)table->run_count, sizeof(FeedRun), compare_runs);
+
+    for (int r = 0; r < table->run_count; r++) {
+        long long row_count = table->runs[r].row_count;
+        if (r >= MAX_STOCKS) {
+            table->dropped_symbols++;
+            table->dropped_bars += row_count;
+        } else if (row_count > MAX_DAYS) {
+            table->dropped_bars += row_count - MAX_DAYS;
+        }
+    }
+    return 0;
+}
+
+// Reads the rest of the stream into memory and groups it. Returns -1 if
+// memory runs out or the stream cannot be read.
+int feed_read_csv(FILE *fp, int threads, FeedTable *table) {
+    size_t capacity = 1 << 20, length = 0;
+    char *text = malloc(capacity);
+
+    memset(table, 0, sizeof(FeedTable));
+    while (text != NULL) {
+        length += fread(text + length, 1, capacity - length, fp);
+        if (length < capacity) break;
+        char *grown = realloc(text, capacity * 2);
+        if (grown == NULL) {
+            free(text);
+            text = NULL;
+            break;
+        }
+        text = grown;
+        capacity *= 2;
+    }
+    if (text == NULL || ferror(fp)) {
+        free(text);
+        return -1;
+    }
+
+    int status = feed_group_text(text, length, threads, table);
+    free(text);
+    return status;
+}
+
+// The first MAX_STOCKS symbols, each with its most recent MAX_DAYS bars.
+// The table counts what this leaves out.
+void feed_table_stocks(const FeedTable *table, Stock stocks[], int *stock_count) {
+    int count = table->run_count < MAX_STOCKS ? table->run_count : MAX_STOCKS;
+
+    for (int s = 0; s < count; s++) {
+        const FeedRun *run = &table->runs[s];
+        Stock *stock = &stocks[s];
+        stock->symbol_id = run->symbol_id;
+        stock->day_count = run->row_count < MAX_DAYS ? (int)run->row_count : MAX_DAYS;
+        const FeedRow *rows = run->rows + (run->row_count - stock->day_count);
+        for (int d = 0; d < stock->day_count; d++) {
+            const FeedRow *row = &rows[d];
+            PriceData *bar = &stock->prices[d];
+            bar->symbol_id = row->symbol_id;
+            memcpy(bar->date, row->date, MAX_DATE);
+            bar->open = row->open;
+            bar->high = row->high;
+            bar->low = row->low;
+            bar->close = row->close;
+            bar->volume = row->volume;
+        }
+    }
+    *stock_count = count;
+}
+
+void feed_table_free(FeedTable *table) {
+    for (int p = 0; table->partitions != NULL && p < table->partition_count; p++) free(table->partitions[p]);
+    free(table->partitions);
+    free(table->runs);
+    memset(table, 0, sizeof(FeedTable));
+}
@@ -0,0 +1,54 @@
+#ifndef FEED_INGEST_H
+#define FEED_INGEST_H
+
+#include <stdio.h>
+#include "structures.h"
+
+// Order-independent CSV ingestion. Rows in the stock_data.csv layout may
+// arrive in any order, e.g. date-major as vendors publish them. Worker
+// threads parse line-aligned slices of the text and scatter rows into hash
+// partitions by symbol; each partition is then grouped and sorted by date
+// on its own thread. Within a symbol, bars with the same date keep their
+// file order.
+#define FEED_MIN_SLICE (64 * 1024)      // bytes per parsing thread, at least
+
+typedef struct {
+    long long minutes;                  // date key, minutes since epoch
+    long long offset;                   // of the line in the text
+    int symbol_id;
+    int volume;
+    int has_time;                       // the date carries "HH:MM"
+    double open;
+    double high;
+    double low;
+    double close;
+    char date[MAX_DATE];
+} FeedRow;
+
+// One symbol's bars, in date order
+typedef struct {
+    int symbol_id;
+    long long first_offset;             // where the symbol first appears
+    const FeedRow *rows;
+    long long row_count;
+} FeedRun;
+
+// Grouped rows, symbols in order of first appearance
+typedef struct {
+    FeedRow **partitions;               // own the rows the runs point into
+    int partition_count;
+    FeedRun *runs;
+    int run_count;
+    long long rows;
+    long long rejected;                 // malformed rows, dates included
+    long long bytes;
+    int dropped_symbols;                // past the first MAX_STOCKS, left out by feed_table_stocks
+    long long dropped_bars;             // their bars, and bars before a symbol's most recent MAX_DAYS
+} FeedTable;
+
+int feed_group_text(const char *text, size_t length, int threads, FeedTable *table);
+int feed_read_csv(FILE *fp, int threads, FeedTable *table);
+void feed_table_stocks(const FeedTable *table, Stock stocks[], int *stock_count);
+void feed_table_free(FeedTable *table);
+
+#endif
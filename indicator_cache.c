@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+#include "indicator_cache.h"
+#include "rules.h"
+#include "structures.h"
+
+int indicator_cache_init(IndicatorCache *cache, size_t budget) {
+    memset(cache, 0, sizeof(IndicatorCache));
+    cache->stats.budget = budget;
+    if (pthread_mutex_init(&cache->lock, NULL) != 0) return -1;
+    if (pthread_cond_init(&cache->filled, NULL) != 0) {
+        pthread_mutex_destroy(&cache->lock);
+        return -1;
+    }
+    return 0;
+}
+
+// No column may still be pinned
+void indicator_cache_free(IndicatorCache *cache) {
+    IndicatorColumn *column = cache->lru_head;
+    while (column != NULL) {
+        IndicatorColumn *next = column->lru_next;
+        free(column->values);
+        free(column);
+        column = next;
+    }
+    pthread_cond_destroy(&cache->filled);
+    pthread_mutex_destroy(&cache->lock);
+    memset(cache, 0, sizeof(IndicatorCache));
+}
+
+static unsigned long long hash_bytes(unsigned long long hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static unsigned long long column_key(int symbol_id, unsigned long long fingerprint, int day_count,
+                                     const RuleIndicator *indicator) {
+    unsigned long long hash = 14695981039346656037ULL;
+    hash = hash_bytes(hash, &symbol_id, sizeof(symbol_id));
+    hash = hash_bytes(hash, &fingerprint, sizeof(fingerprint));
+    hash = hash_bytes(hash, &day_count, sizeof(day_count));
+    hash = hash_bytes(hash, &indicator->kind, sizeof(indicator->kind));
+    hash = hash_bytes(hash, &indicator->period, sizeof(indicator->period));
+    return hash;
+}
+
+static IndicatorColumn **bucket_of(IndicatorCache *cache, unsigned long long key) {
+    return &cache->buckets[key & (INDICATOR_CACHE_BUCKETS - 1)];
+}
+
+static void lru_unlink(IndicatorCache *cache, IndicatorColumn *column) {
+    if (column->lru_prev != NULL) column->lru_prev->lru_next = column->lru_next;
+    else cache->lru_head = column->lru_next;
+    if (column->lru_next != NULL) column->lru_next->lru_prev = column->lru_prev;
+    else cache->lru_tail = column->lru_prev;
+    column->lru_prev = column->lru_next = NULL;
+}
+
+static void lru_push_front(IndicatorCache *cache, IndicatorColumn *column) {
+    column->lru_next = cache->lru_head;
+    if (cache->lru_head != NULL) cache->lru_head->lru_prev = column;
+    cache->lru_head = column;
+    if (cache->lru_tail == NULL) cache->lru_tail = column;
+}
+
+static void remove_column(IndicatorCache *cache, IndicatorColumn *column) {
+    IndicatorColumn **link = bucket_of(cache, column->key);
+    while (*link != column) link = &(*link)->bucket_next;
+    *link = column->bucket_next;
+    lru_unlink(cache, column);
+
+    cache->stats.bytes -= sizeof(double) * (size_t)column->day_count;
+    cache->stats.column_count--;
+    free(column->values);
+    free(column);
+}
+
+// Evicts unpinned columns from the cold end until size more bytes fit.
+// Returns 0 if they do.
+static int make_room(IndicatorCache *cache, size_t size) {
+    IndicatorColumn *column = cache->lru_tail;
+    while (cache->stats.bytes + size > cache->stats.budget && column != NULL) {
+        IndicatorColumn *prev = column->lru_prev;
+        if (column->pins == 0) {
+            remove_column(cache, column);
+            cache->stats.evictions++;
+        }
+        column = prev;
+    }
+    return cache->stats.bytes + size <= cache->stats.budget ? 0 : -1;
+}
+
+// Pins the column for this stock's data, computing it on first use. Other
+// threads asking for a column being computed wait for it rather than
+// computing it again. When pinned columns fill the budget the new one is
+// handed out uncached and freed on release. Returns NULL if out of memory.
+IndicatorColumn *indicator_cache_acquire(IndicatorCache *cache, const Stock *stock,
+                                         unsigned long long fingerprint, const RuleIndicator *indicator) {
+    unsigned long long key = column_key(stock->symbol_id, fingerprint, stock->day_count, indicator);
+    IndicatorColumn *column;
+
+    pthread_mutex_lock(&cache->lock);
+    for (column = *bucket_of(cache, key); column != NULL; column = column->bucket_next) {
+        if (column->key == key && column->fingerprint == fingerprint &&
+            column->day_count == stock->day_count && column->indicator.kind == indicator->kind &&
+            column->indicator.period == indicator->period && column->symbol_id == stock->symbol_id) {
+            break;
+        }
+    }
+    if (column != NULL) {
+        column->pins++;
+        cache->stats.hits++;
+        lru_unlink(cache, column);
+        lru_push_front(cache, column);
+        while (!column->ready) pthread_cond_wait(&cache->filled, &cache->lock);
+        pthread_mutex_unlock(&cache->lock);
+        return column;
+    }
+
+    size_t size = sizeof(double) * (size_t)stock->day_count;
+    column = calloc(1, sizeof(IndicatorColumn));
+    if (column != NULL) column->values = malloc(size + sizeof(double));
+    if (column == NULL || column->values == NULL) {
+        pthread_mutex_unlock(&cache->lock);
+        free(column);
+        return NULL;
+    }
+    cache->stats.misses++;
+    column->key = key;
+    column->symbol_id = stock->symbol_id;
+    column->fingerprint = fingerprint;
+    column->day_count = stock->day_count;
+    column->indicator = *indicator;
+    column->pins = 1;
+    if (make_room(cache, size) == 0) {
+        IndicatorColumn **bucket = bucket_of(cache, key);
+        column->bucket_next = *bucket;
+        *bucket = column;
+        lru_push_front(cache, column);
+        column->cached = 1;
+        cache->stats.bytes += size;
+        cache->stats.column_count++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    // Computed outside the lock; nobody reads the values before ready is set
+    double closes[MAX_DAYS];
+    for (int d = 0; d < stock->day_count; d++) closes[d] = stock->prices[d].close;
+    compute_indicator_column(indicator, closes, 0, stock->day_count, column->values);
+
+    pthread_mutex_lock(&cache->lock);
+    column->ready = 1;
+    pthread_cond_broadcast(&cache->filled);
+    pthread_mutex_unlock(&cache->lock);
+    return column;
+}
+
+void indicator_cache_release(IndicatorCache *cache, IndicatorColumn *column) {
+    pthread_mutex_lock(&cache->lock);
+    column->pins--;
+    int orphaned = column->pins == 0 && !column->cached;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (orphaned) {
+        free(column->values);
+        free(column);
+    }
+}
+
+void indicator_cache_stats(IndicatorCache *cache, IndicatorCacheStats *stats) {
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
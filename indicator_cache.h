@@ -0,0 +1,57 @@
+#ifndef INDICATOR_CACHE_H
+#define INDICATOR_CACHE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "structures.h"
+#include "rules.h"
+
+#define INDICATOR_CACHE_DEFAULT_BUDGET ((size_t)64 * 1024 * 1024)
+#define INDICATOR_CACHE_BUCKETS 1024
+
+// One indicator materialized over all of a symbol's bars. Entries are
+// identified by symbol id, indicator, period and the fingerprint of the
+// data, so a changed dataset simply stops matching its old columns.
+typedef struct IndicatorColumn {
+    unsigned long long key;             // hash of the identity below
+    int symbol_id;
+    unsigned long long fingerprint;     // stock_fingerprint() of the bars
+    int day_count;
+    RuleIndicator indicator;
+    double *values;                     // read-only once ready
+    int pins;                           // readers holding the column
+    int ready;
+    int cached;                         // reachable through the table
+    struct IndicatorColumn *bucket_next;
+    struct IndicatorColumn *lru_prev;   // towards the most recently used
+    struct IndicatorColumn *lru_next;
+} IndicatorColumn;
+
+typedef struct {
+    int column_count;
+    size_t bytes;
+    size_t budget;
+    long long hits;
+    long long misses;
+    long long evictions;
+} IndicatorCacheStats;
+
+// Shared by any number of runs and threads. Columns past the memory budget
+// are evicted least recently used first, except while they are pinned.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    IndicatorColumn *buckets[INDICATOR_CACHE_BUCKETS];
+    IndicatorColumn *lru_head;
+    IndicatorColumn *lru_tail;
+    IndicatorCacheStats stats;
+} IndicatorCache;
+
+int indicator_cache_init(IndicatorCache *cache, size_t budget);
+void indicator_cache_free(IndicatorCache *cache);
+IndicatorColumn *indicator_cache_acquire(IndicatorCache *cache, const Stock *stock,
+                                         unsigned long long fingerprint, const RuleIndicator *indicator);
+void indicator_cache_release(IndicatorCache *cache, IndicatorColumn *column);
+void indicator_cache_stats(IndicatorCache *cache, IndicatorCacheStats *stats);
+
+#endif
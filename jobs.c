@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jobs.h"
+
+void job_table_init(JobTable *table, const SchedulerOptions *scheduler_options) {
+    memset(table, 0, sizeof(JobTable));
+    table->next_id = 1;
+    table->has_indicators = indicator_cache_init(&table->indicators, INDICATOR_CACHE_DEFAULT_BUDGET) == 0;
+    table->has_scheduler = scheduler_init(&table->scheduler, scheduler_options) == 0;
+}
+
+// Publishes the run's progress and hands back any cancel request
+static int job_progress(void *context, const BtProgress *progress) {
+    Job *job = (Job *)context;
+    __atomic_store_n(&job->bars_total, progress->bars_total, __ATOMIC_RELAXED);
+    __atomic_store_n(&job->strategies_total, progress->strategies_total, __ATOMIC_RELAXED);
+    __atomic_store_n(&job->bars_done, progress->bars_done, __ATOMIC_RELAXED);
+    __atomic_store_n(&job->strategies_done, progress->strategies_done, __ATOMIC_RELEASE);
+    return __atomic_load_n(&job->cancel, __ATOMIC_RELAXED);
+}
+
+static void *job_main(void *arg) {
+    Job *job = (Job *)arg;
+    BtDataset dataset;
+    BtRunOptions options;
+
+    bt_dataset_borrow(&dataset, job->stocks, job->stock_count);
+    bt_default_options(&options);
+    options.initial_cash = job->initial_cash;
+    options.fixed_point = job->fixed_point;
+    options.block_bars = JOB_BAR_BLOCK;
+    options.progress = job_progress;
+    options.progress_context = job;
+    options.indicator_cache = job->indicator_cache;
+    options.scheduler = job->scheduler;
+    if (job->kind == JOB_SWEEP) options.result_stats = &job->stats;
+
+    if (job->kind == JOB_SINGLE) {
+        BtRunOutput output;
+        memset(&output, 0, sizeof(output));
+        output.portfolio = job->portfolio;
+        job->status = bt_run(&dataset, &job->strategies[0], &options, &output);
+        job->results[0] = output.result;
+    } else {
+        job->status = bt_run_batch(&dataset, job->strategies, job->strategy_count, job->owners,
+                                   &options, job->results);
+    }
+    // Finished sweeps are kept for --query; a failed append leaves sweep_id 0
+    if (job->kind == JOB_SWEEP && job->status == BT_OK) {
+        results_store_append(RESULTS_STORE_DIR, job->strategies, job->results, job->strategy_count,
+                             &job->sweep_id);
+    }
+
+    JobState state = job->status == BT_OK ? JOB_FINISHED
+                   : job->status == BT_ERROR_CANCELLED ? JOB_CANCELLED : JOB_FAILED;
+    __atomic_store_n(&job->state, state, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void free_job(Job *job) {
+    free(job->portfolio);
+    free(job->strategies);
+    free(job->owners);
+    free(job->results);
+    job->portfolio = NULL;
+    job->strategies = NULL;
+    job->owners = NULL;
+    job->results = NULL;
+    job->in_use = 0;
+}
+
+// Claims a slot for a job over the given strategies, which it takes
+// ownership of
+static Job *new_job(JobTable *table, Stock stocks[], int stock_count, JobKind kind,
+                    double initial_cash, Strategy *strategies, int strategy_count) {
+    if (stock_count <= 0) {
+        printf("Error: no stock data loaded!\n");
+        free(strategies);
+        return NULL;
+    }
+    for (int i = 0; i < MAX_JOBS; i++) {
+        Job *job = &table->jobs[i];
+        if (job->in_use) continue;
+
+        memset(job, 0, sizeof(Job));
+        job->in_use = 1;
+        job->strategies = strategies;
+        job->strategy_count = strategy_count;
+        job->portfolio = malloc(sizeof(Portfolio));
+        job->owners = malloc(sizeof(*job->owners) * (size_t)strategy_count);
+        job->results = malloc(sizeof(StrategyResult) * (size_t)strategy_count);
+        if (job->portfolio == NULL || job->owners == NULL || job->results == NULL) {
+            printf("Error allocating a background job!\n");
+            free_job(job);
+            return NULL;
+        }
+        job->id = table->next_id++;
+        job->kind = kind;
+        job->stocks = stocks;
+        job->stock_count = stock_count;
+        job->initial_cash = initial_cash;
+        job->fixed_point = table->fixed_point;
+        job->indicator_cache = table->has_indicators ? &table->indicators : NULL;
+        job->scheduler = table->has_scheduler ? &table->scheduler : NULL;
+        result_stats_init(&job->stats);
+        job->state = JOB_RUNNING;
+        return job;
+    }
+    printf("Error: all %d job slots are busy, release a finished job first!\n", MAX_JOBS);
+    free(strategies);
+    return NULL;
+}
+
+static Job *start_job(Job *job) {
+    if (pthread_create(&job->thread, NULL, job_main, job) != 0) {
+        printf("Error starting a background job!\n");
+        free_job(job);
+        return NULL;
+    }
+    return job;
+}
+
+Job *submit_backtest_job(JobTable *table, Stock stocks[], int stock_count, Strategy strategy,
+                         double initial_cash) {
+    Strategy *strategies = malloc(sizeof(Strategy));
+    if (strategies == NULL) {
+        printf("Error allocating a background job!\n");
+        return NULL;
+    }
+    strategies[0] = strategy;
+
+    Job *job = new_job(table, stocks, stock_count, JOB_SINGLE, initial_cash, strategies, 1);
+    if (job == NULL) return NULL;
+    strcpy(job->label, strategy.name);
+    job->owners[0] = "-";
+    return start_job(job);
+}
+
+// The presets, then the user's strategies as they are right now
+Job *submit_comparison_job(JobTable *table, Stock stocks[], int stock_count,
+                           const StrategyCatalog *catalog, const User *user, double initial_cash) {
+    Strategy *strategies;
+    int count = comparison_lineup(catalog, user, &strategies);
+    if (count < 0) return NULL;
+
+    Job *job = new_job(table, stocks, stock_count, JOB_COMPARISON, initial_cash, strategies, count);
+    if (job == NULL) return NULL;
+    strcpy(job->username, user->username);
+    strcpy(job->label, "All strategies");
+    for (int i = 0; i < count; i++) {
+        job->owners[i] = i < PRESET_STRATEGY_COUNT ? "System" : job->username;
+    }
+    return start_job(job);
+}
+
+// Every combination of the swept exit parameters around base. The variants
+// share base's entry rules, so the engine runs them as one prefix-sharing
+// group.
+Job *submit_sweep_job(JobTable *table, Stock stocks[], int stock_count, const Strategy *base,
+                      const ExitSweep *sweep, const char *username, double initial_cash) {
+    Strategy *strategies;
+    int count = build_exit_sweep(base, sweep, &strategies);
+    if (count < 0) return NULL;
+
+    Job *job = new_job(table, stocks, stock_count, JOB_SWEEP, initial_cash, strategies, count);
+    if (job == NULL) return NULL;
+    strcpy(job->username, username);
+    snprintf(job->label, sizeof(job->label), "%.30s (%d sets)", base->name, count);
+    for (int i = 0; i < count; i++) job->owners[i] = job->username;
+    return start_job(job);
+}
+
+JobState job_state(const Job *job) {
+    return (JobState)__atomic_load_n(&job->state, __ATOMIC_ACQUIRE);
+}
+
+double job_percent(const Job *job) {
+    long long done = __atomic_load_n(&job->bars_done, __ATOMIC_RELAXED);
+    long long total = __atomic_load_n(&job->bars_total, __ATOMIC_RELAXED);
+    if (total <= 0) return job_state(job) == JOB_RUNNING ? 0.0 : 100.0;
+    return 100.0 * (double)done / (double)total;
+}
+
+// Cooperative: the worker stops at its next block boundary
+void cancel_job(Job *job) {
+    __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+}
+
+Job *find_job(JobTable *table, int id) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (table->jobs[i].in_use && table->jobs[i].id == id) return &table->jobs[i];
+    }
+    return NULL;
+}
+
+int running_job_count(const JobTable *table) {
+    int running = 0;
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (table->jobs[i].in_use && job_state(&table->jobs[i]) == JOB_RUNNING) running++;
+    }
+    return running;
+}
+
+// Frees the slot of a job that has stopped; returns -1 while it is running
+int release_job(Job *job) {
+    if (job_state(job) == JOB_RUNNING) return -1;
+    pthread_join(job->thread, NULL);
+    free_job(job);
+    return 0;
+}
+
+void print_job_table(JobTable *table) {
+    static const char *kind_names[] = { "Backtest", "Comparison", "Sweep" };
+    static const char *state_names[] = { "running", "finished", "cancelled", "failed" };
+    int shown = 0;
+
+    printf("%-5s %-12s %-30s %-10s %8s %11s\n", "Job", "Type", "Strategy", "State", "Progress", "Strategies");
+    printf("-------------------------------------------------------------------------------\n");
+    for (int i = 0; i < MAX_JOBS; i++) {
+        const Job *job = &table->jobs[i];
+        if (!job->in_use) continue;
+
+        int done = __atomic_load_n(&job->strategies_done, __ATOMIC_RELAXED);
+        int total = __atomic_load_n(&job->strategies_total, __ATOMIC_RELAXED);
+        printf("#%-4d %-12s %-30.30s %-10s %7.1f%% %5d/%-5d\n", job->id, kind_names[job->kind], job->label,
+               state_names[job_state(job)], job_percent(job), done, total);
+        shown++;
+    }
+    if (shown == 0) printf("No background jobs.\n");
+
+    if (table->has_indicators) {
+        IndicatorCacheStats stats;
+        indicator_cache_stats(&table->indicators, &stats);
+        printf("\nIndicator cache: %d columns, %.1f of %.0f MB, %lld hits, %lld computed, %lld evicted\n",
+               stats.column_count, stats.bytes / 1048576.0, stats.budget / 1048576.0,
+               stats.hits, stats.misses, stats.evictions);
+    }
+
+    if (table->has_scheduler) {
+        WorkerStats workers[SCHEDULER_MAX_WORKERS];
+        long long uptime;
+        scheduler_stats(&table->scheduler, workers, &uptime);
+        printf("\n%-7s %-8s %6s %8s %8s %10s\n", "Worker", "Pinned", "Busy", "Tasks", "Stolen", "Arena");
+        for (int w = 0; w < table->scheduler.worker_count; w++) {
+            char pinned[16] = "-";
+            if (workers[w].node >= 0) snprintf(pinned, sizeof(pinned), "node %d", workers[w].node);
+            else if (workers[w].cpu >= 0) snprintf(pinned, sizeof(pinned), "cpu %d", workers[w].cpu);
+            printf("#%-6d %-8s %5.1f%% %8lld %8lld %7.1f MB\n", w, pinned,
+                   uptime > 0 ? 100.0 * (double)workers[w].busy_ns / (double)uptime : 0.0,
+                   workers[w].tasks, workers[w].steals, workers[w].arena_bytes / 1048576.0);
+        }
+    }
+}
+
+// Cancels whatever is still running and waits for every worker to exit
+void job_table_shutdown(JobTable *table) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        Job *job = &table->jobs[i];
+        if (!job->in_use) continue;
+        cancel_job(job);
+        pthread_join(job->thread, NULL);
+        free_job(job);
+    }
+    if (table->has_scheduler) scheduler_free(&table->scheduler);
+    if (table->has_indicators) indicator_cache_free(&table->indicators);
+    table->has_scheduler = 0;
+    table->has_indicators = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <pthread.h>
+#include "structures.h"
+#include "backtest.h"
+#include "libbacktest.h"
+#include "strategy_catalog.h"
+#include "sweep.h"
+#include "result_stats.h"
+#include "results_store.h"
+
+#define MAX_JOBS 8
+// A job checks for cancellation between blocks of this many bars
+#define JOB_BAR_BLOCK 128
+
+typedef enum {
+    JOB_SINGLE,
+    JOB_COMPARISON,
+    JOB_SWEEP
+} JobKind;
+
+typedef enum {
+    JOB_RUNNING,
+    JOB_FINISHED,
+    JOB_CANCELLED,
+    JOB_FAILED
+} JobState;
+
+// A backtest running on its own thread through the library API. Strategies
+// are copied at submit time, so the user can keep editing theirs; the stock
+// data is shared and must stay loaded until the job is released. The
+// worker publishes its progress through the atomic fields, and the results
+// may be read once job_state() is no longer JOB_RUNNING.
+typedef struct {
+    int id;
+    int in_use;
+    JobKind kind;
+    pthread_t thread;
+    IndicatorCache *indicator_cache;    // the table's, shared by all its jobs
+    Scheduler *scheduler;               // the table's, NULL to run on the job's thread
+    Stock *stocks;
+    int stock_count;
+    double initial_cash;
+    int fixed_point;
+    Strategy *strategies;
+    const char **owners;                // "System" or username, per strategy
+    char label[50];                     // what the jobs screen calls it
+    char username[MAX_USERNAME];
+    int strategy_count;
+    Portfolio *portfolio;               // final portfolio of a single backtest
+    StrategyResult *results;
+    ResultStats stats;                  // sweeps: distribution of the results
+    int sweep_id;                       // sweeps: id in the results store, 0 if not stored
+    int status;                         // BT_ code once the job has stopped
+
+    // Atomic
+    long long bars_done;
+    long long bars_total;
+    int strategies_done;
+    int strategies_total;               // parameter sets that actually run
+    int state;
+    int cancel;
+} Job;
+
+// Jobs share one indicator cache, so a column computed by one job is
+// reused by every later job over the same data. Comparison and sweep jobs
+// also share one scheduler: each job's thread hands its batch to the
+// scheduler's workers, so concurrent jobs of any size keep every core busy.
+typedef struct {
+    Job jobs[MAX_JOBS];
+    int next_id;
+    IndicatorCache indicators;
+    int has_indicators;
+    Scheduler scheduler;
+    int has_scheduler;
+    int fixed_point;                    // accounting mode of new jobs
+} JobTable;
+
+void job_table_init(JobTable *table, const SchedulerOptions *scheduler_options);
+Job *submit_backtest_job(JobTable *table, Stock stocks[], int stock_count, Strategy strategy,
+                         double initial_cash);
+Job *submit_comparison_job(JobTable *table, Stock stocks[], int stock_count,
+                           const StrategyCatalog *catalog, const User *user, double initial_cash);
+Job *submit_sweep_job(JobTable *table, Stock stocks[], int stock_count, const Strategy *base,
+                      const ExitSweep *sweep, const char *username, double initial_cash);
+JobState job_state(const Job *job);
+double job_percent(const Job *job);
+void cancel_job(Job *job);
+Job *find_job(JobTable *table, int id);
+int running_job_count(const JobTable *table);
+int release_job(Job *job);
+void print_job_table(JobTable *table);
+void job_table_shutdown(JobTable *table);
+
+#endif
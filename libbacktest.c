@@ -0,0 +1,597 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "libbacktest.h"
+#include "backtest.h"
+#include "rules.h"
+#include "stock_data.h"
+#include "structures.h"
+
+static void *bt_allocate(const BtAllocator *allocator, size_t size) {
+    if (allocator->allocate != NULL) return allocator->allocate(allocator->context, size);
+    return malloc(size);
+}
+
+static void bt_release(const BtAllocator *allocator, void *pointer) {
+    if (pointer == NULL) return;
+    if (allocator->allocate == NULL) free(pointer);
+    else if (allocator->release != NULL) allocator->release(allocator->context, pointer);
+}
+
+void bt_default_options(BtRunOptions *options) {
+    memset(options, 0, sizeof(BtRunOptions));
+    options->initial_cash = 100000.0;
+    options->block_bars = BT_DEFAULT_BLOCK_BARS;
+    options->fused = 1;
+    options->prefix_sharing = 1;
+}
+
+static int valid_dataset(const BtDataset *dataset) {
+    return dataset != NULL && dataset->stocks != NULL &&
+           dataset->stock_count > 0 && dataset->stock_count <= MAX_STOCKS &&
+           stocks_aligned(dataset->stocks, dataset->stock_count);
+}
+
+static void fingerprint_dataset(BtDataset *dataset) {
+    for (int s = 0; s < dataset->stock_count; s++) {
+        dataset->fingerprints[s] = stock_fingerprint(&dataset->stocks[s], dataset->stocks[s].day_count);
+    }
+}
+
+// The stocks must not change while the dataset is in use; borrow again
+// after modifying them
+int bt_dataset_borrow(BtDataset *dataset, Stock stocks[], int stock_count) {
+    memset(dataset, 0, sizeof(BtDataset));
+    dataset->stocks = stocks;
+    dataset->stock_count = stock_count;
+    if (!valid_dataset(dataset)) return BT_ERROR_ARGUMENT;
+    fingerprint_dataset(dataset);
+    return BT_OK;
+}
+
+// Reads a CSV file or, if it starts with the binary magic, a binary one
+int bt_dataset_load(BtDataset *dataset, const char *path, const BtAllocator *allocator) {
+    memset(dataset, 0, sizeof(BtDataset));
+    if (path == NULL) return BT_ERROR_ARGUMENT;
+    if (allocator != NULL) dataset->allocator = *allocator;
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return BT_ERROR_IO;
+
+    Stock *stocks = bt_allocate(&dataset->allocator, sizeof(Stock) * MAX_STOCKS);
+    if (stocks == NULL) {
+        fclose(fp);
+        return BT_ERROR_MEMORY;
+    }
+
+    char magic[sizeof(STOCK_BINARY_MAGIC) - 1];
+    int is_binary = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+                    memcmp(magic, STOCK_BINARY_MAGIC, sizeof(magic)) == 0;
+    int stock_count = 0;
+    int status = BT_OK;
+
+    rewind(fp);
+    if (is_binary) {
+        if (read_stock_binary(fp, stocks, &stock_count) != 0) status = BT_ERROR_FORMAT;
+    } else {
+        DroppedData dropped = { 0, 0 };
+        if (read_stock_csv(fp, stocks, &stock_count, &dropped) != 0) status = BT_ERROR_MEMORY;
+        dataset->dropped_symbols = dropped.symbols;
+        dataset->dropped_bars = dropped.bars;
+    }
+    if (ferror(fp)) status = BT_ERROR_IO;
+    fclose(fp);
+    if (status == BT_OK && (stock_count <= 0 || !stocks_aligned(stocks, stock_count))) status = BT_ERROR_FORMAT;
+
+    if (status != BT_OK) {
+        bt_release(&dataset->allocator, stocks);
+        return status;
+    }
+    dataset->stocks = stocks;
+    dataset->stock_count = stock_count;
+    dataset->owned = 1;
+    fingerprint_dataset(dataset);
+    return BT_OK;
+}
+
+void bt_dataset_free(BtDataset *dataset) {
+    if (dataset->owned) bt_release(&dataset->allocator, dataset->stocks);
+    memset(dataset, 0, sizeof(BtDataset));
+}
+
+// Return covariance of every pair of the dataset's stocks over their last
+// window bars (fewer if the data is shorter). threads <= 0 uses one per
+// CPU. On success the caller frees the matrix with covariance_free().
+int bt_covariance(const BtDataset *dataset, int window, int threads, CovarianceMatrix *matrix) {
+    if (dataset == NULL || matrix == NULL || dataset->stock_count <= 0 || window < 1) return BT_ERROR_ARGUMENT;
+    for (int s = 0; s < dataset->stock_count; s++) {
+        if (dataset->stocks[s].day_count < 2) return BT_ERROR_ARGUMENT;
+    }
+    if (compute_stock_covariance(matrix, dataset->stocks, dataset->stock_count, window, threads) != 0) {
+        return BT_ERROR_MEMORY;
+    }
+    return BT_OK;
+}
+
+// Compiles any rule text; the error message is only written on failure
+int bt_validate_strategy(const Strategy *strategy, char *error, int error_size) {
+    CompiledRules rules;
+    if (strategy == NULL) return BT_ERROR_ARGUMENT;
+    if (compile_strategy_rules(strategy, &rules, error, error_size) != 0) return BT_ERROR_RULE;
+    return BT_OK;
+}
+
+static long long bars_per_strategy(const BtDataset *dataset) {
+    int days = dataset->stocks[0].day_count - BACKTEST_FIRST_DAY;
+    return days > 0 ? days : 0;
+}
+
+static int report_progress(const BtRunOptions *options, const BtProgress *progress) {
+    return options->progress != NULL && options->progress(options->progress_context, progress) != 0;
+}
+
+// Progress of one call. Batch tasks on scheduler workers report through it
+// at the same time, so the counters and callbacks are updated under its
+// lock, and a cancel seen by one task stops them all.
+typedef struct {
+    const BtRunOptions *options;
+    BtProgress progress;
+    pthread_mutex_t lock;
+    int cancelled;
+} ProgressSink;
+
+static int start_progress(ProgressSink *sink, const BtRunOptions *options, long long bars_total,
+                          int strategies_total) {
+    sink->options = options;
+    sink->progress.bars_done = 0;
+    sink->progress.bars_total = bars_total;
+    sink->progress.strategies_done = 0;
+    sink->progress.strategies_total = strategies_total;
+    pthread_mutex_init(&sink->lock, NULL);
+    sink->cancelled = report_progress(options, &sink->progress);
+    return sink->cancelled ? BT_ERROR_CANCELLED : BT_OK;
+}
+
+// Adds bars, and entry index's final result if one is given, and reports
+static int advance_progress(ProgressSink *sink, long long bars, int index, const StrategyResult *result) {
+    const BtRunOptions *options = sink->options;
+
+    pthread_mutex_lock(&sink->lock);
+    sink->progress.bars_done += bars;
+    if (result != NULL) {
+        if (options->on_result != NULL) options->on_result(options->result_context, index, result);
+        sink->progress.strategies_done++;
+    }
+    if (!sink->cancelled && report_progress(options, &sink->progress)) sink->cancelled = 1;
+    int status = sink->cancelled ? BT_ERROR_CANCELLED : BT_OK;
+    pthread_mutex_unlock(&sink->lock);
+    return status;
+}
+
+// Runs one strategy from a fresh portfolio in blocks of bars, reporting
+// progress and passing on new trades after each. Windows resume exactly
+// where the previous one stopped, so blocking does not change the result.
+static int run_blocks(const BtDataset *dataset, const Strategy *strategy, const BtRunOptions *options,
+                      IndicatorCache *cache, Portfolio *portfolio, ProgressSink *sink,
+                      const BtRunOutput *output) {
+    int max_days = dataset->stocks[0].day_count;
+    int block = options->block_bars > 0 ? options->block_bars : BT_DEFAULT_BLOCK_BARS;
+    int emitted = 0;
+
+    init_portfolio_mode(portfolio, options->initial_cash, options->fixed_point);
+    for (int day = BACKTEST_FIRST_DAY; day < max_days; day += block) {
+        int end_day = day + block < max_days ? day + block : max_days;
+        int status = backtest_window_cached(dataset->stocks, dataset->stock_count, *strategy, portfolio,
+                                            day, end_day, cache, dataset->fingerprints);
+        if (status == BACKTEST_ERROR_RULE) return BT_ERROR_RULE;
+        if (status != BACKTEST_OK) return BT_ERROR_MEMORY;
+
+        if (output != NULL && output->on_trade != NULL) {
+            for (; emitted < portfolio->trade_count; emitted++) {
+                output->on_trade(output->trade_context, &portfolio->trades[emitted]);
+            }
+        }
+        if (advance_progress(sink, end_day - day, 0, NULL) != BT_OK) return BT_ERROR_CANCELLED;
+    }
+    return BT_OK;
+}
+
+// Runs a single strategy. Options may be NULL for the defaults; the output
+// names the optional buffers and callbacks that receive the run.
+int bt_run(const BtDataset *dataset, const Strategy *strategy, const BtRunOptions *options,
+           BtRunOutput *output) {
+    BtRunOptions defaults;
+
+    if (!valid_dataset(dataset) || strategy == NULL || output == NULL) return BT_ERROR_ARGUMENT;
+    if (options == NULL) {
+        bt_default_options(&defaults);
+        options = &defaults;
+    }
+
+    Portfolio *portfolio = output->portfolio;
+    if (portfolio == NULL) {
+        portfolio = bt_allocate(&options->allocator, sizeof(Portfolio));
+        if (portfolio == NULL) return BT_ERROR_MEMORY;
+    }
+
+    ProgressSink sink;
+    int status = start_progress(&sink, options, bars_per_strategy(dataset), 1);
+    if (status == BT_OK) {
+        status = run_blocks(dataset, strategy, options, options->indicator_cache, portfolio, &sink, output);
+    }
+    if (status == BT_OK) {
+        calculate_strategy_result(portfolio, dataset->stocks, dataset->stock_count, options->initial_cash,
+                                  *strategy, &output->result, "-");
+        if (options->result_stats != NULL) result_stats_add(options->result_stats, &output->result);
+        advance_progress(&sink, 0, 0, &output->result);
+
+        output->trade_count = portfolio->trade_count;
+        output->trades_made = portfolio->trades_made;
+        if (output->trades != NULL && output->trade_capacity > 0) {
+            int copied = portfolio->trade_count < output->trade_capacity ? portfolio->trade_count
+                                                                         : output->trade_capacity;
+            memcpy(output->trades, portfolio->trades, sizeof(Trade) * (size_t)copied);
+        }
+    }
+
+    pthread_mutex_destroy(&sink.lock);
+    if (portfolio != output->portfolio) bt_release(&options->allocator, portfolio);
+    return status;
+}
+
+// Runs distinct fixed-parameter strategies side by side in blocks of bars,
+// one fused pass over the data per block
+static int run_fused_blocks(const BtDataset *dataset, const Strategy strategies[], const int lanes[],
+                            int lane_count, const BtRunOptions *options, IndicatorCache *cache,
+                            Portfolio portfolios[], ProgressSink *sink) {
+    const Strategy *group[BACKTEST_FUSED_WIDTH];
+    Portfolio *group_portfolios[BACKTEST_FUSED_WIDTH];
+    int max_days = dataset->stocks[0].day_count;
+    int block = options->block_bars > 0 ? options->block_bars : BT_DEFAULT_BLOCK_BARS;
+
+    for (int k = 0; k < lane_count; k++) {
+        group[k] = &strategies[lanes[k]];
+        group_portfolios[k] = &portfolios[k];
+        init_portfolio_mode(&portfolios[k], options->initial_cash, options->fixed_point);
+    }
+    for (int day = BACKTEST_FIRST_DAY; day < max_days; day += block) {
+        int end_day = day + block < max_days ? day + block : max_days;
+        int status = backtest_fused_window(dataset->stocks, dataset->stock_count, group, group_portfolios,
+                                           lane_count, day, end_day, cache, dataset->fingerprints);
+        if (status != BACKTEST_OK) return BT_ERROR_MEMORY;
+
+        if (advance_progress(sink, (long long)(end_day - day) * lane_count, 0, NULL) != BT_OK) {
+            return BT_ERROR_CANCELLED;
+        }
+    }
+    return BT_OK;
+}
+
+// Completes entry i of a batch from its final portfolio. The result goes
+// into the running thread's own sketch before the shared lock is taken.
+static int finish_strategy(const BtDataset *dataset, const Strategy strategies[],
+                           const char *const owners[], int i, const BtRunOptions *options,
+                           Portfolio *portfolio, ProgressSink *sink, ResultStats *stats,
+                           StrategyResult results[]) {
+    calculate_strategy_result(portfolio, dataset->stocks, dataset->stock_count, options->initial_cash,
+                              strategies[i], &results[i], owners != NULL ? owners[i] : "-");
+    if (stats != NULL) result_stats_add(stats, &results[i]);
+    return advance_progress(sink, 0, i, &results[i]);
+}
+
+// Runs exit-parameter variants of one entry configuration as a single
+// variant run, finishing each member's result at the end
+static int run_variant_blocks(const BtDataset *dataset, const Strategy strategies[], const int members[],
+                              int member_count, const char *const owners[], const BtRunOptions *options,
+                              IndicatorCache *cache, ProgressSink *sink, ResultStats *stats,
+                              StrategyResult results[], WorkerArena *arena) {
+    const Strategy **group = arena_alloc(arena, sizeof(*group) * (size_t)member_count);
+    VariantRun run;
+    int max_days = dataset->stocks[0].day_count;
+    int block = options->block_bars > 0 ? options->block_bars : BT_DEFAULT_BLOCK_BARS;
+    int status = BT_OK;
+
+    if (group == NULL) return BT_ERROR_MEMORY;
+    for (int k = 0; k < member_count; k++) group[k] = &strategies[members[k]];
+    if (variant_run_init(&run, group, member_count, options->initial_cash,
+                         options->fixed_point) != BACKTEST_OK) {
+        return BT_ERROR_MEMORY;
+    }
+
+    for (int day = BACKTEST_FIRST_DAY; day < max_days && status == BT_OK; day += block) {
+        int end_day = day + block < max_days ? day + block : max_days;
+        if (backtest_variants_window(&run, dataset->stocks, dataset->stock_count, day, end_day, cache,
+                                     dataset->fingerprints) != BACKTEST_OK) {
+            status = BT_ERROR_MEMORY;
+            break;
+        }
+        status = advance_progress(sink, (long long)(end_day - day) * member_count, 0, NULL);
+    }
+    for (int k = 0; k < member_count && status == BT_OK; k++) {
+        status = finish_strategy(dataset, strategies, owners, members[k], options, variant_portfolio(&run, k),
+                                 sink, stats, results);
+    }
+
+    variant_run_free(&run);
+    return status;
+}
+
+typedef struct {
+    unsigned long long hash;
+    int index;
+} EntryKey;
+
+static int compare_entry_keys(const void *a, const void *b) {
+    const EntryKey *x = (const EntryKey *)a;
+    const EntryKey *y = (const EntryKey *)b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return x->index - y->index;
+}
+
+// How bt_run_batch runs each distinct strategy
+enum { RUN_ALONE, RUN_FUSED, RUN_VARIANT };
+
+// Gathers distinct strategies sharing an entry configuration into variant
+// groups of two or more, stored back to back in variants[] with group g
+// ending at group_ends[g]. Returns the group count, or -1 if out of memory.
+static int group_variants(const Strategy strategies[], int count, const int first[], int mode[],
+                          int variants[], int group_ends[], const BtAllocator *allocator) {
+    EntryKey *keys = bt_allocate(allocator, sizeof(EntryKey) * (size_t)count);
+    int key_count = 0, group_count = 0, variant_count = 0;
+
+    if (keys == NULL) return -1;
+    for (int i = 0; i < count; i++) {
+        if (first[i] != i || !strategy_is_fusable(&strategies[i])) continue;
+        keys[key_count].hash = strategy_entry_hash(&strategies[i]);
+        keys[key_count].index = i;
+        key_count++;
+    }
+    qsort(keys, (size_t)key_count, sizeof(EntryKey), compare_entry_keys);
+
+    for (int k = 0; k < key_count; k++) {
+        int lead = keys[k].index;
+        int start = variant_count;
+        if (lead < 0) continue;
+
+        // Equal hashes sort together; the parameters decide membership
+        for (int j = k; j < key_count && keys[j].hash == keys[k].hash; j++) {
+            if (keys[j].index >= 0 && strategies_share_entry(&strategies[lead], &strategies[keys[j].index])) {
+                variants[variant_count++] = keys[j].index;
+                keys[j].index = -1;
+            }
+        }
+        if (variant_count - start >= 2) {
+            for (int j = start; j < variant_count; j++) mode[variants[j]] = RUN_VARIANT;
+            group_ends[group_count++] = variant_count;
+        } else {
+            variant_count = start;
+        }
+    }
+    bt_release(allocator, keys);
+    return group_count;
+}
+
+// One unit of a batch: a variant group, a fused pass over up to
+// BACKTEST_FUSED_WIDTH lanes, or one strategy run alone
+typedef struct {
+    int mode;
+    const int *members;                 // entry indices
+    int member_count;
+} BatchTask;
+
+typedef struct {
+    const BtDataset *dataset;
+    const Strategy *strategies;
+    const char *const *owners;
+    const BtRunOptions *options;
+    IndicatorCache *cache;
+    ProgressSink *sink;
+    StrategyResult *results;
+    const BatchTask *tasks;
+    ResultStats **worker_stats;         // scheduled runs: one sketch per worker, made on first use
+    int status;                         // first failure; later tasks are skipped
+} BatchRun;
+
+// The sketch results from this worker go into: the caller's own when the
+// batch runs on one thread, NULL if the caller keeps none
+static ResultStats *worker_result_stats(BatchRun *batch, int worker) {
+    if (batch->options->result_stats == NULL || batch->worker_stats == NULL) {
+        return batch->options->result_stats;
+    }
+    if (batch->worker_stats[worker] == NULL) {
+        ResultStats *stats = malloc(sizeof(ResultStats));
+        if (stats != NULL) result_stats_init(stats);
+        batch->worker_stats[worker] = stats;
+    }
+    return batch->worker_stats[worker];
+}
+
+// Portfolios come from the worker's arena, which is reset after the task
+static void run_batch_task(void *context, int t, int worker, WorkerArena *arena) {
+    BatchRun *batch = (BatchRun *)context;
+    const BatchTask *task = &batch->tasks[t];
+    int status = BT_ERROR_MEMORY;
+
+    if (__atomic_load_n(&batch->status, __ATOMIC_ACQUIRE) != BT_OK) return;
+    ResultStats *stats = worker_result_stats(batch, worker);
+    if (stats == NULL && batch->options->result_stats != NULL) {
+        status = BT_ERROR_MEMORY;
+    } else if (task->mode == RUN_VARIANT) {
+        status = run_variant_blocks(batch->dataset, batch->strategies, task->members, task->member_count,
+                                    batch->owners, batch->options, batch->cache, batch->sink, stats,
+                                    batch->results, arena);
+    } else {
+        Portfolio *portfolios = arena_alloc(arena, sizeof(Portfolio) * (size_t)task->member_count);
+        if (portfolios != NULL && task->mode == RUN_FUSED) {
+            status = run_fused_blocks(batch->dataset, batch->strategies, task->members, task->member_count,
+                                      batch->options, batch->cache, portfolios, batch->sink);
+        } else if (portfolios != NULL) {
+            status = run_blocks(batch->dataset, &batch->strategies[task->members[0]], batch->options,
+                                batch->cache, portfolios, batch->sink, NULL);
+        }
+        for (int k = 0; k < task->member_count && status == BT_OK; k++) {
+            status = finish_strategy(batch->dataset, batch->strategies, batch->owners, task->members[k],
+                                     batch->options, &portfolios[k], batch->sink, stats, batch->results);
+        }
+    }
+    if (status != BT_OK) {
+        int expected = BT_OK;
+        __atomic_compare_exchange_n(&batch->status, &expected, status, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+}
+
+static int compare_batch_tasks(const void *a, const void *b) {
+    const BatchTask *x = (const BatchTask *)a;
+    const BatchTask *y = (const BatchTask *)b;
+    if (x->member_count != y->member_count) return y->member_count - x->member_count;
+    return (x->members > y->members) - (x->members < y->members);
+}
+
+// Runs a line-up of strategies into results[0..count). Each distinct
+// parameter set runs once and its result is copied to every entry sharing
+// it. owners may be NULL; otherwise owners[i] names the owner of entry i.
+// With options->prefix_sharing, strategies differing only in their exits
+// share one variant run; with options->fused, the remaining fixed-parameter
+// strategies share fused passes. Rule strategies run one at a time. With
+// options->scheduler these units are queued on its workers largest first,
+// which puts the largest where idle workers steal from, and the progress
+// and result callbacks come from those threads, one call at a time.
+int bt_run_batch(const BtDataset *dataset, const Strategy strategies[], int count,
+                 const char *const owners[], const BtRunOptions *options, StrategyResult results[]) {
+    BtRunOptions defaults;
+
+    if (!valid_dataset(dataset) || count < 0 || (count > 0 && (strategies == NULL || results == NULL))) {
+        return BT_ERROR_ARGUMENT;
+    }
+    if (options == NULL) {
+        bt_default_options(&defaults);
+        options = &defaults;
+    }
+    if (count == 0) return BT_OK;
+
+    int *first = bt_allocate(&options->allocator, sizeof(int) * (size_t)count * 6);
+    BatchTask *tasks = bt_allocate(&options->allocator, sizeof(BatchTask) * (size_t)count);
+    if (first == NULL || tasks == NULL) {
+        bt_release(&options->allocator, first);
+        bt_release(&options->allocator, tasks);
+        return BT_ERROR_MEMORY;
+    }
+    int *mode = first + count;
+    int *lanes = mode + count;
+    int *variants = lanes + count;
+    int *group_ends = variants + count;
+    int *alone = group_ends + count;
+
+    int distinct = dedupe_strategies(strategies, count, first);
+    int group_count = 0;
+    for (int i = 0; i < count; i++) mode[i] = RUN_ALONE;
+    if (options->prefix_sharing) {
+        group_count = group_variants(strategies, count, first, mode, variants, group_ends,
+                                     &options->allocator);
+        if (group_count < 0) {
+            bt_release(&options->allocator, first);
+            bt_release(&options->allocator, tasks);
+            return BT_ERROR_MEMORY;
+        }
+    }
+    int lane_count = 0, alone_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (first[i] != i || mode[i] != RUN_ALONE) continue;
+        if (options->fused && strategy_is_fusable(&strategies[i])) {
+            mode[i] = RUN_FUSED;
+            lanes[lane_count++] = i;
+        } else {
+            alone[alone_count++] = i;
+        }
+    }
+
+    // Variant groups, then fused passes, then the strategies run alone
+    int task_count = 0;
+    for (int g = 0; g < group_count; g++) {
+        int start = g > 0 ? group_ends[g - 1] : 0;
+        BatchTask task = { RUN_VARIANT, variants + start, group_ends[g] - start };
+        tasks[task_count++] = task;
+    }
+    for (int g = 0; g < lane_count; g += BACKTEST_FUSED_WIDTH) {
+        int n = lane_count - g < BACKTEST_FUSED_WIDTH ? lane_count - g : BACKTEST_FUSED_WIDTH;
+        BatchTask task = { RUN_FUSED, lanes + g, n };
+        tasks[task_count++] = task;
+    }
+    for (int a = 0; a < alone_count; a++) {
+        BatchTask task = { RUN_ALONE, alone + a, 1 };
+        tasks[task_count++] = task;
+    }
+
+    // Every distinct indicator is computed once for the whole batch
+    IndicatorCache own_cache;
+    IndicatorCache *cache = options->indicator_cache;
+    if (cache == NULL && indicator_cache_init(&own_cache, INDICATOR_CACHE_DEFAULT_BUDGET) == 0) {
+        cache = &own_cache;
+    }
+
+    ProgressSink sink;
+    BatchRun batch = { dataset, strategies, owners, options, cache, &sink, results, tasks, NULL, BT_OK };
+    batch.status = start_progress(&sink, options, distinct * bars_per_strategy(dataset), distinct);
+
+    if (batch.status == BT_OK && options->scheduler != NULL) {
+        // One slot per worker and one for this thread
+        int slots = options->scheduler->worker_count + 1;
+        if (options->result_stats != NULL) {
+            batch.worker_stats = calloc((size_t)slots, sizeof(ResultStats *));
+            if (batch.worker_stats == NULL) batch.status = BT_ERROR_MEMORY;
+        }
+        if (batch.status == BT_OK) {
+            qsort(tasks, (size_t)task_count, sizeof(BatchTask), compare_batch_tasks);
+            scheduler_run(options->scheduler, task_count, run_batch_task, &batch);
+        }
+        for (int w = 0; batch.worker_stats != NULL && w < slots; w++) {
+            if (batch.worker_stats[w] == NULL) continue;
+            result_stats_merge(options->result_stats, batch.worker_stats[w]);
+            free(batch.worker_stats[w]);
+        }
+        free(batch.worker_stats);
+    } else if (batch.status == BT_OK) {
+        // In order on this thread, with scratch for the widest fused pass
+        int width = lane_count < BACKTEST_FUSED_WIDTH ? lane_count : BACKTEST_FUSED_WIDTH;
+        size_t scratch_size = sizeof(Portfolio) * (size_t)(width > 0 ? width : 1) + ARENA_ALIGN;
+        void *scratch = bt_allocate(&options->allocator, scratch_size);
+        WorkerArena arena;
+
+        arena_init(&arena, scratch, scratch != NULL ? scratch_size : 0);
+        for (int t = 0; t < task_count && batch.status == BT_OK; t++) {
+            run_batch_task(&batch, t, 0, &arena);
+            arena_reset(&arena);
+        }
+        arena_free(&arena);
+        bt_release(&options->allocator, scratch);
+    }
+    int status = batch.status;
+
+    for (int i = 0; i < count && status == BT_OK; i++) {
+        if (first[i] == i) continue;
+        share_strategy_result(&results[i], &results[first[i]], strategies[i].name,
+                              owners != NULL ? owners[i] : "-");
+        if (options->result_stats != NULL) result_stats_add(options->result_stats, &results[i]);
+        if (options->on_result != NULL) options->on_result(options->result_context, i, &results[i]);
+    }
+
+    pthread_mutex_destroy(&sink.lock);
+    if (cache == &own_cache) indicator_cache_free(&own_cache);
+    bt_release(&options->allocator, first);
+    bt_release(&options->allocator, tasks);
+    return status;
+}
+
+const char *bt_error_string(int code) {
+    switch (code) {
+        case BT_OK: return "success";
+        case BT_ERROR_ARGUMENT: return "invalid argument";
+        case BT_ERROR_IO: return "could not read the data file";
+        case BT_ERROR_FORMAT: return "unrecognised or empty data file";
+        case BT_ERROR_MEMORY: return "out of memory";
+        case BT_ERROR_RULE: return "invalid strategy rule";
+        case BT_ERROR_CANCELLED: return "cancelled";
+        default: return "unknown error";
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef LIBBACKTEST_H
+#define LIBBACKTEST_H
+
+#include <stddef.h>
+#include "structures.h"
+#include "indicator_cache.h"
+#include "result_stats.h"
+#include "symbols.h"
+#include "scheduler.h"
+#include "analytics.h"
+
+// Embeddable engine API, built as libbacktest.a / libbacktest.so. Nothing
+// here reads stdin or writes stdout: every call reports through its return
+// code. Calls share no mutable state besides the symbol dictionary, which
+// is safe across threads, so any number of threads may run backtests at
+// once, including over the same dataset, which is only read. Stocks and
+// trades name their symbol by id; symbol_name() gives the text.
+
+#define BT_OK 0
+#define BT_ERROR_ARGUMENT -1
+#define BT_ERROR_IO -2
+#define BT_ERROR_FORMAT -3
+#define BT_ERROR_MEMORY -4
+#define BT_ERROR_RULE -5
+#define BT_ERROR_CANCELLED -6
+
+// Bars between progress callbacks unless the options say otherwise
+#define BT_DEFAULT_BLOCK_BARS 128
+
+// Where the library gets the memory it keeps for the caller (datasets and
+// per-run portfolios). Leaving allocate NULL means malloc/free.
+typedef struct {
+    void *(*allocate)(void *context, size_t size);
+    void (*release)(void *context, void *pointer);
+    void *context;
+} BtAllocator;
+
+// Market data for runs. A borrowed dataset points at the caller's stocks;
+// a loaded one owns them and frees them through its allocator. The
+// fingerprints identify each symbol's bars to the indicator cache. A
+// loaded CSV keeps its first MAX_STOCKS symbols and each one's most recent
+// MAX_DAYS bars; the dropped counts say what did not fit.
+typedef struct {
+    Stock *stocks;
+    int stock_count;
+    unsigned long long fingerprints[MAX_STOCKS];
+    int owned;
+    BtAllocator allocator;
+    int dropped_symbols;
+    long long dropped_bars;
+} BtDataset;
+
+typedef struct {
+    long long bars_done;
+    long long bars_total;
+    int strategies_done;
+    int strategies_total;
+} BtProgress;
+
+// Called before the first bar, after every block and as each strategy
+// completes. Returning nonzero cancels the run, which then returns
+// BT_ERROR_CANCELLED.
+typedef int (*BtProgressFn)(void *context, const BtProgress *progress);
+// Called for each logged trade, in order, as the run produces them
+typedef void (*BtTradeFn)(void *context, const Trade *trade);
+// Called with entry index's result as soon as it is final, so callers can
+// summarize a batch without waiting for or keeping every result
+typedef void (*BtResultFn)(void *context, int index, const StrategyResult *result);
+
+typedef struct {
+    double initial_cash;
+    int fixed_point;                    // exact integer-tick accounting
+    int block_bars;
+    int fused;                          // batches evaluate strategies side by side
+    int prefix_sharing;                 // exit variants share their common history
+    BtProgressFn progress;              // optional
+    void *progress_context;
+    BtResultFn on_result;               // optional
+    void *result_context;
+    // Optional: every result's metrics are added to it. Batch workers keep
+    // sketches of their own, merged into it once the batch is done.
+    ResultStats *result_stats;
+    BtAllocator allocator;
+    // Optional, shared read-only by every run given it. Without one,
+    // bt_run_batch shares a cache of its own across the batch.
+    IndicatorCache *indicator_cache;
+    // Optional: bt_run_batch splits the batch into tasks on its workers.
+    // Without one the batch runs on the calling thread.
+    Scheduler *scheduler;
+} BtRunOptions;
+
+typedef struct {
+    Portfolio *portfolio;               // optional: receives the final portfolio
+    Trade *trades;                      // optional: receives the first trade_capacity trades
+    int trade_capacity;
+    BtTradeFn on_trade;                 // optional
+    void *trade_context;
+
+    // Filled in by bt_run
+    StrategyResult result;
+    int trade_count;                    // trades logged, even beyond trade_capacity
+    int trades_made;                    // every trade; above trade_count once the log filled up
+} BtRunOutput;
+
+void bt_default_options(BtRunOptions *options);
+int bt_dataset_borrow(BtDataset *dataset, Stock stocks[], int stock_count);
+int bt_dataset_load(BtDataset *dataset, const char *path, const BtAllocator *allocator);
+void bt_dataset_free(BtDataset *dataset);
+int bt_covariance(const BtDataset *dataset, int window, int threads, CovarianceMatrix *matrix);
+int bt_validate_strategy(const Strategy *strategy, char *error, int error_size);
+int bt_run(const BtDataset *dataset, const Strategy *strategy, const BtRunOptions *options,
+           BtRunOutput *output);
+int bt_run_batch(const BtDataset *dataset, const Strategy strategies[], int count,
+                 const char *const owners[], const BtRunOptions *options, StrategyResult results[]);
+const char *bt_error_string(int code);
+
+#endif
@@ -1,16 +1,603 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/select.h>
+#include <unistd.h>
 #include "structures.h"
 #include "user_management.h"
 #include "stock_data.h"
+#include "stock_files.h"
 #include "backtest.h"
+#include "market_gen.h"
+#include "tick_ingest.h"
+#include "checkpoint.h"
+#include "column_codec.h"
+#include "data_index.h"
+#include "report.h"
+#include "jobs.h"
+#include "sweep.h"
+#include "result_stats.h"
+#include "results_store.h"
 
-int main() {
-    Stock stocks[MAX_STOCKS];
+// Handles "--generate SYMBOLS DAYS [--seed N] [--threads N] [--binary] [--output FILE]
+// [--drift X] [--volatility X] [--jumps-per-year X] [--jump-mean X] [--jump-stddev X]".
+// Drift and volatility are annualized; jump sizes are in log return.
+static int run_generator(int argc, char *argv[]) {
+    MarketGenConfig config;
+    const char *output = NULL;
+
+    default_market_gen_config(&config);
+    if (argc < 4) {
+        printf("Usage: %s --generate SYMBOLS DAYS [--seed N] [--threads N] [--binary] [--output FILE]\n"
+               "         [--drift X] [--volatility X] [--jumps-per-year X] [--jump-mean X] [--jump-stddev X]\n",
+               argv[0]);
+        return 1;
+    }
+    config.symbol_count = atoi(argv[2]);
+    config.day_count = atoi(argv[3]);
+
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            config.binary = 1;
+        } else if (strcmp(argv[i], "--drift") == 0 && i + 1 < argc) {
+            config.drift = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--volatility") == 0 && i + 1 < argc) {
+            config.volatility = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--jumps-per-year") == 0 && i + 1 < argc) {
+            config.jumps_per_year = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--jump-mean") == 0 && i + 1 < argc) {
+            config.jump_mean = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--jump-stddev") == 0 && i + 1 < argc) {
+            config.jump_stddev = strtod(argv[++i], NULL);
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (config.volatility < 0.0 || config.jumps_per_year < 0.0 || config.jump_stddev < 0.0) {
+        printf("Error: volatility, jumps per year and jump stddev cannot be negative!\n");
+        return 1;
+    }
+    if (output == NULL) output = config.binary ? "stock_data.bin" : "stock_data.csv";
+
+    printf("Generating %d symbols x %d days into '%s'...\n", config.symbol_count, config.day_count, output);
+    if (generate_market_data(&config, output) != 0) return 1;
+    printf("✓ Done.\n");
+    return 0;
+}
+
+// Asks for an export file; the extension picks text, CSV or JSON.
+// Leaves the path empty if the user skips.
+static void prompt_export_path(char path[256]) {
+    printf("\nExport results to a file (.txt, .csv or .json, '-' to skip): ");
+    if (scanf("%255s", path) != 1 || strcmp(path, "-") == 0) {
+        path[0] = '\0';
+    }
+}
+
+// Discards the rest of the current input line
+static void skip_line(void) {
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF) {
+    }
+}
+
+// Redraws the progress of one job (or all jobs when job is NULL) until the
+// watched jobs stop or the user presses Enter. Returns 1 if they stopped.
+static int watch_jobs(JobTable *table, Job *job) {
+    printf("\nWatching progress, press Enter to return to the menu...\n");
+    skip_line();
+    for (;;) {
+        int running = job != NULL ? job_state(job) == JOB_RUNNING : running_job_count(table) > 0;
+
+        printf("\r");
+        for (int i = 0; i < MAX_JOBS; i++) {
+            Job *shown = &table->jobs[i];
+            if (!shown->in_use || (job != NULL && shown != job)) continue;
+            printf("#%d %5.1f%%  ", shown->id, job_percent(shown));
+        }
+        fflush(stdout);
+        if (!running) {
+            printf("\n");
+            return 1;
+        }
+
+        fd_set input;
+        struct timeval wait = { 0, 200000 };
+        FD_ZERO(&input);
+        FD_SET(STDIN_FILENO, &input);
+        if (select(STDIN_FILENO + 1, &input, NULL, NULL, &wait) > 0) {
+            skip_line();
+            printf("\n");
+            return 0;
+        }
+    }
+}
+
+// Prints a stopped job's results, offers an export and frees its slot
+static void show_job_results(Job *job, Stock stocks[], int stock_count) {
+    char export_path[256];
+
+    if (job_state(job) == JOB_CANCELLED) {
+        printf("\nJob #%d was cancelled.\n", job->id);
+        release_job(job);
+        return;
+    }
+    if (job_state(job) == JOB_FAILED) {
+        printf("\nError: job #%d failed: %s!\n", job->id, bt_error_string(job->status));
+        release_job(job);
+        return;
+    }
+    if (job->kind == JOB_SINGLE) {
+        printf("\nStrategy: %s\n", job->strategies[0].name);
+        print_detailed_results(job->portfolio, stocks, stock_count, job->initial_cash);
+        prompt_export_path(export_path);
+        if (export_path[0] != '\0' &&
+            export_backtest(export_path, job->portfolio, stocks, stock_count, job->initial_cash) == 0) {
+            printf("✓ Results written to '%s'\n", export_path);
+        }
+    } else {
+        if (job->kind == JOB_SWEEP) {
+            print_sweep_results(job->results, job->strategy_count, 20);
+            print_result_stats(&job->stats);
+            if (job->sweep_id > 0) {
+                printf("\n✓ %d parameter sets stored in '%s' as sweep %d (explore with --query)\n",
+                       job->strategy_count, RESULTS_STORE_DIR, job->sweep_id);
+            } else {
+                printf("\nError storing the sweep in '%s'!\n", RESULTS_STORE_DIR);
+            }
+            printf("\nSave the distribution for --merge-stats ('-' to skip): ");
+            if (scanf("%255s", export_path) == 1 && strcmp(export_path, "-") != 0) {
+                if (result_stats_save(export_path, &job->stats) == 0) {
+                    printf("✓ Distribution written to '%s'\n", export_path);
+                } else {
+                    printf("Error writing '%s'!\n", export_path);
+                }
+            }
+        } else {
+            compare_strategies(job->results, job->strategy_count);
+        }
+        prompt_export_path(export_path);
+        if (export_path[0] != '\0' && export_comparison(export_path, job->results, job->strategy_count) == 0) {
+            printf("✓ Comparison written to '%s'\n", export_path);
+        }
+    }
+    release_job(job);
+}
+
+// Offers to follow a freshly submitted job in the foreground
+static void follow_job(JobTable *table, Job *job, Stock stocks[], int stock_count) {
+    char answer[8];
+
+    printf("✓ Job #%d started in the background.\n", job->id);
+    printf("Wait for it here? (y/n): ");
+    if (scanf("%7s", answer) != 1 || (answer[0] != 'y' && answer[0] != 'Y')) {
+        printf("Its progress is shown under Background Jobs.\n");
+        return;
+    }
+    if (watch_jobs(table, job)) {
+        show_job_results(job, stocks, stock_count);
+        printf("\nPress Enter to continue...");
+        getchar();
+        getchar();
+    }
+}
+
+static void jobs_menu(JobTable *table, Stock stocks[], int stock_count) {
+    for (;;) {
+        int choice, id;
+
+        printf("\n╔═══════════════════════════════════════════════════════════════════════════╗\n");
+        printf("║                          BACKGROUND JOBS                                  ║\n");
+        printf("╚═══════════════════════════════════════════════════════════════════════════╝\n");
+        print_job_table(table);
+        printf("\n1. Refresh\n");
+        printf("2. Watch Progress\n");
+        printf("3. View Results of a Finished Job\n");
+        printf("4. Cancel a Job\n");
+        printf("5. Back\n");
+        printf("\nEnter choice: ");
+        if (scanf("%d", &choice) != 1) {
+            skip_line();
+            continue;
+        }
+
+        if (choice == 1) continue;
+        if (choice == 2) {
+            watch_jobs(table, NULL);
+            continue;
+        }
+        if (choice == 5) return;
+        if (choice != 3 && choice != 4) {
+            printf("\n❌ Invalid choice! Please try again.\n");
+            continue;
+        }
+
+        printf("Job number: ");
+        Job *job = scanf("%d", &id) == 1 ? find_job(table, id) : NULL;
+        if (job == NULL) {
+            printf("\n❌ No such job.\n");
+        } else if (choice == 4) {
+            cancel_job(job);
+            printf("✓ Cancellation requested for job #%d.\n", job->id);
+        } else if (job_state(job) == JOB_RUNNING) {
+            printf("\nJob #%d is still running (%.1f%%).\n", job->id, job_percent(job));
+        } else {
+            show_job_results(job, stocks, stock_count);
+        }
+    }
+}
+
+// One of the user's strategies, or a preset if they pick one or have none
+static void choose_strategy(User *user, const StrategyCatalog *catalog, Strategy *strategy) {
+    if (user->strategy_count > 0) {
+        printf("\n╔═══════════════════════════════════════════════════════════════════════════╗\n");
+        printf("║                        SELECT STRATEGY                                    ║\n");
+        printf("╚═══════════════════════════════════════════════════════════════════════════╝\n");
+        show_user_strategies(user, catalog);
+        *strategy = select_user_strategy(user, catalog);
+
+        // If user selected preset (flag = -1)
+        if (strategy->sma_short_period == -1) {
+            get_preset_strategy(strategy);
+        }
+    } else {
+        printf("\nNo custom strategies found. Please select a preset strategy.\n");
+        get_preset_strategy(strategy);
+    }
+}
+
+// Reads "from to step" for one swept parameter; returns -1 on bad input
+static int prompt_sweep_range(const char *label, SweepRange *range) {
+    printf("%s (from to step, step 0 for a single value): ", label);
+    if (scanf("%lf %lf %lf", &range->from, &range->to, &range->step) != 3) {
+        skip_line();
+        printf("\n❌ Expected three numbers.\n");
+        return -1;
+    }
+    if (range->step == 0.0) range->to = range->from;
+    return 0;
+}
+
+// Handles "--compress CSV OUTPUT": converts a CSV price file to the compressed store
+static int run_compress(int argc, char *argv[]) {
+    CodecStats stats;
+
+    if (argc != 4) {
+        printf("Usage: %s --compress CSV OUTPUT\n", argv[0]);
+        return 1;
+    }
+    if (compress_stock_csv(argv[2], argv[3], &stats) != 0) return 1;
+    if (stats.regrouped) printf("✓ Rows were not grouped by symbol; regrouped them by symbol and date\n");
+    printf("✓ %lld rows in %lld blocks: %lld -> %lld bytes (%.1fx)\n", stats.rows, stats.blocks,
+           stats.bytes_in, stats.bytes_out,
+           stats.bytes_out > 0 ? (double)stats.bytes_in / stats.bytes_out : 0.0);
+    return 0;
+}
+
+// Handles "--merge-stats OUTPUT INPUT...": combines distributions saved by
+// separate sweeps or processes into one, written to OUTPUT unless it is "-"
+static int run_merge_stats(int argc, char *argv[]) {
+    static ResultStats merged, part;
+
+    if (argc < 4) {
+        printf("Usage: %s --merge-stats OUTPUT INPUT...\n", argv[0]);
+        return 1;
+    }
+    result_stats_init(&merged);
+    for (int i = 3; i < argc; i++) {
+        if (result_stats_load(argv[i], &part) != 0) {
+            printf("Error reading distribution '%s'!\n", argv[i]);
+            return 1;
+        }
+        result_stats_merge(&merged, &part);
+    }
+    print_result_stats(&merged);
+    if (strcmp(argv[2], "-") != 0) {
+        if (result_stats_save(argv[2], &merged) != 0) {
+            printf("Error writing '%s'!\n", argv[2]);
+            return 1;
+        }
+        printf("✓ Merged %d distributions into '%s'\n", argc - 3, argv[2]);
+    }
+    return 0;
+}
+
+static int parse_column_option(const char *name, int *column) {
+    *column = store_column_index(name);
+    if (*column >= 0) return 0;
+    printf("Unknown column '%s'! Columns:", name);
+    for (int i = 0; i < STORE_COLUMN_COUNT; i++) printf(" %s", store_column_name(i));
+    printf("\n");
+    return -1;
+}
+
+// Handles "--query [--store DIR] [--where FILTER] [--group COLUMN] [--rank COLUMN] [--asc] [--top N]":
+// filters, groups and ranks every stored sweep without rerunning anything
+static int run_query(int argc, char *argv[]) {
+    const char *dir = RESULTS_STORE_DIR;
+    const char *filter = "";
+    StoreQuery query;
+    ResultsStore store;
+    QueryResult result;
+    char error[160];
+
+    store_query_init(&query);
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--where") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--group") == 0 && i + 1 < argc) {
+            if (parse_column_option(argv[++i], &query.group_column) != 0) return 1;
+        } else if (strcmp(argv[i], "--rank") == 0 && i + 1 < argc) {
+            if (parse_column_option(argv[++i], &query.rank_column) != 0) return 1;
+        } else if (strcmp(argv[i], "--asc") == 0) {
+            query.ascending = 1;
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            query.limit = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s --query [--store DIR] [--where FILTER] [--group COLUMN] [--rank COLUMN] [--asc] "
+                   "[--top N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (query.limit <= 0) {
+        printf("Error: --top needs a positive count!\n");
+        return 1;
+    }
+    if (parse_store_filter(filter, &query, error, sizeof(error)) != 0) {
+        printf("Error in filter: %s!\n", error);
+        return 1;
+    }
+    if (results_store_open(&store, dir) != 0) {
+        printf("Error: no results store in '%s'! Run a sweep first.\n", dir);
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = run_store_query(&store, &query, &result);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (status != 0) {
+        printf("Error reading the results store in '%s'!\n", dir);
+        results_store_close(&store);
+        return 1;
+    }
+
+    print_query_result(&store, &query, &result);
+    printf("\n%lld of %lld rows (%d sweeps) matched in %.1f ms\n", result.rows_matched, store.rows, store.sweeps,
+           (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    free_query_result(&result);
+    results_store_close(&store);
+    return 0;
+}
+
+// Where the market data comes from, as given on the command line
+typedef struct {
+    const char *tick_path;
+    int bar_seconds;
+    const char *data_path;
+    const char *symbols[MAX_STOCKS];
+    int symbol_count;
+    const char *from_date;
+    const char *to_date;
+    int regenerate;
+} DataSource;
+
+// Loads the market data on first use; later calls return at once.
+// Returns -1 if nothing could be loaded.
+static int ensure_market_data(DataSource *source, Stock stocks[], int *stock_count, int *loaded) {
+    if (*loaded) return 0;
+
+    if (source->tick_path != NULL) {
+        // Aggregate raw ticks straight into bars
+        TickIngestStats tick_stats;
+        printf("Aggregating ticks from '%s' into %d-second bars...\n", source->tick_path, source->bar_seconds);
+        if (load_tick_bars(source->tick_path, source->bar_seconds, stocks, stock_count, &tick_stats) != 0) {
+            return -1;
+        }
+        printf("✓ %lld ticks -> %lld bars for %d symbols (%lld rejected, %lld late)\n",
+               tick_stats.ticks, tick_stats.bars, tick_stats.symbols,
+               tick_stats.rejected, tick_stats.late);
+        printf("✓ Aligned on a common grid: %lld empty intervals filled, %lld early bars dropped\n",
+               tick_stats.filled, tick_stats.trimmed);
+        if (tick_stats.truncated > 0) {
+            printf("Warning: only the most recent %d intervals fit; %lld older bars were dropped!\n",
+                   MAX_DAYS, tick_stats.truncated);
+        }
+    } else if (source->data_path != NULL) {
+        // Only the index chunks overlapping the selection are read
+        SubsetStats subset_stats;
+        printf("Loading stock data from '%s'...\n", source->data_path);
+        if (load_stock_subset(source->data_path, source->symbols, source->symbol_count, source->from_date,
+                              source->to_date, stocks, stock_count, &subset_stats) != 0) {
+            return -1;
+        }
+        printf("✓ Read %d of %d chunks, kept %lld bars\n", subset_stats.chunks_read,
+               subset_stats.chunks_total, subset_stats.rows_kept);
+    } else {
+        // Existing data is kept so runs stay reproducible
+        struct stat info;
+        if (source->regenerate || stat("stock_data.csv", &info) != 0) {
+            printf("Preparing stock data...\n");
+            create_sample_csv();
+            printf("✓ Stock data file 'stock_data.csv' created successfully!\n");
+        }
+        if (load_stock_data_cached(stocks, stock_count)) {
+            printf("✓ Loaded stock data from snapshot '%s'\n", STOCK_SNAPSHOT_PATH);
+        }
+    }
+    if (*stock_count == 0) {
+        printf("\n❌ No stock data available.\n");
+        return -1;
+    }
+    if (!stocks_aligned(stocks, *stock_count)) {
+        printf("\n❌ Error: stocks have different numbers of bars; every symbol needs a bar for every date!\n");
+        return -1;
+    }
+    printf("✓ Loaded %d stocks with historical data\n", *stock_count);
+    *loaded = 1;
+    return 0;
+}
+
+// Handles "--refresh [--data FILE | --ticks FILE [--bars 5m]] [--fixed-point]":
+// brings every saved strategy's checkpoint up to date with the current data,
+// processing only bars appended since the last run
+static int run_refresh(int argc, char *argv[]) {
+    static Stock stocks[MAX_STOCKS];
+    static User users[MAX_USERS];
+    static Portfolio portfolio;
+    StrategyCatalog catalog;
+    DataSource source;
+    int stock_count = 0, user_count = 0, data_loaded = 0;
+    int fixed_point = 0;
+    double initial_cash = 100000.0;
+
+    memset(&source, 0, sizeof(source));
+    source.bar_seconds = 86400;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--fixed-point") == 0) {
+            fixed_point = 1;
+        } else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            source.data_path = argv[++i];
+        } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            source.tick_path = argv[++i];
+        } else if (strcmp(argv[i], "--bars") == 0 && i + 1 < argc) {
+            source.bar_seconds = parse_bar_resolution(argv[++i]);
+            if (source.bar_seconds <= 0) {
+                printf("Invalid bar resolution '%s' (use e.g. 1m, 5m, 1h, 1d)\n", argv[i]);
+                return 1;
+            }
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // Refreshing against freshly generated sample data would mean nothing
+    struct stat info;
+    if (source.data_path == NULL && source.tick_path == NULL && stat("stock_data.csv", &info) != 0) {
+        printf("Error: no data to refresh against; stock_data.csv is missing (use --data FILE)!\n");
+        return 1;
+    }
+    if (ensure_market_data(&source, stocks, &stock_count, &data_loaded) != 0) return 1;
+
+    catalog_init(&catalog);
+    load_users(users, &user_count, &catalog);
+    mkdir("checkpoints", 0755);
+
+    // Each distinct parameter set runs once; every user saving it shares the result
+    for (int e = 0; e < catalog.count; e++) {
+        const CatalogEntry *entry = &catalog.entries[e];
+        StrategyResult result;
+        char path[64];
+
+        if (entry->ref_count == 0) continue;
+        snprintf(path, sizeof(path), "checkpoints/%016llx.ckpt", entry->hash);
+        int processed = backtest_incremental(stocks, stock_count, entry->strategy, initial_cash, fixed_point,
+                                             &portfolio, path);
+        if (processed < 0) continue;
+        calculate_strategy_result(&portfolio, stocks, stock_count, initial_cash, entry->strategy,
+                                  &result, "-");
+        for (int u = 0; u < user_count; u++) {
+            for (int i = 0; i < users[u].strategy_count; i++) {
+                if (users[u].strategies[i].hash != entry->hash) continue;
+                printf("%-20s %-30s %5d new bars  return %8.2f%%\n",
+                       users[u].username, users[u].strategies[i].name, processed, result.return_pct);
+            }
+        }
+    }
+    free_users(users, user_count);
+    catalog_free(&catalog);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--refresh") == 0) {
+        return run_refresh(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--generate") == 0) {
+        return run_generator(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--compress") == 0) {
+        return run_compress(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--merge-stats") == 0) {
+        return run_merge_stats(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--query") == 0) {
+        return run_query(argc, argv);
+    }
+
+    // Optional input: "--ticks FILE [--bars 5m]" for intraday ticks or
+    // "--data FILE [--symbols A,B] [--from DATE] [--to DATE]" for a CSV or
+    // compressed file loaded through its index, "--regenerate" to rewrite
+    // the sample data, "--fixed-point" for integer cash and price accounting,
+    // and "--workers N" / "--pin cpu|node" for the background job scheduler
+    DataSource source;
+    SchedulerOptions scheduler_options;
+    int fixed_point = 0;
+    memset(&source, 0, sizeof(source));
+    memset(&scheduler_options, 0, sizeof(scheduler_options));
+    source.bar_seconds = 86400;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            source.tick_path = argv[++i];
+        } else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            source.data_path = argv[++i];
+        } else if (strcmp(argv[i], "--symbols") == 0 && i + 1 < argc) {
+            for (char *name = strtok(argv[++i], ","); name != NULL && source.symbol_count < MAX_STOCKS;
+                 name = strtok(NULL, ",")) {
+                source.symbols[source.symbol_count++] = name;
+            }
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            source.from_date = argv[++i];
+        } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            source.to_date = argv[++i];
+        } else if (strcmp(argv[i], "--regenerate") == 0) {
+            source.regenerate = 1;
+        } else if (strcmp(argv[i], "--bars") == 0 && i + 1 < argc) {
+            source.bar_seconds = parse_bar_resolution(argv[++i]);
+            if (source.bar_seconds <= 0) {
+                printf("Invalid bar resolution '%s' (use e.g. 1m, 5m, 1h, 1d)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fixed-point") == 0) {
+            fixed_point = 1;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            scheduler_options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "cpu") == 0) {
+                scheduler_options.pinning = SCHEDULER_PIN_CPU;
+            } else if (strcmp(argv[i], "node") == 0) {
+                scheduler_options.pinning = SCHEDULER_PIN_NODE;
+            } else {
+                printf("Invalid pinning '%s' (use cpu or node)\n", argv[i]);
+                return 1;
+            }
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    static Stock stocks[MAX_STOCKS];
     int stock_count = 0;
+    int data_loaded = 0;
     User users[MAX_USERS];
     int user_count = 0;
+    StrategyCatalog catalog;
     char logged_username[MAX_USERNAME];
     User *current_user = NULL;
 
@@ -18,10 +605,6 @@ int main() {
     printf("║            STOCK BACKTESTING SYSTEM WITH USER LOGIN                       ║\n");
     printf("╚════════════════════════════════════════════════════════════════════════════╝\n\n");
 
-    // Load users
-    load_users(users, &user_count);
-    printf("Loaded %d existing users from database.\n\n", user_count);
-
     // Login/Register
     int choice;
     printf("╔═══════════════════════════════════╗\n");
@@ -38,9 +621,13 @@ int main() {
         return 0;
     }
 
+    // Users are only read once they are needed to log in
+    catalog_init(&catalog);
+    load_users(users, &user_count, &catalog);
+
     if (choice == 2) {
         register_user(users, &user_count);
-        save_users(users, user_count);
+        save_users(users, user_count, &catalog);
         printf("\nRegistration successful! Please login.\n\n");
     }
 
@@ -54,14 +641,12 @@ int main() {
     printf("\n✓ Welcome, %s!\n", logged_username);
     printf("You have %d saved strategies.\n\n", current_user->strategy_count);
 
-    // Create sample CSV file
-    printf("Preparing stock data...\n");
-    create_sample_csv();
-    printf("✓ Stock data file 'stock_data.csv' created successfully!\n\n");
+    // Market data is loaded on the first backtest
 
-    // Load stock data from CSV
-    load_stock_data(stocks, &stock_count);
-    printf("✓ Loaded %d stocks with historical data\n\n", stock_count);
+    // Backtests run on worker threads so the menu stays usable
+    static JobTable jobs;
+    job_table_init(&jobs, &scheduler_options);
+    jobs.fixed_point = fixed_point;
 
     // Main application loop
     int continue_running = 1;
@@ -72,7 +657,12 @@ int main() {
         printf("1. Strategy Management (Create/Edit/View/Delete)\n");
         printf("2. Run Backtest with Selected Strategy\n");
         printf("3. Compare All Strategies\n");
-        printf("4. Logout\n");
+        printf("4. Sweep Exit Parameters\n");
+        printf("5. Background Jobs\n");
+        printf("6. Logout\n");
+        if (running_job_count(&jobs) > 0) {
+            printf("\n[%d background job(s) running]\n", running_job_count(&jobs));
+        }
         printf("\nEnter choice: ");
         
         int main_choice;
@@ -80,38 +670,16 @@ int main() {
 
         switch (main_choice) {
             case 1:
-                strategy_management_menu(current_user, users, user_count);
+                strategy_management_menu(current_user, users, user_count, &catalog);
                 break;
                 
             case 2: {
                 Strategy strategy;
-                Portfolio portfolio;
                 double initial_cash = 100000.0;
 
-                if (current_user->strategy_count > 0) {
-                    printf("\n╔═══════════════════════════════════════════════════════════════════════════╗\n");
-                    printf("║                        SELECT STRATEGY                                    ║\n");
-                    printf("╚═══════════════════════════════════════════════════════════════════════════╝\n");
-                    show_user_strategies(current_user);
-                    strategy = select_user_strategy(current_user);
-                    
-                    // If user selected preset (flag = -1)
-                    if (strategy.sma_short_period == -1) {
-                        get_preset_strategy(&strategy);
-                    }
-                } else {
-                    printf("\nNo custom strategies found. Please select a preset strategy.\n");
-                    get_preset_strategy(&strategy);
-                }
+                if (ensure_market_data(&source, stocks, &stock_count, &data_loaded) != 0) break;
 
-                // Initialize portfolio
-                portfolio.cash = initial_cash;
-                portfolio.trade_count = 0;
-                for (int i = 0; i < MAX_STOCKS; i++) {
-                    portfolio.positions[i] = 0;
-                    portfolio.avg_buy_price[i] = 0.0;
-                    portfolio.buy_day[i] = -1;
-                }
+                choose_strategy(current_user, &catalog, &strategy);
 
                 // Run backtest
                 printf("\n╔═══════════════════════════════════════════════════════════════════════════╗\n");
@@ -119,27 +687,53 @@ int main() {
                 printf("╚═══════════════════════════════════════════════════════════════════════════╝\n");
                 printf("Strategy: %s\n", strategy.name);
                 printf("Initial Capital: $%.2f\n", initial_cash);
-                printf("Processing...\n\n");
-                
-                backtest(stocks, stock_count, strategy, &portfolio);
 
-                // Print detailed results
-                print_detailed_results(&portfolio, stocks, stock_count, initial_cash);
-                
-                printf("\nPress Enter to continue...");
-                getchar();
-                getchar();
+                Job *job = submit_backtest_job(&jobs, stocks, stock_count, strategy, initial_cash);
+                if (job != NULL) follow_job(&jobs, job, stocks, stock_count);
                 break;
             }
             
-            case 3:
-                run_comparison_backtest(stocks, stock_count, current_user, 100000.0);
-                printf("\nPress Enter to continue...");
-                getchar();
-                getchar();
+            case 3: {
+                if (ensure_market_data(&source, stocks, &stock_count, &data_loaded) != 0) break;
+                printf("\n=== RUNNING COMPARISON BACKTEST ===\n");
+                printf("Testing all strategies against the same stock data...\n");
+
+                Job *job = submit_comparison_job(&jobs, stocks, stock_count, &catalog, current_user,
+                                                 100000.0);
+                if (job != NULL) follow_job(&jobs, job, stocks, stock_count);
+                break;
+            }
+
+            case 4: {
+                Strategy strategy;
+                ExitSweep sweep;
+
+                if (ensure_market_data(&source, stocks, &stock_count, &data_loaded) != 0) break;
+                choose_strategy(current_user, &catalog, &strategy);
+
+                printf("\n=== SWEEP EXIT PARAMETERS OF '%s' ===\n", strategy.name);
+                printf("Entry parameters stay fixed; every combination below is backtested.\n");
+                if (prompt_sweep_range("Stop loss %", &sweep.stop_loss) != 0 ||
+                    prompt_sweep_range("Take profit %", &sweep.take_profit) != 0 ||
+                    prompt_sweep_range("Max holding days", &sweep.max_holding) != 0) {
+                    break;
+                }
+
+                Job *job = submit_sweep_job(&jobs, stocks, stock_count, &strategy, &sweep,
+                                            current_user->username, 100000.0);
+                if (job != NULL) follow_job(&jobs, job, stocks, stock_count);
+                break;
+            }
+
+            case 5:
+                jobs_menu(&jobs, stocks, stock_count);
                 break;
                 
-            case 4:
+            case 6:
+                if (running_job_count(&jobs) > 0) {
+                    printf("\nCancelling %d running job(s)...\n", running_job_count(&jobs));
+                }
+                job_table_shutdown(&jobs);
                 printf("\n✓ Logging out...\n");
                 printf("Thank you for using the Stock Backtesting System, %s!\n", logged_username);
                 continue_running = 0;
@@ -150,5 +744,7 @@ int main() {
         }
     }
 
+    free_users(users, user_count);
+    catalog_free(&catalog);
     return 0;
 }
\ No newline at end of file
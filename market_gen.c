@@ -0,0 +1,440 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "market_gen.h"
+#include "stock_data.h"
+#include "structures.h"
+
+#define TRADING_DAYS_PER_YEAR 252.0
+#define MAX_CSV_LINE 128
+#define DATE_LENGTH 11
+#define FIRST_TRADING_DAY 19723     // 2024-01-01 (a Monday) as days since 1970-01-01
+
+// Independent random streams drawn for each (symbol, day)
+enum {
+    RNG_RETURN_A, RNG_RETURN_B,
+    RNG_JUMP, RNG_JUMP_A, RNG_JUMP_B,
+    RNG_GAP_A, RNG_GAP_B,
+    RNG_HIGH_A, RNG_HIGH_B,
+    RNG_LOW_A, RNG_LOW_B,
+    RNG_VOLUME_A, RNG_VOLUME_B,
+    RNG_STREAMS
+};
+
+// Worker threads, started once per file and handed a round of symbols at a
+// time
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t start;   // a round was handed out, or the pool is closing
+    pthread_cond_t done;    // a thread finished its part of the round
+    int round;              // rounds handed out so far
+    int finished;           // threads done with the latest round
+    int closing;
+} GenPool;
+
+typedef struct {
+    const MarketGenConfig *config;
+    const char (*dates)[DATE_LENGTH];
+    GenPool *pool;
+    pthread_t thread;
+    int started;
+    int first_symbol;
+    int stride;
+    int end_symbol;
+    int fd;                 // binary mode: worker writes its records directly
+    char *buffers[2];       // CSV mode alternates, so a round is written while the next runs
+    char *buffer;
+    size_t length;
+    int failed;
+} GenWorker;
+
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Counter-based generator: the draw depends only on its coordinates
+static double rng_uniform(uint64_t symbol_key, int day, int stream) {
+    uint64_t bits = mix64(symbol_key ^ mix64((uint64_t)day * RNG_STREAMS + (uint64_t)stream));
+    return (double)(bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_normal(uint64_t symbol_key, int day, int stream_a, int stream_b) {
+    double u1 = 1.0 - rng_uniform(symbol_key, day, stream_a);
+    double u2 = rng_uniform(symbol_key, day, stream_b);
+    return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+// Trading day index -> YYYY-MM-DD, counting weekdays from 2024-01-01
+static void format_trading_date(int trading_day, char out[DATE_LENGTH]) {
+    long long z = FIRST_TRADING_DAY + (long long)(trading_day / 5) * 7 + trading_day % 5;
+    int year, month, day;
+    civil_from_days(z, &year, &month, &day);
+
+    char text[48];
+    snprintf(text, sizeof(text), "%04d-%02d-%02d", year, month, day);
+    memcpy(out, text, DATE_LENGTH - 1);
+    out[DATE_LENGTH - 1] = '\0';
+}
+
+static char *append_uint(char *out, unsigned long long value) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) *out++ = digits[--n];
+    return out;
+}
+
+// Writes cents as a fixed two-decimal price (the format load_stock_data reads)
+static char *append_price(char *out, long long cents) {
+    out = append_uint(out, (unsigned long long)(cents / 100));
+    *out++ = '.';
+    *out++ = (char)('0' + (cents / 10) % 10);
+    *out++ = (char)('0' + cents % 10);
+    return out;
+}
+
+static long long to_cents(double price) {
+    long long cents = llround(price * 100.0);
+    return cents < 1 ? 1 : cents;
+}
+
+static void generated_name(const MarketGenConfig *config, int symbol, char out[MAX_STOCK_NAME]) {
+    if (config->symbols != NULL) {
+        strncpy(out, config->symbols[symbol], MAX_STOCK_NAME - 1);
+        out[MAX_STOCK_NAME - 1] = '\0';
+    } else {
+        snprintf(out, MAX_STOCK_NAME, "SYM%05d", symbol + 1);
+    }
+}
+
+static void generate_symbol(GenWorker *worker, int symbol) {
+    const MarketGenConfig *c = worker->config;
+    uint64_t key = mix64(c->seed ^ mix64((uint64_t)symbol + 1));
+    char name[MAX_STOCK_NAME];
+    generated_name(c, symbol, name);
+    size_t name_length = strlen(name);
+
+    double dt = 1.0 / TRADING_DAYS_PER_YEAR;
+    double drift = (c->drift - 0.5 * c->volatility * c->volatility) * dt;
+    double daily_vol = c->volatility * sqrt(dt);
+    double jump_probability = c->jumps_per_year * dt;
+    double price = c->start_prices != NULL ? c->start_prices[symbol] : c->start_price;
+
+    char *out = worker->buffer + worker->length;
+    StockRecord *record = (StockRecord *)worker->buffer;
+
+    for (int d = 0; d < c->day_count; d++) {
+        double log_return = drift + daily_vol * rng_normal(key, d, RNG_RETURN_A, RNG_RETURN_B);
+        if (rng_uniform(key, d, RNG_JUMP) < jump_probability) {
+            log_return += c->jump_mean + c->jump_stddev * rng_normal(key, d, RNG_JUMP_A, RNG_JUMP_B);
+        }
+
+        double open = price * exp(0.25 * daily_vol * rng_normal(key, d, RNG_GAP_A, RNG_GAP_B));
+        double close = price * exp(log_return);
+        double high = (open > close ? open : close) *
+                      exp(0.5 * daily_vol * fabs(rng_normal(key, d, RNG_HIGH_A, RNG_HIGH_B)));
+        double low = (open < close ? open : close) *
+                     exp(-0.5 * daily_vol * fabs(rng_normal(key, d, RNG_LOW_A, RNG_LOW_B)));
+        int volume = (int)(c->base_volume * exp(0.3 * rng_normal(key, d, RNG_VOLUME_A, RNG_VOLUME_B)));
+        price = close;
+
+        if (c->binary) {
+            StockRecord *r = &record[d];
+            memset(r, 0, sizeof(StockRecord));
+            memcpy(r->symbol, name, name_length);
+            memcpy(r->date, worker->dates[d], DATE_LENGTH);
+            r->open = to_cents(open) / 100.0;
+            r->high = to_cents(high) / 100.0;
+            r->low = to_cents(low) / 100.0;
+            r->close = to_cents(close) / 100.0;
+            r->volume = volume;
+        } else {
+            memcpy(out, name, name_length);
+            out += name_length;
+            *out++ = ',';
+            memcpy(out, worker->dates[d], DATE_LENGTH - 1);
+            out += DATE_LENGTH - 1;
+            *out++ = ',';
+            out = append_price(out, to_cents(open));
+            *out++ = ',';
+            out = append_price(out, to_cents(high));
+            *out++ = ',';
+            out = append_price(out, to_cents(low));
+            *out++ = ',';
+            out = append_price(out, to_cents(close));
+            *out++ = ',';
+            out = append_uint(out, (unsigned long long)volume);
+            *out++ = '\n';
+        }
+    }
+
+    if (c->binary) {
+        size_t size = sizeof(StockRecord) * (size_t)c->day_count;
+        off_t offset = (off_t)sizeof(StockFileHeader) + (off_t)symbol * (off_t)size;
+        size_t written = 0;
+        while (written < size) {
+            ssize_t n = pwrite(worker->fd, worker->buffer + written, size - written, offset + (off_t)written);
+            if (n <= 0) {
+                worker->failed = 1;
+                return;
+            }
+            written += (size_t)n;
+        }
+    } else {
+        worker->length = (size_t)(out - worker->buffer);
+    }
+}
+
+static void generate_symbols(GenWorker *worker) {
+    for (int symbol = worker->first_symbol; symbol < worker->end_symbol; symbol += worker->stride) {
+        generate_symbol(worker, symbol);
+        if (worker->failed) break;
+    }
+}
+
+static void *gen_worker_main(void *arg) {
+    GenWorker *worker = (GenWorker *)arg;
+    GenPool *pool = worker->pool;
+    int seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->round == seen && !pool->closing) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->round == seen) break;
+        seen = pool->round;
+        pthread_mutex_unlock(&pool->lock);
+
+        generate_symbols(worker);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->finished++;
+        pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void start_pool(GenPool *pool, GenWorker workers[], int count) {
+    memset(pool, 0, sizeof(GenPool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int i = 0; i < count; i++) {
+        workers[i].pool = pool;
+        workers[i].started = pthread_create(&workers[i].thread, NULL, gen_worker_main, &workers[i]) == 0;
+    }
+}
+
+// Hands every worker the symbols set in its fields. Workers that could not
+// be started run on the calling thread.
+static void begin_round(GenPool *pool, GenWorker workers[], int count) {
+    pthread_mutex_lock(&pool->lock);
+    pool->finished = 0;
+    pool->round++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < count; i++) {
+        if (!workers[i].started) generate_symbols(&workers[i]);
+    }
+}
+
+static int finish_round(GenPool *pool, GenWorker workers[], int count) {
+    int started = 0;
+    for (int i = 0; i < count; i++) started += workers[i].started;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->finished < started) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < count; i++) {
+        if (workers[i].failed) return -1;
+    }
+    return 0;
+}
+
+static void stop_pool(GenPool *pool, GenWorker workers[], int count) {
+    pthread_mutex_lock(&pool->lock);
+    pool->closing = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < count; i++) {
+        if (workers[i].started) pthread_join(workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+// Gives each worker one symbol of the round starting at first, writing into
+// buffer slot; workers past the last symbol get none
+static void assign_round(GenWorker workers[], int count, int symbol_count, int first, int slot) {
+    for (int i = 0; i < count; i++) {
+        workers[i].first_symbol = first + i;
+        workers[i].stride = 1;
+        workers[i].end_symbol = first + i < symbol_count ? first + i + 1 : first + i;
+        workers[i].buffer = workers[i].buffers[slot];
+        workers[i].length = 0;
+    }
+}
+
+void default_market_gen_config(MarketGenConfig *config) {
+    memset(config, 0, sizeof(MarketGenConfig));
+    config->symbol_count = 3;
+    config->day_count = 50;
+    config->seed = 42;
+    config->start_price = 100.0;
+    config->drift = 0.05;
+    config->volatility = 0.30;
+    config->jumps_per_year = 2.0;
+    config->jump_mean = -0.02;
+    config->jump_stddev = 0.05;
+    config->base_volume = 100000;
+}
+
+int generate_market_data(const MarketGenConfig *config, const char *path) {
+    if (config->symbol_count <= 0 || config->day_count <= 0) {
+        printf("Error: symbol and day counts must be positive!\n");
+        return -1;
+    }
+
+    int thread_count = config->threads;
+    if (thread_count <= 0) thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count <= 0) thread_count = 1;
+    if (thread_count > config->symbol_count) thread_count = config->symbol_count;
+
+    char (*dates)[DATE_LENGTH] = malloc(sizeof(*dates) * (size_t)config->day_count);
+    GenWorker *workers = calloc((size_t)thread_count, sizeof(GenWorker));
+    size_t buffer_size = (size_t)config->day_count *
+                         (config->binary ? sizeof(StockRecord) : MAX_CSV_LINE);
+    int result = 0;
+
+    if (dates == NULL || workers == NULL) {
+        printf("Error allocating generator buffers!\n");
+        free(dates);
+        free(workers);
+        return -1;
+    }
+    for (int d = 0; d < config->day_count; d++) {
+        format_trading_date(d, dates[d]);
+    }
+    for (int i = 0; i < thread_count; i++) {
+        workers[i].config = config;
+        workers[i].dates = (const char (*)[DATE_LENGTH])dates;
+        workers[i].buffers[0] = malloc(buffer_size);
+        workers[i].buffers[1] = config->binary ? NULL : malloc(buffer_size);
+        workers[i].buffer = workers[i].buffers[0];
+        if (workers[i].buffers[0] == NULL || (!config->binary && workers[i].buffers[1] == NULL)) result = -1;
+    }
+
+    GenPool pool;
+    if (result == 0) start_pool(&pool, workers, thread_count);
+
+    if (result != 0) {
+        printf("Error allocating generator buffers!\n");
+    } else if (config->binary) {
+        // Fixed-size records: every worker writes its symbols in place
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            printf("Error creating data file '%s'!\n", path);
+            result = -1;
+        } else {
+            StockFileHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, STOCK_BINARY_MAGIC, sizeof(header.magic));
+            header.record_size = (int)sizeof(StockRecord);
+            header.record_count = (long long)config->symbol_count * config->day_count;
+
+            if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) result = -1;
+            for (int i = 0; i < thread_count; i++) {
+                workers[i].fd = fd;
+                workers[i].first_symbol = i;
+                workers[i].stride = thread_count;
+                workers[i].end_symbol = config->symbol_count;
+            }
+            if (result == 0) {
+                begin_round(&pool, workers, thread_count);
+                result = finish_round(&pool, workers, thread_count);
+            }
+            if (close(fd) != 0) result = -1;
+            if (result != 0) printf("Error writing data file '%s'!\n", path);
+        }
+    } else {
+        // CSV rows vary in length, so symbols are generated a round at a
+        // time in parallel and appended in order by this thread, which
+        // writes each round while the workers generate the next
+        FILE *fp = fopen(path, "w");
+        if (fp == NULL) {
+            printf("Error creating CSV file '%s'!\n", path);
+            result = -1;
+        } else {
+            fprintf(fp, "Symbol,Date,Open,High,Low,Close,Volume\n");
+            int rounds = (config->symbol_count + thread_count - 1) / thread_count;
+            int running = 0;
+
+            assign_round(workers, thread_count, config->symbol_count, 0, 0);
+            begin_round(&pool, workers, thread_count);
+            running = 1;
+            for (int r = 0; r < rounds && result == 0; r++) {
+                char *written[thread_count];
+                size_t lengths[thread_count];
+
+                result = finish_round(&pool, workers, thread_count);
+                running = 0;
+                for (int i = 0; i < thread_count; i++) {
+                    written[i] = workers[i].buffer;
+                    lengths[i] = workers[i].length;
+                }
+                if (result == 0 && r + 1 < rounds) {
+                    assign_round(workers, thread_count, config->symbol_count, (r + 1) * thread_count, (r + 1) & 1);
+                    begin_round(&pool, workers, thread_count);
+                    running = 1;
+                }
+                for (int i = 0; i < thread_count && result == 0; i++) {
+                    if (fwrite(written[i], 1, lengths[i], fp) != lengths[i]) result = -1;
+                }
+            }
+            if (running) finish_round(&pool, workers, thread_count);
+            if (fclose(fp) != 0) result = -1;
+            if (result != 0) printf("Error writing CSV file '%s'!\n", path);
+        }
+    }
+
+    if (workers[0].pool != NULL) stop_pool(&pool, workers, thread_count);
+    for (int i = 0; i < thread_count; i++) {
+        free(workers[i].buffers[0]);
+        free(workers[i].buffers[1]);
+    }
+    free(workers);
+    free(dates);
+    return result;
+}
+
+void create_sample_csv() {
+    static const char *const symbols[] = { "TECH_A", "FINANCE_B", "ENERGY_C" };
+    static const double start_prices[] = { 100.0, 150.0, 75.0 };
+    MarketGenConfig config;
+
+    // Fixed seed so every run sees the same sample market
+    default_market_gen_config(&config);
+    config.symbol_count = 3;
+    config.day_count = 50;
+    config.symbols = symbols;
+    config.start_prices = start_prices;
+    config.threads = 1;
+
+    generate_market_data(&config, "stock_data.csv");
+}
@@ -0,0 +1,28 @@
+#ifndef MARKET_GEN_H
+#define MARKET_GEN_H
+
+// Synthetic market data generator (geometric Brownian motion with jumps).
+// Every random draw is derived from (seed, symbol, day), so output is
+// identical for any thread count.
+typedef struct {
+    int symbol_count;
+    int day_count;
+    unsigned long long seed;
+    double start_price;         // used when start_prices is NULL
+    double drift;               // annualized
+    double volatility;          // annualized
+    double jumps_per_year;
+    double jump_mean;           // mean log jump size
+    double jump_stddev;
+    int base_volume;
+    int threads;                // 0 = one per CPU
+    int binary;                 // write the binary format instead of CSV
+    const char *const *symbols; // optional names, default SYM00001...
+    const double *start_prices; // optional per-symbol start prices
+} MarketGenConfig;
+
+void default_market_gen_config(MarketGenConfig *config);
+int generate_market_data(const MarketGenConfig *config, const char *path);
+void create_sample_csv();
+
+#endif
@@ -0,0 +1,78 @@
+#include <string.h>
+#include "order_book.h"
+#include "structures.h"
+
+void order_book_init(OrderBook *book) {
+    for (int s = 0; s < MAX_STOCKS; s++) {
+        book->symbols[s].stop_count = 0;
+        book->symbols[s].limit_count = 0;
+    }
+}
+
+// Inserts keeping the array sorted; descending = 1 sorts high to low
+static int insert_sorted(PendingOrder orders[], int *count, double level, int id, int descending) {
+    if (*count >= MAX_ORDERS_PER_SYMBOL) return -1;
+
+    int lo = 0, hi = *count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int before = descending ? orders[mid].level >= level : orders[mid].level <= level;
+        if (before) lo = mid + 1;
+        else hi = mid;
+    }
+    memmove(&orders[lo + 1], &orders[lo], sizeof(PendingOrder) * (size_t)(*count - lo));
+    orders[lo].level = level;
+    orders[lo].id = id;
+    (*count)++;
+    return 0;
+}
+
+static void remove_id(PendingOrder orders[], int *count, int id) {
+    int kept = 0;
+    for (int i = 0; i < *count; i++) {
+        if (orders[i].id != id) orders[kept++] = orders[i];
+    }
+    *count = kept;
+}
+
+int order_book_add(OrderBook *book, int symbol, OrderType type, double level, int id) {
+    SymbolOrders *orders = &book->symbols[symbol];
+    if (type == ORDER_STOP) return insert_sorted(orders->stops, &orders->stop_count, level, id, 0);
+    return insert_sorted(orders->limits, &orders->limit_count, level, id, 1);
+}
+
+void order_book_cancel(OrderBook *book, int symbol, int id) {
+    SymbolOrders *orders = &book->symbols[symbol];
+    remove_id(orders->stops, &orders->stop_count, id);
+    remove_id(orders->limits, &orders->limit_count, id);
+}
+
+// Pops every order the bar's [low, high] range reaches. Only triggered
+// orders are touched: the scan stops at the first level outside the range.
+// Stops are reported before limits, since the path inside a bar is unknown
+// and assuming the adverse fill first is the conservative choice.
+int order_book_match(OrderBook *book, int symbol, double open, double high, double low,
+                     OrderFill fills[], int max_fills) {
+    SymbolOrders *orders = &book->symbols[symbol];
+    int count = 0;
+
+    while (count < max_fills && orders->stop_count > 0 &&
+           orders->stops[orders->stop_count - 1].level >= low) {
+        PendingOrder *order = &orders->stops[--orders->stop_count];
+        fills[count].id = order->id;
+        fills[count].type = ORDER_STOP;
+        fills[count].level = order->level;
+        fills[count].price = open < order->level ? open : order->level;
+        count++;
+    }
+    while (count < max_fills && orders->limit_count > 0 &&
+           orders->limits[orders->limit_count - 1].level <= high) {
+        PendingOrder *order = &orders->limits[--orders->limit_count];
+        fills[count].id = order->id;
+        fills[count].type = ORDER_LIMIT;
+        fills[count].level = order->level;
+        fills[count].price = open > order->level ? open : order->level;
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,44 @@
+#ifndef ORDER_BOOK_H
+#define ORDER_BOOK_H
+
+#include "structures.h"
+
+#define MAX_ORDERS_PER_SYMBOL 8
+
+typedef enum {
+    ORDER_STOP,     // sell when the price falls to the level
+    ORDER_LIMIT     // sell when the price rises to the level
+} OrderType;
+
+typedef struct {
+    double level;
+    int id;
+} PendingOrder;
+
+// Pending sell orders for one symbol, kept sorted so the orders nearest the
+// market sit at the end of each array: stops ascending, limits descending
+typedef struct {
+    PendingOrder stops[MAX_ORDERS_PER_SYMBOL];
+    int stop_count;
+    PendingOrder limits[MAX_ORDERS_PER_SYMBOL];
+    int limit_count;
+} SymbolOrders;
+
+typedef struct {
+    SymbolOrders symbols[MAX_STOCKS];
+} OrderBook;
+
+typedef struct {
+    int id;
+    OrderType type;
+    double level;
+    double price;   // fill price: the level, or the open if the bar gapped through it
+} OrderFill;
+
+void order_book_init(OrderBook *book);
+int order_book_add(OrderBook *book, int symbol, OrderType type, double level, int id);
+void order_book_cancel(OrderBook *book, int symbol, int id);
+int order_book_match(OrderBook *book, int symbol, double open, double high, double low,
+                     OrderFill fills[], int max_fills);
+
+#endif
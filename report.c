@@ -0,0 +1,607 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "report.h"
+#include "backtest.h"
+#include "analytics.h"
+#include "result_stats.h"
+#include "results_store.h"
+#include "symbols.h"
+#include "structures.h"
+
+// If the buffer cannot be allocated the writer falls back to plain stdio
+int report_writer_open(ReportWriter *writer, FILE *out) {
+    writer->out = out;
+    writer->length = 0;
+    writer->failed = 0;
+    writer->buffer = malloc(REPORT_BUFFER_SIZE);
+    return writer->buffer != NULL ? 0 : -1;
+}
+
+static void report_flush(ReportWriter *writer) {
+    if (writer->length > 0 && fwrite(writer->buffer, 1, writer->length, writer->out) != writer->length) {
+        writer->failed = 1;
+    }
+    writer->length = 0;
+}
+
+static void report_write(ReportWriter *writer, const char *data, size_t length) {
+    if (writer->buffer == NULL || length >= REPORT_BUFFER_SIZE) {
+        if (writer->buffer != NULL) report_flush(writer);
+        if (fwrite(data, 1, length, writer->out) != length) writer->failed = 1;
+        return;
+    }
+    if (writer->length + length > REPORT_BUFFER_SIZE) report_flush(writer);
+    memcpy(writer->buffer + writer->length, data, length);
+    writer->length += length;
+}
+
+void report_printf(ReportWriter *writer, const char *format, ...) {
+    va_list args;
+
+    if (writer->buffer == NULL) {
+        va_start(args, format);
+        if (vfprintf(writer->out, format, args) < 0) writer->failed = 1;
+        va_end(args);
+        return;
+    }
+
+    size_t room = REPORT_BUFFER_SIZE - writer->length;
+    va_start(args, format);
+    int needed = vsnprintf(writer->buffer + writer->length, room, format, args);
+    va_end(args);
+    if (needed < 0) {
+        writer->failed = 1;
+        return;
+    }
+    if ((size_t)needed < room) {
+        writer->length += (size_t)needed;
+        return;
+    }
+
+    // Did not fit: flush and format again, on the heap if it is huge
+    report_flush(writer);
+    char *text = (size_t)needed < REPORT_BUFFER_SIZE ? writer->buffer : malloc((size_t)needed + 1);
+    if (text == NULL) {
+        writer->failed = 1;
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(text, (size_t)needed + 1, format, args);
+    va_end(args);
+    if (text == writer->buffer) {
+        writer->length = (size_t)needed;
+    } else {
+        report_write(writer, text, (size_t)needed);
+        free(text);
+    }
+}
+
+// Flushes and releases the buffer. Returns -1 if any write failed.
+int report_writer_close(ReportWriter *writer) {
+    if (writer->buffer != NULL) report_flush(writer);
+    free(writer->buffer);
+    writer->buffer = NULL;
+    if (fflush(writer->out) != 0) writer->failed = 1;
+    return writer->failed ? -1 : 0;
+}
+
+ReportFormat report_format_for_path(const char *path) {
+    const char *extension = strrchr(path, '.');
+    if (extension != NULL && strcmp(extension, ".csv") == 0) return REPORT_CSV;
+    if (extension != NULL && strcmp(extension, ".json") == 0) return REPORT_JSON;
+    return REPORT_TEXT;
+}
+
+static void write_json_string(ReportWriter *writer, const char *text) {
+    report_write(writer, "\"", 1);
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            char escaped[2] = { '\\', *c };
+            report_write(writer, escaped, 2);
+        } else if ((unsigned char)*c < 0x20) {
+            report_printf(writer, "\\u%04x", (unsigned char)*c);
+        } else {
+            report_write(writer, c, 1);
+        }
+    }
+    report_write(writer, "\"", 1);
+}
+
+// Quotes the field only when it holds a separator or quote
+static void write_csv_string(ReportWriter *writer, const char *text) {
+    if (strpbrk(text, ",\"\n") == NULL) {
+        report_write(writer, text, strlen(text));
+        return;
+    }
+    report_write(writer, "\"", 1);
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"') report_write(writer, "\"", 1);
+        report_write(writer, c, 1);
+    }
+    report_write(writer, "\"", 1);
+}
+
+static void write_trade(ReportWriter *writer, int number, const Trade *t) {
+    report_printf(writer, "TRADE #%d - %s %s\n", number, t->type, symbol_name(t->symbol_id));
+    report_printf(writer, "--------------------------------------------------------------------------------\n");
+    report_printf(writer, "Date:                    %s (Day %d)\n", t->date, t->day);
+    report_printf(writer, "Reason:                  %s\n", t->reason);
+    report_printf(writer, "Price per Share:         $%.2f\n", t->price);
+    report_printf(writer, "Quantity:                %d shares\n", t->quantity);
+    report_printf(writer, "Total Transaction Value: $%.2f\n", t->total_value);
+    report_printf(writer, "Portfolio Cash Before:   $%.2f\n", t->portfolio_cash_before);
+    report_printf(writer, "Portfolio Cash After:    $%.2f\n", t->portfolio_cash_after);
+
+    if (strcmp(t->type, "SELL") == 0) {
+        if (t->profit_loss >= 0) {
+            report_printf(writer, "Profit:                  $%.2f ✓\n", t->profit_loss);
+        } else {
+            report_printf(writer, "Loss:                    $%.2f ✗\n", t->profit_loss);
+        }
+    }
+    report_printf(writer, "\n");
+}
+
+// Human-readable report. With max_trades > 0 only the first and last
+// max_trades / 2 trades are listed; the summary always covers all of them.
+static void write_text_report(ReportWriter *writer, Portfolio *portfolio, Stock stocks[],
+                              int stock_count, double initial_cash, int max_trades) {
+    report_printf(writer, "\n\n");
+    report_printf(writer, "================================================================================\n");
+    report_printf(writer, "                          DETAILED BACKTEST RESULTS                             \n");
+    report_printf(writer, "================================================================================\n\n");
+
+    int head = portfolio->trade_count, tail = portfolio->trade_count;
+    if (max_trades > 0 && portfolio->trade_count > max_trades) {
+        head = max_trades / 2;
+        tail = portfolio->trade_count - max_trades / 2;
+        report_printf(writer, "TRADE HISTORY (first and last %d of %d trades):\n", max_trades / 2, portfolio->trade_count);
+    } else {
+        report_printf(writer, "COMPLETE TRADE HISTORY:\n");
+    }
+    report_printf(writer, "================================================================================\n\n");
+
+    for (int i = 0; i < head; i++) write_trade(writer, i + 1, &portfolio->trades[i]);
+    if (head < tail) {
+        report_printf(writer, "... %d trades not shown - export the results for the full list ...\n\n", tail - head);
+    }
+    for (int i = tail; i < portfolio->trade_count; i++) write_trade(writer, i + 1, &portfolio->trades[i]);
+    if (portfolio->trades_made > portfolio->trade_count) {
+        report_printf(writer, "Note: the trade log holds the first %d of %d trades; the statistics below cover all of them.\n\n",
+                      portfolio->trade_count, portfolio->trades_made);
+    }
+
+    // Counts and profit come from the running totals, which include trades
+    // past the end of the log; the money invested is summed from the log
+    double value = portfolio_value(portfolio, stocks, stock_count);
+    int winning_trades = portfolio->winning_trades, losing_trades = portfolio->losing_trades;
+    int sell_count = winning_trades + losing_trades;
+    int buy_count = portfolio->trades_made - sell_count;
+    double total_realized_profit = portfolio->realized_profit;
+    double total_invested = 0.0;
+
+    for (int i = 0; i < portfolio->trade_count; i++) {
+        if (strcmp(portfolio->trades[i].type, "BUY") == 0) total_invested += portfolio->trades[i].total_value;
+    }
+
+    double total_return = value - initial_cash;
+    double return_pct = (total_return / initial_cash) * 100.0;
+
+    report_printf(writer, "================================================================================\n");
+    report_printf(writer, "                              PORTFOLIO SUMMARY                                 \n");
+    report_printf(writer, "================================================================================\n\n");
+    report_printf(writer, "Initial Capital:         $%.2f\n", initial_cash);
+    report_printf(writer, "Final Portfolio Value:   $%.2f\n", value);
+    report_printf(writer, "Final Cash Balance:      $%.2f\n", portfolio->cash);
+    report_printf(writer, "Total Return:            $%.2f (%.2f%%)\n", total_return, return_pct);
+    report_printf(writer, "Total Realized Profit:   $%.2f\n", total_realized_profit);
+    report_printf(writer, "\n");
+
+    report_printf(writer, "TRADING STATISTICS:\n");
+    report_printf(writer, "--------------------------------------------------------------------------------\n");
+    report_printf(writer, "Total Trades:            %d\n", portfolio->trades_made);
+    report_printf(writer, "Buy Orders:              %d\n", buy_count);
+    report_printf(writer, "Sell Orders:             %d\n", sell_count);
+    report_printf(writer, "Winning Trades:          %d\n", winning_trades);
+    report_printf(writer, "Losing Trades:           %d\n", losing_trades);
+    if (sell_count > 0) {
+        report_printf(writer, "Win Rate:                %.2f%%\n", (double)winning_trades / sell_count * 100.0);
+        report_printf(writer, "Average Profit per Trade: $%.2f\n", total_realized_profit / sell_count);
+    }
+    report_printf(writer, "Total Money Invested:    $%.2f%s\n", total_invested,
+                  portfolio->trades_made > portfolio->trade_count ? " (logged trades only)" : "");
+    report_printf(writer, "\n");
+
+    report_printf(writer, "CURRENT OPEN POSITIONS:\n");
+    report_printf(writer, "--------------------------------------------------------------------------------\n");
+    int has_positions = 0;
+    for (int i = 0; i < stock_count; i++) {
+        if (portfolio->positions[i] > 0) {
+            has_positions = 1;
+            int last_day = stocks[i].day_count - 1;
+            double current_price = stocks[i].prices[last_day].close;
+            double current_value = portfolio->positions[i] * current_price;
+            double unrealized = (current_price - portfolio->avg_buy_price[i]) * portfolio->positions[i];
+            double unrealized_pct = (unrealized / (portfolio->avg_buy_price[i] * portfolio->positions[i])) * 100.0;
+            
+            report_printf(writer, "%s:\n", symbol_name(stocks[i].symbol_id));
+            report_printf(writer, "  Quantity:              %d shares\n", portfolio->positions[i]);
+            report_printf(writer, "  Average Buy Price:     $%.2f\n", portfolio->avg_buy_price[i]);
+            report_printf(writer, "  Current Price:         $%.2f\n", current_price);
+            report_printf(writer, "  Position Value:        $%.2f\n", current_value);
+            report_printf(writer, "  Unrealized P/L:        $%.2f (%.2f%%)\n\n", unrealized, unrealized_pct);
+        }
+    }
+    if (!has_positions) {
+        report_printf(writer, "No open positions - All cash\n\n");
+    }
+
+    // Diversification check: how closely the open positions move together
+    CovarianceMatrix covariance;
+    int held[MAX_STOCKS], held_count = 0;
+    for (int i = 0; i < stock_count; i++) {
+        if (portfolio->positions[i] > 0) held[held_count++] = i;
+    }
+    if (held_count >= 2 && compute_stock_covariance(&covariance, stocks, stock_count, REPORT_CORRELATION_WINDOW, 0) == 0) {
+        report_printf(writer, "POSITION CORRELATION (last %d bars):\n", covariance.window);
+        report_printf(writer, "--------------------------------------------------------------------------------\n");
+        double total = 0.0;
+        int pairs = 0;
+        for (int a = 0; a < held_count; a++) {
+            for (int b = a + 1; b < held_count; b++) {
+                double correlation = correlation_at(&covariance, held[a], held[b]);
+                report_printf(writer, "  %-12s / %-12s %6.2f\n", symbol_name(stocks[held[a]].symbol_id),
+                              symbol_name(stocks[held[b]].symbol_id), correlation);
+                total += correlation;
+                pairs++;
+            }
+        }
+        report_printf(writer, "  Average correlation:       %6.2f\n\n", total / pairs);
+        covariance_free(&covariance);
+    }
+
+    report_printf(writer, "================================================================================\n");
+}
+
+void print_detailed_results(Portfolio *portfolio, Stock stocks[], int stock_count, double initial_cash) {
+    ReportWriter writer;
+    report_writer_open(&writer, stdout);
+    write_text_report(&writer, portfolio, stocks, stock_count, initial_cash, REPORT_TERMINAL_TRADES);
+    report_writer_close(&writer);
+}
+
+static void write_comparison_text(ReportWriter *writer, StrategyResult results[], int result_count) {
+    report_printf(writer, "\n\n");
+    report_printf(writer, "================================================================================\n");
+    report_printf(writer, "                        STRATEGY COMPARISON REPORT                              \n");
+    report_printf(writer, "================================================================================\n\n");
+    
+    int best_idx = 0;
+    for (int i = 1; i < result_count; i++) {
+        if (results[i].return_pct > results[best_idx].return_pct) {
+            best_idx = i;
+        }
+    }
+    
+    report_printf(writer, "PERFORMANCE COMPARISON:\n");
+    report_printf(writer, "================================================================================\n\n");
+    
+    for (int i = 0; i < result_count; i++) {
+        StrategyResult *r = &results[i];
+        report_printf(writer, "STRATEGY #%d: %s", i + 1, r->strategy_name);
+        if (i == best_idx) report_printf(writer, " ⭐ BEST PERFORMER");
+        report_printf(writer, "\n");
+        report_printf(writer, "--------------------------------------------------------------------------------\n");
+        report_printf(writer, "User:                    %s\n", r->username);
+        report_printf(writer, "Initial Capital:         $%.2f\n", r->initial_capital);
+        report_printf(writer, "Final Value:             $%.2f\n", r->final_value);
+        report_printf(writer, "Total Return:            $%.2f (%.2f%%)\n", r->total_return, r->return_pct);
+        report_printf(writer, "Total Trades:            %d\n", r->total_trades);
+        report_printf(writer, "Winning Trades:          %d\n", r->winning_trades);
+        report_printf(writer, "Losing Trades:           %d\n", r->losing_trades);
+        report_printf(writer, "Win Rate:                %.2f%%\n", r->win_rate);
+        report_printf(writer, "Realized Profit:         $%.2f\n", r->total_realized_profit);
+        report_printf(writer, "Max Drawdown (realized): %.2f%%\n", r->max_drawdown_pct);
+        report_printf(writer, "\n");
+    }
+    
+    report_printf(writer, "================================================================================\n");
+    report_printf(writer, "                            RANKING BY RETURN %%                                \n");
+    report_printf(writer, "================================================================================\n\n");
+    
+    StrategyResult *sorted = malloc(sizeof(StrategyResult) * (size_t)(result_count + 1));
+    if (sorted == NULL) {
+        writer->failed = 1;
+        return;
+    }
+    memcpy(sorted, results, result_count * sizeof(StrategyResult));
+    
+    for (int i = 0; i < result_count - 1; i++) {
+        for (int j = 0; j < result_count - i - 1; j++) {
+            if (sorted[j].return_pct < sorted[j + 1].return_pct) {
+                StrategyResult temp = sorted[j];
+                sorted[j] = sorted[j + 1];
+                sorted[j + 1] = temp;
+            }
+        }
+    }
+    
+    report_printf(writer, "Rank | Strategy Name                    | Return %%   | Total Return\n");
+    report_printf(writer, "--------------------------------------------------------------------------------\n");
+    for (int i = 0; i < result_count; i++) {
+        report_printf(writer, "%-4d | %-32s | %8.2f%% | $%.2f\n", 
+               i + 1, sorted[i].strategy_name, sorted[i].return_pct, sorted[i].total_return);
+    }
+    report_printf(writer, "\n");
+    free(sorted);
+}
+
+void compare_strategies(StrategyResult results[], int result_count) {
+    ReportWriter writer;
+    report_writer_open(&writer, stdout);
+    write_comparison_text(&writer, results, result_count);
+    report_writer_close(&writer);
+}
+
+static int compare_return_desc(const void *a, const void *b) {
+    const StrategyResult *x = *(const StrategyResult *const *)a;
+    const StrategyResult *y = *(const StrategyResult *const *)b;
+    if (x->return_pct != y->return_pct) return x->return_pct < y->return_pct ? 1 : -1;
+    return 0;
+}
+
+// One line per parameter set for the best top of a sweep, which may be far
+// too large for the full comparison report
+void print_sweep_results(StrategyResult results[], int result_count, int top) {
+    const StrategyResult **ranked = malloc(sizeof(*ranked) * (size_t)(result_count + 1));
+    ReportWriter writer;
+
+    if (ranked == NULL) {
+        printf("Error allocating the sweep ranking!\n");
+        return;
+    }
+    for (int i = 0; i < result_count; i++) ranked[i] = &results[i];
+    qsort(ranked, (size_t)result_count, sizeof(*ranked), compare_return_desc);
+    if (top > result_count) top = result_count;
+
+    report_writer_open(&writer, stdout);
+    report_printf(&writer, "\n================================================================================\n");
+    report_printf(&writer, "                SWEEP RESULTS: TOP %d OF %d BY RETURN %%\n", top, result_count);
+    report_printf(&writer, "================================================================================\n\n");
+    report_printf(&writer, "%-5s %-45s %9s %7s %8s\n", "Rank", "Parameters", "Return %", "Trades", "Win %");
+    report_printf(&writer, "--------------------------------------------------------------------------------\n");
+    for (int i = 0; i < top; i++) {
+        const StrategyResult *r = ranked[i];
+        report_printf(&writer, "%-5d %-45.45s %8.2f%% %7d %7.2f%%\n", i + 1, r->strategy_name, r->return_pct,
+                      r->total_trades, r->win_rate);
+    }
+    if (result_count > 0) {
+        report_printf(&writer, "\nWorst: %s (%.2f%%)\n", ranked[result_count - 1]->strategy_name,
+                      ranked[result_count - 1]->return_pct);
+    }
+    report_writer_close(&writer);
+    free(ranked);
+}
+
+static void write_stat_row(ReportWriter *writer, const char *label, StatSketch *sketch) {
+    report_printf(writer, "%-16s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", label, sketch->mean,
+                  stat_sketch_stddev(sketch), sketch->min, stat_sketch_quantile(sketch, 0.05),
+                  stat_sketch_quantile(sketch, 0.25), stat_sketch_quantile(sketch, 0.5),
+                  stat_sketch_quantile(sketch, 0.75), stat_sketch_quantile(sketch, 0.95), sketch->max);
+}
+
+// Counts per equal-width bin between the min and max, estimated from the sketch
+static void write_histogram(ReportWriter *writer, const char *label, StatSketch *sketch, int bins) {
+    double width = (sketch->max - sketch->min) / bins;
+    double previous = 0.0;
+
+    report_printf(writer, "\n%s histogram:\n", label);
+    for (int b = 0; b < bins; b++) {
+        double upper = b == bins - 1 ? sketch->max : sketch->min + width * (b + 1);
+        double cumulative = stat_sketch_cdf(sketch, upper);
+        double count = (cumulative - previous) * sketch->count;
+        int bar = (int)((cumulative - previous) * 50.0 + 0.5);
+        previous = cumulative;
+
+        report_printf(writer, "  %9.2f .. %9.2f %9.0f  ", sketch->min + width * b, upper, count);
+        for (int i = 0; i < bar; i++) report_write(writer, "#", 1);
+        report_write(writer, "\n", 1);
+    }
+}
+
+// Summary of a result distribution: moments, quantiles and a histogram
+void print_result_stats(ResultStats *stats) {
+    ReportWriter writer;
+    report_writer_open(&writer, stdout);
+
+    report_printf(&writer, "\nDISTRIBUTION OVER %.0f RESULTS\n", stats->return_pct.count);
+    report_printf(&writer, "--------------------------------------------------------------------------------------------\n");
+    report_printf(&writer, "%-16s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n", "Metric", "Mean", "StdDev", "Min", "p5",
+                  "p25", "Median", "p75", "p95", "Max");
+    if (stats->return_pct.count > 0) {
+        write_stat_row(&writer, "Return %", &stats->return_pct);
+        write_stat_row(&writer, "Win rate %", &stats->win_rate);
+        write_stat_row(&writer, "Max drawdown %", &stats->max_drawdown_pct);
+        if (stats->return_pct.max > stats->return_pct.min) {
+            write_histogram(&writer, "Return %", &stats->return_pct, 10);
+        }
+    }
+    report_writer_close(&writer);
+}
+
+static void write_trades_csv(ReportWriter *writer, const Portfolio *portfolio) {
+    report_printf(writer, "Trade,Date,Day,Symbol,Type,Price,Quantity,Value,CashBefore,CashAfter,ProfitLoss,Reason\n");
+    for (int i = 0; i < portfolio->trade_count; i++) {
+        const Trade *t = &portfolio->trades[i];
+        report_printf(writer, "%d,%s,%d,", i + 1, t->date, t->day);
+        write_csv_string(writer, symbol_name(t->symbol_id));
+        report_printf(writer, ",%s,%.4f,%d,%.2f,%.2f,%.2f,%.2f,", t->type, t->price, t->quantity,
+                      t->total_value, t->portfolio_cash_before, t->portfolio_cash_after, t->profit_loss);
+        write_csv_string(writer, t->reason);
+        report_write(writer, "\n", 1);
+    }
+}
+
+static void write_backtest_json(ReportWriter *writer, Portfolio *portfolio, Stock stocks[],
+                                int stock_count, double initial_cash) {
+    report_printf(writer, "{\n  \"initial_cash\": %.2f,\n  \"final_value\": %.2f,\n  \"cash\": %.2f,\n",
+                  initial_cash, portfolio_value(portfolio, stocks, stock_count), portfolio->cash);
+
+    report_printf(writer, "  \"positions\": [");
+    int first = 1;
+    for (int i = 0; i < stock_count; i++) {
+        if (portfolio->positions[i] <= 0) continue;
+        report_printf(writer, "%s\n    {\"symbol\": ", first ? "" : ",");
+        write_json_string(writer, symbol_name(stocks[i].symbol_id));
+        report_printf(writer, ", \"quantity\": %d, \"avg_buy_price\": %.4f, \"last_close\": %.2f}",
+                      portfolio->positions[i], portfolio->avg_buy_price[i],
+                      stocks[i].prices[stocks[i].day_count - 1].close);
+        first = 0;
+    }
+    report_printf(writer, "%s],\n  \"trades_made\": %d,\n  \"trades\": [", first ? "" : "\n  ",
+                  portfolio->trades_made);
+
+    for (int i = 0; i < portfolio->trade_count; i++) {
+        const Trade *t = &portfolio->trades[i];
+        report_printf(writer, "%s\n    {\"date\": ", i == 0 ? "" : ",");
+        write_json_string(writer, t->date);
+        report_printf(writer, ", \"day\": %d, \"symbol\": ", t->day);
+        write_json_string(writer, symbol_name(t->symbol_id));
+        report_printf(writer, ", \"type\": \"%s\", \"price\": %.4f, \"quantity\": %d, \"value\": %.2f, "
+                      "\"cash_before\": %.2f, \"cash_after\": %.2f, \"profit_loss\": %.2f, \"reason\": ",
+                      t->type, t->price, t->quantity, t->total_value, t->portfolio_cash_before,
+                      t->portfolio_cash_after, t->profit_loss);
+        write_json_string(writer, t->reason);
+        report_write(writer, "}", 1);
+    }
+    report_printf(writer, "%s]\n}\n", portfolio->trade_count > 0 ? "\n  " : "");
+}
+
+static int open_export(const char *path, ReportWriter *writer) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("Error creating '%s'!\n", path);
+        return -1;
+    }
+    report_writer_open(writer, fp);
+    return 0;
+}
+
+static int close_export(const char *path, ReportWriter *writer) {
+    int status = report_writer_close(writer);
+    if (fclose(writer->out) != 0) status = -1;
+    if (status != 0) printf("Error writing '%s'!\n", path);
+    return status;
+}
+
+// Writes one backtest in the format implied by the path's extension; the
+// text format lists every trade
+int export_backtest(const char *path, Portfolio *portfolio, Stock stocks[], int stock_count,
+                    double initial_cash) {
+    ReportWriter writer;
+    if (open_export(path, &writer) != 0) return -1;
+
+    switch (report_format_for_path(path)) {
+        case REPORT_CSV:
+            write_trades_csv(&writer, portfolio);
+            break;
+        case REPORT_JSON:
+            write_backtest_json(&writer, portfolio, stocks, stock_count, initial_cash);
+            break;
+        default:
+            write_text_report(&writer, portfolio, stocks, stock_count, initial_cash, 0);
+    }
+    return close_export(path, &writer);
+}
+
+int export_comparison(const char *path, StrategyResult results[], int result_count) {
+    ReportWriter writer;
+    if (open_export(path, &writer) != 0) return -1;
+
+    ReportFormat format = report_format_for_path(path);
+    if (format == REPORT_TEXT) {
+        write_comparison_text(&writer, results, result_count);
+        return close_export(path, &writer);
+    }
+
+    if (format == REPORT_CSV) {
+        report_printf(&writer, "Strategy,User,InitialCapital,FinalValue,TotalReturn,ReturnPct,Trades,Winning,Losing,WinRate,RealizedProfit,MaxDrawdownPct\n");
+    } else {
+        report_printf(&writer, "[");
+    }
+    for (int i = 0; i < result_count; i++) {
+        StrategyResult *r = &results[i];
+        if (format == REPORT_CSV) {
+            write_csv_string(&writer, r->strategy_name);
+            report_write(&writer, ",", 1);
+            write_csv_string(&writer, r->username);
+            report_printf(&writer, ",%.2f,%.2f,%.2f,%.4f,%d,%d,%d,%.2f,%.2f,%.2f\n", r->initial_capital,
+                          r->final_value, r->total_return, r->return_pct, r->total_trades,
+                          r->winning_trades, r->losing_trades, r->win_rate, r->total_realized_profit,
+                          r->max_drawdown_pct);
+        } else {
+            report_printf(&writer, "%s\n  {\"strategy\": ", i == 0 ? "" : ",");
+            write_json_string(&writer, r->strategy_name);
+            report_printf(&writer, ", \"user\": ");
+            write_json_string(&writer, r->username);
+            report_printf(&writer, ", \"initial_capital\": %.2f, \"final_value\": %.2f, \"total_return\": %.2f, "
+                          "\"return_pct\": %.4f, \"trades\": %d, \"winning\": %d, \"losing\": %d, "
+                          "\"win_rate\": %.2f, \"realized_profit\": %.2f, \"max_drawdown_pct\": %.2f}",
+                          r->initial_capital, r->final_value, r->total_return, r->return_pct,
+                          r->total_trades, r->winning_trades, r->losing_trades, r->win_rate,
+                          r->total_realized_profit, r->max_drawdown_pct);
+        }
+    }
+    if (format == REPORT_JSON) report_printf(&writer, "%s]\n", result_count > 0 ? "\n" : "");
+    return close_export(path, &writer);
+}
+
+static double stored_value(ResultsStore *store, const char *column, long long row) {
+    const double *values = results_store_column(store, store_column_index(column));
+    return values != NULL ? values[row] : 0.0;
+}
+
+// A query's best rows, or its groups ranked by the mean of the rank column
+void print_query_result(ResultsStore *store, const StoreQuery *query, const QueryResult *result) {
+    const char *rank_name = store_column_name(query->rank_column);
+    ReportWriter writer;
+    report_writer_open(&writer, stdout);
+
+    report_printf(&writer, "\n================================================================================\n");
+    if (query->group_column < 0) {
+        report_printf(&writer, "     QUERY: TOP %d OF %lld MATCHING ROWS BY %s (%s)\n", result->row_count,
+                      result->rows_matched, rank_name, query->ascending ? "lowest" : "highest");
+    } else {
+        report_printf(&writer, "     QUERY: %lld MATCHING ROWS IN %lld GROUPS BY %s, MEAN %s (%s)\n",
+                      result->rows_matched, result->groups_total, store_column_name(query->group_column),
+                      rank_name, query->ascending ? "lowest" : "highest");
+    }
+    report_printf(&writer, "================================================================================\n\n");
+
+    if (query->group_column < 0) {
+        report_printf(&writer, "%-5s %-40s %5s %14.14s %9s %7s %8s\n", "Rank", "Parameters", "Sweep", rank_name,
+                      "Return %", "Win %", "Max DD %");
+        report_printf(&writer, "--------------------------------------------------------------------------------------------\n");
+        for (int i = 0; i < result->row_count; i++) {
+            long long row = result->rows[i].row;
+            const char *name = results_store_name(store, row);
+            report_printf(&writer, "%-5d %-40.40s %5.0f %14.4f %8.2f%% %6.2f%% %7.2f%%\n", i + 1,
+                          name != NULL ? name : "?", stored_value(store, "sweep", row), result->rows[i].value,
+                          stored_value(store, "return_pct", row), stored_value(store, "win_rate", row),
+                          stored_value(store, "max_drawdown_pct", row));
+        }
+    } else {
+        report_printf(&writer, "%16.16s %10s %14s %14s  %-40s\n", store_column_name(query->group_column), "Rows",
+                      "Mean", "Best", "Best parameters");
+        report_printf(&writer, "--------------------------------------------------------------------------------------------------\n");
+        for (int i = 0; i < result->group_count; i++) {
+            const QueryGroup *g = &result->groups[i];
+            const char *name = results_store_name(store, g->best_row);
+            report_printf(&writer, "%16g %10lld %14.4f %14.4f  %-40.40s\n", g->key, g->count,
+                          g->sum / (double)g->count, g->best, name != NULL ? name : "?");
+        }
+    }
+    report_writer_close(&writer);
+}
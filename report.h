@@ -0,0 +1,43 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include "structures.h"
+#include "result_stats.h"
+#include "results_store.h"
+
+#define REPORT_BUFFER_SIZE (64 * 1024)
+// Terminal views list at most this many trades, half from each end
+#define REPORT_TERMINAL_TRADES 40
+// Bars behind the position correlation section
+#define REPORT_CORRELATION_WINDOW 60
+
+typedef enum {
+    REPORT_TEXT,
+    REPORT_CSV,
+    REPORT_JSON
+} ReportFormat;
+
+// Formats into one large buffer and hands it to the stream in big writes
+typedef struct {
+    FILE *out;
+    char *buffer;
+    size_t length;
+    int failed;
+} ReportWriter;
+
+int report_writer_open(ReportWriter *writer, FILE *out);
+void report_printf(ReportWriter *writer, const char *format, ...);
+int report_writer_close(ReportWriter *writer);
+
+ReportFormat report_format_for_path(const char *path);
+void print_detailed_results(Portfolio *portfolio, Stock stocks[], int stock_count, double initial_cash);
+void compare_strategies(StrategyResult results[], int result_count);
+void print_sweep_results(StrategyResult results[], int result_count, int top);
+void print_result_stats(ResultStats *stats);
+void print_query_result(ResultsStore *store, const StoreQuery *query, const QueryResult *result);
+int export_backtest(const char *path, Portfolio *portfolio, Stock stocks[], int stock_count,
+                    double initial_cash);
+int export_comparison(const char *path, StrategyResult results[], int result_count);
+
+#endif
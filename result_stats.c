@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "result_stats.h"
+#include "structures.h"
+
+#define RESULT_STATS_MAGIC "BTSTAT01"
+#define SKETCH_PI 3.14159265358979323846
+
+void stat_sketch_init(StatSketch *sketch) {
+    sketch->count = 0.0;
+    sketch->mean = 0.0;
+    sketch->m2 = 0.0;
+    sketch->min = 0.0;
+    sketch->max = 0.0;
+    sketch->centroid_count = 0;
+    sketch->buffered = 0;
+}
+
+// The t-digest scale function: k units of it hold more weight in the
+// middle of the distribution than at its ends
+static double scale_k(double q) {
+    return SKETCH_COMPRESSION / (2.0 * SKETCH_PI) * asin(2.0 * q - 1.0);
+}
+
+static double scale_q(double k) {
+    if (k >= SKETCH_COMPRESSION / 4.0) return 1.0;
+    return (sin(k * 2.0 * SKETCH_PI / SKETCH_COMPRESSION) + 1.0) / 2.0;
+}
+
+static int compare_centroids(const void *a, const void *b) {
+    double x = ((const SketchCentroid *)a)->mean;
+    double y = ((const SketchCentroid *)b)->mean;
+    return x < y ? -1 : x > y;
+}
+
+// Sorts the buffer into the centroids and merges neighbours while each
+// centroid spans at most one unit of the scale function
+static void compress(StatSketch *sketch) {
+    SketchCentroid all[SKETCH_CAPACITY + SKETCH_BUFFER];
+    int n = 0;
+    double total = 0.0;
+
+    if (sketch->buffered == 0) return;
+    for (int i = 0; i < sketch->centroid_count; i++) all[n++] = sketch->centroids[i];
+    for (int i = 0; i < sketch->buffered; i++) all[n++] = sketch->buffer[i];
+    for (int i = 0; i < n; i++) total += all[i].weight;
+    qsort(all, (size_t)n, sizeof(SketchCentroid), compare_centroids);
+
+    SketchCentroid current = all[0];
+    double done = 0.0;
+    double limit = total * scale_q(scale_k(0.0) + 1.0);
+    int out = 0;
+    for (int i = 1; i < n; i++) {
+        if (done + current.weight + all[i].weight <= limit || out == SKETCH_CAPACITY - 1) {
+            current.weight += all[i].weight;
+            current.mean += (all[i].mean - current.mean) * all[i].weight / current.weight;
+        } else {
+            sketch->centroids[out++] = current;
+            done += current.weight;
+            limit = total * scale_q(scale_k(done / total) + 1.0);
+            current = all[i];
+        }
+    }
+    sketch->centroids[out++] = current;
+    sketch->centroid_count = out;
+    sketch->buffered = 0;
+}
+
+static void add_weighted(StatSketch *sketch, double mean, double weight) {
+    if (sketch->buffered == SKETCH_BUFFER) compress(sketch);
+    sketch->buffer[sketch->buffered].mean = mean;
+    sketch->buffer[sketch->buffered].weight = weight;
+    sketch->buffered++;
+}
+
+// NaN values are ignored
+void stat_sketch_add(StatSketch *sketch, double value) {
+    if (value != value) return;
+
+    if (sketch->count == 0.0 || value < sketch->min) sketch->min = value;
+    if (sketch->count == 0.0 || value > sketch->max) sketch->max = value;
+    sketch->count += 1.0;
+    double delta = value - sketch->mean;
+    sketch->mean += delta / sketch->count;
+    sketch->m2 += delta * (value - sketch->mean);
+    add_weighted(sketch, value, 1.0);
+}
+
+void stat_sketch_merge(StatSketch *into, const StatSketch *from) {
+    if (from->count == 0.0) return;
+    if (into->count == 0.0 || from->min < into->min) into->min = from->min;
+    if (into->count == 0.0 || from->max > into->max) into->max = from->max;
+
+    double count = into->count + from->count;
+    double delta = from->mean - into->mean;
+    into->m2 += from->m2 + delta * delta * into->count * from->count / count;
+    into->mean += delta * from->count / count;
+    into->count = count;
+
+    for (int i = 0; i < from->centroid_count; i++) {
+        add_weighted(into, from->centroids[i].mean, from->centroids[i].weight);
+    }
+    for (int i = 0; i < from->buffered; i++) add_weighted(into, from->buffer[i].mean, from->buffer[i].weight);
+}
+
+// Value below which a fraction q of the data lies, interpolating between
+// centroid centres and out to the exact min and max
+double stat_sketch_quantile(StatSketch *sketch, double q) {
+    compress(sketch);
+    if (sketch->count == 0.0) return 0.0;
+
+    const SketchCentroid *c = sketch->centroids;
+    int n = sketch->centroid_count;
+    double total = 0.0;
+    for (int i = 0; i < n; i++) total += c[i].weight;
+
+    double index = q * total;
+    if (index <= 0.0) return sketch->min;
+    if (index >= total) return sketch->max;
+    if (index < c[0].weight / 2.0) {
+        return sketch->min + (c[0].mean - sketch->min) * index / (c[0].weight / 2.0);
+    }
+
+    double before = 0.0;
+    for (int i = 0; i + 1 < n; i++) {
+        double center = before + c[i].weight / 2.0;
+        double next_center = before + c[i].weight + c[i + 1].weight / 2.0;
+        if (index < next_center) {
+            return c[i].mean + (c[i + 1].mean - c[i].mean) * (index - center) / (next_center - center);
+        }
+        before += c[i].weight;
+    }
+    double center = total - c[n - 1].weight / 2.0;
+    return c[n - 1].mean + (sketch->max - c[n - 1].mean) * (index - center) / (c[n - 1].weight / 2.0);
+}
+
+// Fraction of the data at or below x
+double stat_sketch_cdf(StatSketch *sketch, double x) {
+    compress(sketch);
+    if (sketch->count == 0.0 || x < sketch->min) return 0.0;
+    if (x >= sketch->max) return 1.0;
+
+    const SketchCentroid *c = sketch->centroids;
+    int n = sketch->centroid_count;
+    double total = 0.0;
+    for (int i = 0; i < n; i++) total += c[i].weight;
+
+    if (x < c[0].mean) {
+        return c[0].weight / 2.0 * (x - sketch->min) / (c[0].mean - sketch->min) / total;
+    }
+    double before = 0.0;
+    for (int i = 0; i + 1 < n; i++) {
+        double center = before + c[i].weight / 2.0;
+        if (x < c[i + 1].mean) {
+            double span = (c[i].weight + c[i + 1].weight) / 2.0;
+            return (center + span * (x - c[i].mean) / (c[i + 1].mean - c[i].mean)) / total;
+        }
+        before += c[i].weight;
+    }
+    double center = total - c[n - 1].weight / 2.0;
+    return (center + c[n - 1].weight / 2.0 * (x - c[n - 1].mean) / (sketch->max - c[n - 1].mean)) / total;
+}
+
+double stat_sketch_stddev(const StatSketch *sketch) {
+    return sketch->count > 1.0 ? sqrt(sketch->m2 / (sketch->count - 1.0)) : 0.0;
+}
+
+void result_stats_init(ResultStats *stats) {
+    stat_sketch_init(&stats->return_pct);
+    stat_sketch_init(&stats->win_rate);
+    stat_sketch_init(&stats->max_drawdown_pct);
+}
+
+void result_stats_add(ResultStats *stats, const StrategyResult *result) {
+    stat_sketch_add(&stats->return_pct, result->return_pct);
+    stat_sketch_add(&stats->win_rate, result->win_rate);
+    stat_sketch_add(&stats->max_drawdown_pct, result->max_drawdown_pct);
+}
+
+void result_stats_merge(ResultStats *into, const ResultStats *from) {
+    stat_sketch_merge(&into->return_pct, &from->return_pct);
+    stat_sketch_merge(&into->win_rate, &from->win_rate);
+    stat_sketch_merge(&into->max_drawdown_pct, &from->max_drawdown_pct);
+}
+
+// On disk each sketch is its moments, then its compressed centroids
+typedef struct {
+    double count;
+    double mean;
+    double m2;
+    double min;
+    double max;
+    int centroid_count;
+} SketchHeader;
+
+static int write_sketch(FILE *fp, StatSketch *sketch) {
+    SketchHeader header;
+
+    compress(sketch);
+    memset(&header, 0, sizeof(header));
+    header.count = sketch->count;
+    header.mean = sketch->mean;
+    header.m2 = sketch->m2;
+    header.min = sketch->min;
+    header.max = sketch->max;
+    header.centroid_count = sketch->centroid_count;
+    return fwrite(&header, sizeof(header), 1, fp) == 1 &&
+           fwrite(sketch->centroids, sizeof(SketchCentroid), (size_t)sketch->centroid_count, fp) ==
+               (size_t)sketch->centroid_count;
+}
+
+static int read_sketch(FILE *fp, StatSketch *sketch) {
+    SketchHeader header;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1) return 0;
+    if (header.centroid_count < 0 || header.centroid_count > SKETCH_CAPACITY) return 0;
+    stat_sketch_init(sketch);
+    sketch->count = header.count;
+    sketch->mean = header.mean;
+    sketch->m2 = header.m2;
+    sketch->min = header.min;
+    sketch->max = header.max;
+    sketch->centroid_count = header.centroid_count;
+    return fread(sketch->centroids, sizeof(SketchCentroid), (size_t)header.centroid_count, fp) ==
+           (size_t)header.centroid_count;
+}
+
+// A few kilobytes whatever the number of runs summarized. Returns -1 if
+// the file cannot be written.
+int result_stats_save(const char *path, ResultStats *stats) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return -1;
+
+    int ok = fwrite(RESULT_STATS_MAGIC, 1, 8, fp) == 8 && write_sketch(fp, &stats->return_pct) &&
+             write_sketch(fp, &stats->win_rate) && write_sketch(fp, &stats->max_drawdown_pct);
+    if (fclose(fp) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
+
+// Returns -1 if the file is missing or not a saved ResultStats
+int result_stats_load(const char *path, ResultStats *stats) {
+    char magic[8];
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return -1;
+
+    result_stats_init(stats);
+    int ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, RESULT_STATS_MAGIC, 8) == 0 &&
+             read_sketch(fp, &stats->return_pct) && read_sketch(fp, &stats->win_rate) &&
+             read_sketch(fp, &stats->max_drawdown_pct);
+    fclose(fp);
+    return ok ? 0 : -1;
+}
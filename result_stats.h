@@ -0,0 +1,54 @@
+#ifndef RESULT_STATS_H
+#define RESULT_STATS_H
+
+#include "structures.h"
+
+// Accuracy of the quantile sketch: more centroids, tighter tails
+#define SKETCH_COMPRESSION 200
+#define SKETCH_CAPACITY SKETCH_COMPRESSION
+#define SKETCH_BUFFER 512
+
+typedef struct {
+    double mean;
+    double weight;
+} SketchCentroid;
+
+// Distribution of one metric in constant memory: running moments plus a
+// merging t-digest. Centroids are small near the extremes, so p5/p95 stay
+// accurate however many values are added. Two sketches merge into one
+// that summarizes both streams.
+typedef struct {
+    double count;
+    double mean;
+    double m2;                          // sum of squared deviations from mean
+    double min;
+    double max;
+    SketchCentroid centroids[SKETCH_CAPACITY];
+    int centroid_count;
+    SketchCentroid buffer[SKETCH_BUFFER];   // added since the last compression
+    int buffered;
+} StatSketch;
+
+// The metrics tracked across a sweep or any other set of runs. Scheduled
+// batches keep one per worker and merge them at the end; saved ones merge
+// across processes.
+typedef struct {
+    StatSketch return_pct;
+    StatSketch win_rate;
+    StatSketch max_drawdown_pct;
+} ResultStats;
+
+void stat_sketch_init(StatSketch *sketch);
+void stat_sketch_add(StatSketch *sketch, double value);
+void stat_sketch_merge(StatSketch *into, const StatSketch *from);
+double stat_sketch_quantile(StatSketch *sketch, double q);
+double stat_sketch_cdf(StatSketch *sketch, double x);
+double stat_sketch_stddev(const StatSketch *sketch);
+
+void result_stats_init(ResultStats *stats);
+void result_stats_add(ResultStats *stats, const StrategyResult *result);
+void result_stats_merge(ResultStats *into, const ResultStats *from);
+int result_stats_save(const char *path, ResultStats *stats);
+int result_stats_load(const char *path, ResultStats *stats);
+
+#endif
@@ -0,0 +1,608 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "results_store.h"
+#include "structures.h"
+
+// Rows filtered together: the selection vector stays in L1
+#define QUERY_CHUNK 4096
+
+typedef enum {
+    SOURCE_SWEEP,
+    SOURCE_STRATEGY,
+    SOURCE_RESULT
+} ColumnSource;
+
+typedef struct {
+    const char *name;
+    ColumnSource source;
+    size_t offset;
+    int is_int;
+} StoreColumn;
+
+// Every column is stored as doubles, whatever its type in the structs
+static const StoreColumn store_columns[STORE_COLUMN_COUNT] = {
+    { "sweep", SOURCE_SWEEP, 0, 1 },
+    { "rsi_oversold", SOURCE_STRATEGY, offsetof(Strategy, rsi_oversold), 0 },
+    { "rsi_overbought", SOURCE_STRATEGY, offsetof(Strategy, rsi_overbought), 0 },
+    { "sma_short_period", SOURCE_STRATEGY, offsetof(Strategy, sma_short_period), 1 },
+    { "sma_long_period", SOURCE_STRATEGY, offsetof(Strategy, sma_long_period), 1 },
+    { "stop_loss_pct", SOURCE_STRATEGY, offsetof(Strategy, stop_loss_pct), 0 },
+    { "take_profit_pct", SOURCE_STRATEGY, offsetof(Strategy, take_profit_pct), 0 },
+    { "max_holding_days", SOURCE_STRATEGY, offsetof(Strategy, max_holding_days), 1 },
+    { "initial_capital", SOURCE_RESULT, offsetof(StrategyResult, initial_capital), 0 },
+    { "final_value", SOURCE_RESULT, offsetof(StrategyResult, final_value), 0 },
+    { "total_return", SOURCE_RESULT, offsetof(StrategyResult, total_return), 0 },
+    { "return_pct", SOURCE_RESULT, offsetof(StrategyResult, return_pct), 0 },
+    { "total_trades", SOURCE_RESULT, offsetof(StrategyResult, total_trades), 1 },
+    { "winning_trades", SOURCE_RESULT, offsetof(StrategyResult, winning_trades), 1 },
+    { "losing_trades", SOURCE_RESULT, offsetof(StrategyResult, losing_trades), 1 },
+    { "win_rate", SOURCE_RESULT, offsetof(StrategyResult, win_rate), 0 },
+    { "total_realized_profit", SOURCE_RESULT, offsetof(StrategyResult, total_realized_profit), 0 },
+    { "max_drawdown_pct", SOURCE_RESULT, offsetof(StrategyResult, max_drawdown_pct), 0 }
+};
+
+// Serializes appends between threads; the manifest's file lock does the
+// same between processes
+static pthread_mutex_t append_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int store_column_index(const char *name) {
+    for (int i = 0; i < STORE_COLUMN_COUNT; i++) {
+        if (strcmp(store_columns[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+const char *store_column_name(int column) {
+    return column >= 0 && column < STORE_COLUMN_COUNT ? store_columns[column].name : "?";
+}
+
+static void column_path(char *path, size_t size, const char *dir, int column) {
+    if (column == STORE_COLUMN_COUNT) {
+        snprintf(path, size, "%s/name.str", dir);
+    } else {
+        snprintf(path, size, "%s/%s.f64", dir, store_columns[column].name);
+    }
+}
+
+static int lock_file(int fd, short type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &lock) != 0) {
+        if (errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+// An empty manifest is a fresh store
+static int read_manifest(int fd, StoreManifest *manifest) {
+    ssize_t got = pread(fd, manifest, sizeof(StoreManifest), 0);
+    if (got == 0) {
+        memset(manifest, 0, sizeof(StoreManifest));
+        memcpy(manifest->magic, RESULTS_STORE_MAGIC, 8);
+        return 0;
+    }
+    if (got != (ssize_t)sizeof(StoreManifest) || memcmp(manifest->magic, RESULTS_STORE_MAGIC, 8) != 0 ||
+        manifest->rows < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t wrote = write(fd, p, size);
+        if (wrote < 0 && errno == EINTR) continue;
+        if (wrote <= 0) return -1;
+        p += wrote;
+        size -= (size_t)wrote;
+    }
+    return 0;
+}
+
+static double column_value(int column, const Strategy *strategy, const StrategyResult *result, int sweep_id) {
+    const StoreColumn *c = &store_columns[column];
+    const char *base = c->source == SOURCE_STRATEGY ? (const char *)strategy : (const char *)result;
+
+    if (c->source == SOURCE_SWEEP) return sweep_id;
+    if (c->is_int) {
+        int value;
+        memcpy(&value, base + c->offset, sizeof(value));
+        return value;
+    }
+    double value;
+    memcpy(&value, base + c->offset, sizeof(value));
+    return value;
+}
+
+// Writes the rows after the committed ones, cutting off whatever a failed
+// earlier append left past them, then commits by rewriting the manifest
+static int append_rows(const char *dir, int manifest_fd, const Strategy strategies[],
+                       const StrategyResult results[], int count, int *sweep_id) {
+    StoreManifest manifest;
+    int fds[STORE_COLUMN_COUNT + 1];
+    int opened = 0, ok = 1;
+    char path[512];
+
+    if (read_manifest(manifest_fd, &manifest) != 0) return -1;
+    int id = manifest.sweeps + 1;
+
+    for (; opened <= STORE_COLUMN_COUNT && ok; opened++) {
+        off_t width = opened == STORE_COLUMN_COUNT ? STORE_NAME_WIDTH : (off_t)sizeof(double);
+        off_t end = (off_t)manifest.rows * width;
+
+        column_path(path, sizeof(path), dir, opened);
+        fds[opened] = open(path, O_WRONLY | O_CREAT, 0644);
+        if (fds[opened] < 0) break;
+        ok = ftruncate(fds[opened], end) == 0 && lseek(fds[opened], end, SEEK_SET) == end;
+    }
+    ok = ok && opened == STORE_COLUMN_COUNT + 1;
+
+    double *values = malloc(sizeof(double) * RESULTS_STORE_BATCH);
+    char *names = malloc((size_t)STORE_NAME_WIDTH * RESULTS_STORE_BATCH);
+    if (values == NULL || names == NULL) ok = 0;
+
+    for (int start = 0; start < count && ok; start += RESULTS_STORE_BATCH) {
+        int n = count - start < RESULTS_STORE_BATCH ? count - start : RESULTS_STORE_BATCH;
+
+        for (int c = 0; c < STORE_COLUMN_COUNT && ok; c++) {
+            for (int i = 0; i < n; i++) values[i] = column_value(c, &strategies[start + i], &results[start + i], id);
+            ok = write_all(fds[c], values, sizeof(double) * (size_t)n) == 0;
+        }
+        memset(names, 0, (size_t)STORE_NAME_WIDTH * (size_t)n);
+        for (int i = 0; i < n; i++) {
+            memcpy(names + (size_t)i * STORE_NAME_WIDTH, strategies[start + i].name, STORE_NAME_WIDTH - 1);
+        }
+        ok = ok && write_all(fds[STORE_COLUMN_COUNT], names, (size_t)STORE_NAME_WIDTH * (size_t)n) == 0;
+    }
+    free(values);
+    free(names);
+    for (int c = 0; c < opened; c++) {
+        if (fds[c] >= 0 && close(fds[c]) != 0) ok = 0;
+    }
+    if (!ok) return -1;
+
+    manifest.rows += count;
+    manifest.sweeps = id;
+    if (pwrite(manifest_fd, &manifest, sizeof(manifest), 0) != (ssize_t)sizeof(manifest)) return -1;
+    *sweep_id = id;
+    return 0;
+}
+
+// Appends one sweep's parameter sets and results as a new sweep id,
+// creating the store if needed. Returns -1 if the store cannot be written,
+// in which case it is left as it was before the call.
+int results_store_append(const char *dir, const Strategy strategies[], const StrategyResult results[],
+                         int count, int *sweep_id) {
+    char path[512];
+    int status = -1;
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+    snprintf(path, sizeof(path), "%s/MANIFEST", dir);
+
+    pthread_mutex_lock(&append_lock);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd >= 0) {
+        if (lock_file(fd, F_WRLCK) == 0) {
+            status = append_rows(dir, fd, strategies, results, count, sweep_id);
+        }
+        close(fd);
+    }
+    pthread_mutex_unlock(&append_lock);
+    return status;
+}
+
+// Returns -1 if there is no readable store in dir
+int results_store_open(ResultsStore *store, const char *dir) {
+    StoreManifest manifest;
+    char path[512];
+
+    memset(store, 0, sizeof(ResultsStore));
+    snprintf(store->dir, sizeof(store->dir), "%s", dir);
+    snprintf(path, sizeof(path), "%s/MANIFEST", dir);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    int ok = lock_file(fd, F_RDLCK) == 0 && read_manifest(fd, &manifest) == 0;
+    close(fd);
+    if (!ok) return -1;
+
+    store->rows = manifest.rows;
+    store->sweeps = manifest.sweeps;
+    return 0;
+}
+
+static const void *map_column(const ResultsStore *store, int column, size_t size, int advice) {
+    char path[512];
+    struct stat info;
+
+    column_path(path, sizeof(path), store->dir, column);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < size) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    posix_madvise(data, size, advice);
+    return data;
+}
+
+// The committed rows of a column, mapped on first use; NULL if the store
+// is empty or the column file is missing or short
+const double *results_store_column(ResultsStore *store, int column) {
+    if (column < 0 || column >= STORE_COLUMN_COUNT || store->rows == 0) return NULL;
+    if (store->columns[column] == NULL) {
+        store->columns[column] = map_column(store, column, sizeof(double) * (size_t)store->rows,
+                                            POSIX_MADV_SEQUENTIAL);
+    }
+    return store->columns[column];
+}
+
+// Only the pages of the rows asked for are read
+const char *results_store_name(ResultsStore *store, long long row) {
+    if (row < 0 || row >= store->rows) return NULL;
+    if (store->names == NULL) {
+        store->names = map_column(store, STORE_COLUMN_COUNT, (size_t)STORE_NAME_WIDTH * (size_t)store->rows,
+                                  POSIX_MADV_RANDOM);
+        if (store->names == NULL) return NULL;
+    }
+    return store->names + (size_t)row * STORE_NAME_WIDTH;
+}
+
+void results_store_close(ResultsStore *store) {
+    for (int c = 0; c < STORE_COLUMN_COUNT; c++) {
+        if (store->columns[c] != NULL) {
+            munmap((void *)store->columns[c], sizeof(double) * (size_t)store->rows);
+        }
+        store->columns[c] = NULL;
+    }
+    if (store->names != NULL) munmap((void *)store->names, (size_t)STORE_NAME_WIDTH * (size_t)store->rows);
+    store->names = NULL;
+}
+
+// Every row, best return first, twenty of them
+void store_query_init(StoreQuery *query) {
+    memset(query, 0, sizeof(StoreQuery));
+    query->group_column = -1;
+    query->rank_column = store_column_index("return_pct");
+    query->limit = 20;
+}
+
+static const char *skip_spaces(const char *p) {
+    while (isspace((unsigned char)*p)) p++;
+    return p;
+}
+
+// Parses "column op number [and column op number]...", op one of
+// < <= > >= = == !=, into the query's terms. An empty text matches every
+// row. Returns -1 with the problem in error.
+int parse_store_filter(const char *text, StoreQuery *query, char *error, int error_size) {
+    const char *p = skip_spaces(text);
+
+    query->term_count = 0;
+    while (*p != '\0') {
+        char name[64];
+        int length = 0;
+        QueryTerm term;
+
+        while (isalnum((unsigned char)*p) || *p == '_') {
+            if (length < (int)sizeof(name) - 1) name[length++] = *p;
+            p++;
+        }
+        name[length] = '\0';
+        if (length == 0) {
+            snprintf(error, (size_t)error_size, "expected a column name at '%s'", p);
+            return -1;
+        }
+        term.column = store_column_index(name);
+        if (term.column < 0) {
+            snprintf(error, (size_t)error_size, "unknown column '%s'", name);
+            return -1;
+        }
+
+        p = skip_spaces(p);
+        if (p[0] == '<' && p[1] == '=') term.op = QUERY_LE, p += 2;
+        else if (p[0] == '>' && p[1] == '=') term.op = QUERY_GE, p += 2;
+        else if (p[0] == '!' && p[1] == '=') term.op = QUERY_NE, p += 2;
+        else if (p[0] == '=' && p[1] == '=') term.op = QUERY_EQ, p += 2;
+        else if (p[0] == '=') term.op = QUERY_EQ, p += 1;
+        else if (p[0] == '<') term.op = QUERY_LT, p += 1;
+        else if (p[0] == '>') term.op = QUERY_GT, p += 1;
+        else {
+            snprintf(error, (size_t)error_size, "expected a comparison after '%s'", name);
+            return -1;
+        }
+
+        char *end;
+        term.value = strtod(p, &end);
+        if (end == p) {
+            snprintf(error, (size_t)error_size, "expected a number after '%s'", name);
+            return -1;
+        }
+        if (query->term_count == STORE_MAX_TERMS) {
+            snprintf(error, (size_t)error_size, "more than %d conditions", STORE_MAX_TERMS);
+            return -1;
+        }
+        query->terms[query->term_count++] = term;
+
+        p = skip_spaces(end);
+        if (*p == '\0') break;
+        if (tolower((unsigned char)p[0]) == 'a' && tolower((unsigned char)p[1]) == 'n' &&
+            tolower((unsigned char)p[2]) == 'd' && (isspace((unsigned char)p[3]) || p[3] == '\0')) {
+            p = skip_spaces(p + 3);
+        } else if (p[0] == '&' && p[1] == '&') {
+            p = skip_spaces(p + 2);
+        } else {
+            snprintf(error, (size_t)error_size, "expected 'and' at '%s'", p);
+            return -1;
+        }
+        if (*p == '\0') {
+            snprintf(error, (size_t)error_size, "expected a condition after 'and'");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Keeps the entries of sel[] whose value passes the term, without branching
+// on the data
+static int refine_selection(const double *values, const QueryTerm *term, int sel[], int count) {
+    double v = term->value;
+    int kept = 0;
+
+#define KEEP_WHERE(condition)                                \
+    for (int i = 0; i < count; i++) {                        \
+        int j = sel[i];                                      \
+        sel[kept] = j;                                       \
+        kept += (condition);                                 \
+    }
+
+    switch (term->op) {
+    case QUERY_LT: KEEP_WHERE(values[j] < v) break;
+    case QUERY_LE: KEEP_WHERE(values[j] <= v) break;
+    case QUERY_GT: KEEP_WHERE(values[j] > v) break;
+    case QUERY_GE: KEEP_WHERE(values[j] >= v) break;
+    case QUERY_EQ: KEEP_WHERE(values[j] == v) break;
+    case QUERY_NE: KEEP_WHERE(values[j] != v) break;
+    }
+#undef KEEP_WHERE
+    return kept;
+}
+
+// The limit best rows seen so far, as a min-heap on score (the rank value,
+// negated when ranking ascending) so the weakest is replaced first
+typedef struct {
+    RankedRow *rows;
+    double *scores;
+    int count;
+    int limit;
+} TopRows;
+
+static void offer_row(TopRows *top, long long row, double value, double score) {
+    int i;
+
+    if (top->count < top->limit) {
+        i = top->count++;
+        while (i > 0 && top->scores[(i - 1) / 2] > score) {
+            top->rows[i] = top->rows[(i - 1) / 2];
+            top->scores[i] = top->scores[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+    } else {
+        if (score <= top->scores[0]) return;
+        i = 0;
+        for (;;) {
+            int child = 2 * i + 1;
+            if (child >= top->count) break;
+            if (child + 1 < top->count && top->scores[child + 1] < top->scores[child]) child++;
+            if (top->scores[child] >= score) break;
+            top->rows[i] = top->rows[child];
+            top->scores[i] = top->scores[child];
+            i = child;
+        }
+    }
+    top->rows[i].row = row;
+    top->rows[i].value = value;
+    top->scores[i] = score;
+}
+
+// Open-addressed groups keyed by the bits of the group column's value.
+// Whole numbers have all-zero low mantissa bits, so the slot comes from the
+// top of the multiplied key.
+typedef struct {
+    QueryGroup *slots;
+    unsigned char *used;
+    long long capacity;                 // a power of two, 1 << bits
+    int bits;
+    long long count;
+} GroupTable;
+
+static unsigned long long key_bits(double key) {
+    unsigned long long bits;
+    if (key == 0.0) key = 0.0;          // -0 and 0 group together
+    memcpy(&bits, &key, sizeof(bits));
+    return bits;
+}
+
+static long long group_slot(const GroupTable *table, double key) {
+    unsigned long long bits = key_bits(key);
+    long long slot = (long long)((bits * 0x9E3779B97F4A7C15ULL) >> (64 - table->bits));
+    while (table->used[slot] && key_bits(table->slots[slot].key) != bits) slot = (slot + 1) & (table->capacity - 1);
+    return slot;
+}
+
+static int grow_groups(GroupTable *table) {
+    GroupTable grown;
+
+    grown.bits = table->capacity > 0 ? table->bits + 1 : 10;
+    grown.capacity = 1LL << grown.bits;
+    grown.count = table->count;
+    grown.slots = malloc(sizeof(QueryGroup) * (size_t)grown.capacity);
+    grown.used = calloc((size_t)grown.capacity, 1);
+    if (grown.slots == NULL || grown.used == NULL) {
+        free(grown.slots);
+        free(grown.used);
+        return -1;
+    }
+    for (long long i = 0; i < table->capacity; i++) {
+        if (!table->used[i]) continue;
+        long long slot = group_slot(&grown, table->slots[i].key);
+        grown.slots[slot] = table->slots[i];
+        grown.used[slot] = 1;
+    }
+    free(table->slots);
+    free(table->used);
+    *table = grown;
+    return 0;
+}
+
+static int add_to_group(GroupTable *table, double key, long long row, double value, double score, int ascending) {
+    if (table->count * 2 >= table->capacity && grow_groups(table) != 0) return -1;
+
+    long long slot = group_slot(table, key);
+    QueryGroup *group = &table->slots[slot];
+    if (!table->used[slot]) {
+        table->used[slot] = 1;
+        table->count++;
+        group->key = key;
+        group->count = 0;
+        group->sum = 0.0;
+        group->best = value;
+        group->best_row = row;
+    } else if (score > (ascending ? -group->best : group->best)) {
+        group->best = value;
+        group->best_row = row;
+    }
+    group->count++;
+    group->sum += value;
+    return 0;
+}
+
+static int compare_rows_desc(const void *a, const void *b) {
+    double x = ((const RankedRow *)a)->value, y = ((const RankedRow *)b)->value;
+    return x > y ? -1 : x < y;
+}
+
+static int compare_rows_asc(const void *a, const void *b) {
+    return compare_rows_desc(b, a);
+}
+
+static int compare_groups_desc(const void *a, const void *b) {
+    const QueryGroup *x = a, *y = b;
+    double mx = x->sum / (double)x->count, my = y->sum / (double)y->count;
+    if (mx != my) return mx > my ? -1 : 1;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+static int compare_groups_asc(const void *a, const void *b) {
+    const QueryGroup *x = a, *y = b;
+    double mx = x->sum / (double)x->count, my = y->sum / (double)y->count;
+    if (mx != my) return mx < my ? -1 : 1;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+// Filters the store a chunk at a time over only the columns the query
+// names, feeding the survivors to the top-N heap or the group table. Rows
+// whose rank value is NaN are never ranked. Returns -1 if a column cannot
+// be mapped or memory runs out.
+int run_store_query(ResultsStore *store, const StoreQuery *query, QueryResult *result) {
+    const double *term_columns[STORE_MAX_TERMS];
+    int sel[QUERY_CHUNK];
+    TopRows top;
+    GroupTable groups;
+    int status = 0;
+
+    memset(result, 0, sizeof(QueryResult));
+    if (store->rows == 0 || query->limit <= 0) return 0;
+
+    const double *rank = results_store_column(store, query->rank_column);
+    const double *group = query->group_column >= 0 ? results_store_column(store, query->group_column) : NULL;
+    if (rank == NULL || (query->group_column >= 0 && group == NULL)) return -1;
+    for (int t = 0; t < query->term_count; t++) {
+        if ((term_columns[t] = results_store_column(store, query->terms[t].column)) == NULL) return -1;
+    }
+
+    memset(&top, 0, sizeof(top));
+    memset(&groups, 0, sizeof(groups));
+    top.limit = query->limit;
+    if (group == NULL) {
+        top.rows = malloc(sizeof(RankedRow) * (size_t)top.limit);
+        top.scores = malloc(sizeof(double) * (size_t)top.limit);
+        if (top.rows == NULL || top.scores == NULL) status = -1;
+    }
+
+    for (long long base = 0; base < store->rows && status == 0; base += QUERY_CHUNK) {
+        int n = store->rows - base < QUERY_CHUNK ? (int)(store->rows - base) : QUERY_CHUNK;
+        int count = n;
+
+        for (int i = 0; i < n; i++) sel[i] = i;
+        for (int t = 0; t < query->term_count && count > 0; t++) {
+            count = refine_selection(term_columns[t] + base, &query->terms[t], sel, count);
+        }
+        result->rows_matched += count;
+
+        for (int i = 0; i < count && status == 0; i++) {
+            long long row = base + sel[i];
+            double value = rank[row];
+            double score = query->ascending ? -value : value;
+            if (value != value) continue;
+            if (group != NULL) {
+                status = add_to_group(&groups, group[row], row, value, score, query->ascending);
+            } else {
+                offer_row(&top, row, value, score);
+            }
+        }
+    }
+
+    if (status == 0 && group != NULL && groups.count > 0) {
+        result->groups = malloc(sizeof(QueryGroup) * (size_t)groups.count);
+        if (result->groups == NULL) {
+            status = -1;
+        } else {
+            long long n = 0;
+            for (long long i = 0; i < groups.capacity; i++) {
+                if (groups.used[i]) result->groups[n++] = groups.slots[i];
+            }
+            qsort(result->groups, (size_t)n, sizeof(QueryGroup),
+                  query->ascending ? compare_groups_asc : compare_groups_desc);
+            result->groups_total = n;
+            result->group_count = n < query->limit ? (int)n : query->limit;
+        }
+    }
+    if (status == 0 && group == NULL) {
+        qsort(top.rows, (size_t)top.count, sizeof(RankedRow), query->ascending ? compare_rows_asc : compare_rows_desc);
+        result->rows = top.rows;
+        result->row_count = top.count;
+        top.rows = NULL;
+    }
+    free(top.rows);
+    free(top.scores);
+    free(groups.slots);
+    free(groups.used);
+    if (status != 0) free_query_result(result);
+    return status;
+}
+
+void free_query_result(QueryResult *result) {
+    free(result->rows);
+    free(result->groups);
+    result->rows = NULL;
+    result->groups = NULL;
+    result->row_count = 0;
+    result->group_count = 0;
+}
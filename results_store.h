@@ -0,0 +1,97 @@
+#ifndef RESULTS_STORE_H
+#define RESULTS_STORE_H
+
+#include "structures.h"
+
+// Columnar store of evaluated parameter sets: a directory holding one file
+// of doubles per Strategy field and StrategyResult metric, a fixed-width
+// file of strategy names and a MANIFEST with the committed row count.
+// Appends write whole batches per column and commit by updating the
+// manifest, so readers never see a half-written sweep. Queries map only
+// the columns they touch.
+#define RESULTS_STORE_DIR "sweep_results"
+#define RESULTS_STORE_MAGIC "BTSTORE1"
+#define RESULTS_STORE_BATCH 4096        // rows gathered per column write
+#define STORE_COLUMN_COUNT 18
+#define STORE_NAME_WIDTH 50
+#define STORE_MAX_TERMS 8
+
+typedef struct {
+    char magic[8];
+    long long rows;
+    int sweeps;
+    int reserved;
+} StoreManifest;
+
+// A store opened for queries. Column pointers stay NULL until first used.
+typedef struct {
+    char dir[256];
+    long long rows;
+    int sweeps;
+    const double *columns[STORE_COLUMN_COUNT];
+    const char *names;                  // rows * STORE_NAME_WIDTH bytes
+} ResultsStore;
+
+typedef enum {
+    QUERY_LT,
+    QUERY_LE,
+    QUERY_GT,
+    QUERY_GE,
+    QUERY_EQ,
+    QUERY_NE
+} QueryOp;
+
+typedef struct {
+    int column;
+    QueryOp op;
+    double value;
+} QueryTerm;
+
+// Rows matching every term, ranked by one column. With a group column the
+// matching rows are summarized per distinct value of it and the groups are
+// ranked by their mean instead.
+typedef struct {
+    QueryTerm terms[STORE_MAX_TERMS];
+    int term_count;
+    int group_column;                   // -1: rank individual rows
+    int rank_column;
+    int ascending;
+    int limit;
+} StoreQuery;
+
+typedef struct {
+    long long row;
+    double value;
+} RankedRow;
+
+typedef struct {
+    double key;
+    long long count;
+    double sum;                         // of the rank column
+    double best;
+    long long best_row;
+} QueryGroup;
+
+typedef struct {
+    long long rows_matched;
+    RankedRow *rows;                    // best first
+    int row_count;
+    QueryGroup *groups;                 // best mean first
+    int group_count;                    // shown, at most the limit
+    long long groups_total;
+} QueryResult;
+
+int store_column_index(const char *name);
+const char *store_column_name(int column);
+int results_store_append(const char *dir, const Strategy strategies[], const StrategyResult results[],
+                         int count, int *sweep_id);
+int results_store_open(ResultsStore *store, const char *dir);
+const double *results_store_column(ResultsStore *store, int column);
+const char *results_store_name(ResultsStore *store, long long row);
+void results_store_close(ResultsStore *store);
+void store_query_init(StoreQuery *query);
+int parse_store_filter(const char *text, StoreQuery *query, char *error, int error_size);
+int run_store_query(ResultsStore *store, const StoreQuery *query, QueryResult *result);
+void free_query_result(QueryResult *result);
+
+#endif
@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "rules.h"
+#include "backtest.h"
+#include "structures.h"
+
+#define RULE_MAX_NODES 64
+#define RULE_MAX_WORD 32
+
+// Bytecode instructions. Operands are one byte and follow the opcode.
+enum {
+    OP_END,
+    OP_CONST,       // push consts[operand]
+    OP_LOAD,        // push columns[operand][day]
+    OP_LOAD_PREV,   // push columns[operand][day - 1]
+    OP_STATE,       // push state[operand]
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_AND,
+    OP_OR,
+    OP_NOT
+};
+
+typedef enum { TERM_NUMBER, TERM_INDICATOR, TERM_STATE } TermKind;
+
+typedef struct {
+    TermKind kind;
+    double value;
+    RuleIndicator indicator;
+    int state;
+} RuleTerm;
+
+typedef enum { NODE_BOOL, NODE_COMPARE, NODE_CROSS, NODE_AND, NODE_OR, NODE_NOT } NodeKind;
+
+typedef struct {
+    NodeKind kind;
+    int value;          // boolean value, comparison opcode or cross direction
+    RuleTerm left;
+    RuleTerm right;
+    int a;
+    int b;
+} RuleNode;
+
+typedef enum { TOK_END, TOK_NUMBER, TOK_WORD, TOK_LPAREN, TOK_RPAREN, TOK_COMPARE, TOK_ERROR } TokenType;
+
+typedef struct {
+    const char *text;
+    int pos;
+    int is_exit;
+    TokenType tok;
+    char word[RULE_MAX_WORD];
+    double number;
+    int compare_op;
+    RuleNode nodes[RULE_MAX_NODES];
+    int node_count;
+    char *error;
+    int error_size;
+    int failed;
+} RuleParser;
+
+static void rule_error(RuleParser *p, const char *message, const char *detail) {
+    if (p->failed) return;
+    p->failed = 1;
+    if (p->error != NULL && p->error_size > 0) {
+        snprintf(p->error, p->error_size, "%s%s (at position %d)", message, detail, p->pos);
+    }
+}
+
+static void next_token(RuleParser *p) {
+    const char *s = p->text;
+    while (isspace((unsigned char)s[p->pos])) p->pos++;
+
+    char c = s[p->pos];
+    if (c == '\0') {
+        p->tok = TOK_END;
+    } else if (c == '(') {
+        p->tok = TOK_LPAREN;
+        p->pos++;
+    } else if (c == ')') {
+        p->tok = TOK_RPAREN;
+        p->pos++;
+    } else if (c == '<' || c == '>') {
+        int or_equal = (s[p->pos + 1] == '=');
+        if (c == '<') p->compare_op = or_equal ? OP_LE : OP_LT;
+        else p->compare_op = or_equal ? OP_GE : OP_GT;
+        p->tok = TOK_COMPARE;
+        p->pos += or_equal ? 2 : 1;
+    } else if (isdigit((unsigned char)c) || c == '.' ||
+               (c == '-' && (isdigit((unsigned char)s[p->pos + 1]) || s[p->pos + 1] == '.'))) {
+        char *end;
+        p->number = strtod(s + p->pos, &end);
+        p->pos = (int)(end - s);
+        p->tok = TOK_NUMBER;
+    } else if (isalpha((unsigned char)c) || c == '_') {
+        int len = 0;
+        while (isalnum((unsigned char)s[p->pos]) || s[p->pos] == '_') {
+            if (len < RULE_MAX_WORD - 1) p->word[len++] = (char)tolower((unsigned char)s[p->pos]);
+            p->pos++;
+        }
+        p->word[len] = '\0';
+        p->tok = TOK_WORD;
+    } else {
+        char detail[4] = { '\'', c, '\'', '\0' };
+        p->tok = TOK_ERROR;
+        rule_error(p, "Unexpected character ", detail);
+    }
+}
+
+static int is_word(RuleParser *p, const char *word) {
+    return p->tok == TOK_WORD && strcmp(p->word, word) == 0;
+}
+
+static int new_node(RuleParser *p, NodeKind kind) {
+    if (p->node_count >= RULE_MAX_NODES) {
+        rule_error(p, "Rule is too long", "");
+        return -1;
+    }
+    int idx = p->node_count++;
+    memset(&p->nodes[idx], 0, sizeof(RuleNode));
+    p->nodes[idx].kind = kind;
+    return idx;
+}
+
+static int make_bool(RuleParser *p, int value) {
+    int idx = new_node(p, NODE_BOOL);
+    if (idx >= 0) p->nodes[idx].value = value;
+    return idx;
+}
+
+// Node constructors fold constant sub-expressions as the tree is built, so
+// clauses that can never fire (e.g. "0 > 0 and ...") never reach the bytecode.
+static int make_compare(RuleParser *p, int op, RuleTerm left, RuleTerm right) {
+    if (left.kind == TERM_NUMBER && right.kind == TERM_NUMBER) {
+        int value = 0;
+        switch (op) {
+            case OP_LT: value = left.value < right.value; break;
+            case OP_LE: value = left.value <= right.value; break;
+            case OP_GT: value = left.value > right.value; break;
+            case OP_GE: value = left.value >= right.value; break;
+        }
+        return make_bool(p, value);
+    }
+    int idx = new_node(p, NODE_COMPARE);
+    if (idx >= 0) {
+        p->nodes[idx].value = op;
+        p->nodes[idx].left = left;
+        p->nodes[idx].right = right;
+    }
+    return idx;
+}
+
+static int make_cross(RuleParser *p, int above, RuleTerm left, RuleTerm right) {
+    if (left.kind == TERM_STATE || right.kind == TERM_STATE) {
+        rule_error(p, "Crossovers need price or indicator series", "");
+        return -1;
+    }
+    if (left.kind == TERM_NUMBER && right.kind == TERM_NUMBER) {
+        return make_bool(p, 0);
+    }
+    int idx = new_node(p, NODE_CROSS);
+    if (idx >= 0) {
+        p->nodes[idx].value = above;
+        p->nodes[idx].left = left;
+        p->nodes[idx].right = right;
+    }
+    return idx;
+}
+
+static int make_logic(RuleParser *p, NodeKind kind, int a, int b) {
+    if (a < 0 || b < 0) return -1;
+    RuleNode *na = &p->nodes[a];
+    RuleNode *nb = &p->nodes[b];
+    int absorbing = (kind == NODE_OR);
+
+    if (na->kind == NODE_BOOL) return (na->value == absorbing) ? a : b;
+    if (nb->kind == NODE_BOOL) return (nb->value == absorbing) ? b : a;
+
+    int idx = new_node(p, kind);
+    if (idx >= 0) {
+        p->nodes[idx].a = a;
+        p->nodes[idx].b = b;
+    }
+    return idx;
+}
+
+static int make_not(RuleParser *p, int a) {
+    if (a < 0) return -1;
+    if (p->nodes[a].kind == NODE_BOOL) return make_bool(p, !p->nodes[a].value);
+    int idx = new_node(p, NODE_NOT);
+    if (idx >= 0) p->nodes[idx].a = a;
+    return idx;
+}
+
+// Parses "(N)" after an indicator name
+static int parse_period(RuleParser *p, int *period) {
+    if (p->tok != TOK_LPAREN) {
+        rule_error(p, "Expected '(' after indicator", "");
+        return -1;
+    }
+    next_token(p);
+    if (p->tok != TOK_NUMBER || floor(p->number) != p->number) {
+        rule_error(p, "Indicator period must be a whole number", "");
+        return -1;
+    }
+    // Range-checked before the cast, which is undefined for huge values
+    if (p->number < 1 || p->number > MAX_DAYS - 1) {
+        rule_error(p, "Indicator period out of range", "");
+        return -1;
+    }
+    *period = (int)p->number;
+    next_token(p);
+    if (p->tok != TOK_RPAREN) {
+        rule_error(p, "Expected ')' after indicator period", "");
+        return -1;
+    }
+    next_token(p);
+    return 0;
+}
+
+static int parse_term(RuleParser *p, RuleTerm *term) {
+    memset(term, 0, sizeof(RuleTerm));
+
+    if (p->tok == TOK_NUMBER) {
+        term->kind = TERM_NUMBER;
+        term->value = p->number;
+        next_token(p);
+        return 0;
+    }
+    if (p->tok != TOK_WORD) {
+        rule_error(p, "Expected a value", "");
+        return -1;
+    }
+
+    if (is_word(p, "close")) {
+        term->kind = TERM_INDICATOR;
+        term->indicator.kind = IND_CLOSE;
+        next_token(p);
+        return 0;
+    }
+    if (is_word(p, "pnl_pct") || is_word(p, "held_days")) {
+        if (!p->is_exit) {
+            rule_error(p, "Position values are only available in exit rules: ", p->word);
+            return -1;
+        }
+        term->kind = TERM_STATE;
+        term->state = is_word(p, "pnl_pct") ? RULE_STATE_PNL_PCT : RULE_STATE_HELD_DAYS;
+        next_token(p);
+        return 0;
+    }
+    if (is_word(p, "sma") || is_word(p, "rsi")) {
+        term->kind = TERM_INDICATOR;
+        term->indicator.kind = is_word(p, "sma") ? IND_SMA : IND_RSI;
+        next_token(p);
+        return parse_period(p, &term->indicator.period);
+    }
+    if (is_word(p, "avg_corr")) {
+        if (p->is_exit) {
+            rule_error(p, "Correlation to the holdings is only available in entry rules: ", p->word);
+            return -1;
+        }
+        term->kind = TERM_STATE;
+        term->state = RULE_STATE_AVG_CORR;
+        next_token(p);
+        return parse_period(p, &term->indicator.period);
+    }
+
+    rule_error(p, "Unknown value: ", p->word);
+    return -1;
+}
+
+static int parse_or(RuleParser *p);
+
+static int parse_unary(RuleParser *p) {
+    if (is_word(p, "not")) {
+        next_token(p);
+        return make_not(p, parse_unary(p));
+    }
+    if (is_word(p, "true") || is_word(p, "false")) {
+        int value = is_word(p, "true");
+        next_token(p);
+        return make_bool(p, value);
+    }
+    if (p->tok == TOK_LPAREN) {
+        next_token(p);
+        int node = parse_or(p);
+        if (p->tok != TOK_RPAREN) {
+            rule_error(p, "Expected ')'", "");
+            return -1;
+        }
+        next_token(p);
+        return node;
+    }
+
+    RuleTerm left, right;
+    if (parse_term(p, &left) != 0) return -1;
+
+    if (p->tok == TOK_COMPARE) {
+        int op = p->compare_op;
+        next_token(p);
+        if (parse_term(p, &right) != 0) return -1;
+        return make_compare(p, op, left, right);
+    }
+    if (is_word(p, "crosses_above") || is_word(p, "crosses_below")) {
+        int above = is_word(p, "crosses_above");
+        next_token(p);
+        if (parse_term(p, &right) != 0) return -1;
+        return make_cross(p, above, left, right);
+    }
+
+    rule_error(p, "Expected a comparison (<, <=, >, >=, crosses_above, crosses_below)", "");
+    return -1;
+}
+
+static int parse_and(RuleParser *p) {
+    int node = parse_unary(p);
+    while (!p->failed && is_word(p, "and")) {
+        next_token(p);
+        node = make_logic(p, NODE_AND, node, parse_unary(p));
+    }
+    return node;
+}
+
+static int parse_or(RuleParser *p) {
+    int node = parse_and(p);
+    while (!p->failed && is_word(p, "or")) {
+        next_token(p);
+        node = make_logic(p, NODE_OR, node, parse_and(p));
+    }
+    return node;
+}
+
+typedef struct {
+    RuleParser *parser;
+    CompiledRules *rules;
+    RuleProgram *program;
+    int depth;
+} RuleEmitter;
+
+static void emit_byte(RuleEmitter *e, int byte) {
+    if (e->program->code_len >= RULE_MAX_CODE) {
+        rule_error(e->parser, "Rule is too long", "");
+        return;
+    }
+    e->program->code[e->program->code_len++] = (unsigned char)byte;
+}
+
+static void emit_push(RuleEmitter *e, int op, int operand) {
+    emit_byte(e, op);
+    emit_byte(e, operand);
+    if (++e->depth > RULE_STACK_SIZE) rule_error(e->parser, "Rule is nested too deeply", "");
+}
+
+static void emit_binary(RuleEmitter *e, int op) {
+    emit_byte(e, op);
+    e->depth--;
+}
+
+static int intern_indicator(RuleEmitter *e, const RuleIndicator *indicator) {
+    CompiledRules *rules = e->rules;
+
+    if (indicator->kind != IND_CLOSE && (indicator->period < 1 || indicator->period >= MAX_DAYS)) {
+        rule_error(e->parser, "Indicator period out of range", "");
+        return 0;
+    }
+    for (int i = 0; i < rules->indicator_count; i++) {
+        if (rules->indicators[i].kind == indicator->kind &&
+            (indicator->kind == IND_CLOSE || rules->indicators[i].period == indicator->period)) {
+            return i;
+        }
+    }
+    if (rules->indicator_count >= RULE_MAX_INDICATORS) {
+        rule_error(e->parser, "Too many different indicators", "");
+        return 0;
+    }
+    rules->indicators[rules->indicator_count] = *indicator;
+    return rules->indicator_count++;
+}
+
+static void emit_term(RuleEmitter *e, const RuleTerm *term, int previous) {
+    switch (term->kind) {
+        case TERM_NUMBER: {
+            RuleProgram *prog = e->program;
+            if (prog->const_count >= RULE_MAX_CONSTS) {
+                rule_error(e->parser, "Too many constants", "");
+                return;
+            }
+            prog->consts[prog->const_count] = term->value;
+            emit_push(e, OP_CONST, prog->const_count++);
+            break;
+        }
+        case TERM_INDICATOR:
+            emit_push(e, previous ? OP_LOAD_PREV : OP_LOAD, intern_indicator(e, &term->indicator));
+            break;
+        case TERM_STATE:
+            // The run keeps one rolling correlation window per strategy
+            if (term->state == RULE_STATE_AVG_CORR) {
+                int window = term->indicator.period;
+                if (window < 2 || window >= MAX_DAYS) {
+                    rule_error(e->parser, "Correlation window out of range", "");
+                    return;
+                }
+                if (e->rules->correlation_window != 0 && e->rules->correlation_window != window) {
+                    rule_error(e->parser, "Only one avg_corr window per strategy", "");
+                    return;
+                }
+                e->rules->correlation_window = window;
+            }
+            emit_push(e, OP_STATE, term->state);
+            break;
+    }
+}
+
+static void emit_node(RuleEmitter *e, int idx) {
+    if (e->parser->failed) return;
+    RuleNode *node = &e->parser->nodes[idx];
+
+    switch (node->kind) {
+        case NODE_BOOL: {
+            RuleTerm constant = { TERM_NUMBER, node->value, { IND_CLOSE, 0 }, 0 };
+            emit_term(e, &constant, 0);
+            break;
+        }
+        case NODE_COMPARE:
+            emit_term(e, &node->left, 0);
+            emit_term(e, &node->right, 0);
+            emit_binary(e, node->value);
+            break;
+        case NODE_CROSS:
+            // a crosses_above b  =>  a[-1] <= b[-1] and a > b
+            emit_term(e, &node->left, 1);
+            emit_term(e, &node->right, 1);
+            emit_binary(e, node->value ? OP_LE : OP_GE);
+            emit_term(e, &node->left, 0);
+            emit_term(e, &node->right, 0);
+            emit_binary(e, node->value ? OP_GT : OP_LT);
+            emit_binary(e, OP_AND);
+            break;
+        case NODE_AND:
+        case NODE_OR:
+            emit_node(e, node->a);
+            emit_node(e, node->b);
+            emit_binary(e, node->kind == NODE_AND ? OP_AND : OP_OR);
+            break;
+        case NODE_NOT:
+            emit_node(e, node->a);
+            emit_byte(e, OP_NOT);
+            break;
+    }
+}
+
+int compile_rule(const char *text, int is_exit, CompiledRules *rules,
+                 char *error, int error_size) {
+    RuleParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.text = text;
+    parser.is_exit = is_exit;
+    parser.error = error;
+    parser.error_size = error_size;
+
+    next_token(&parser);
+    int root = parse_or(&parser);
+    if (!parser.failed && parser.tok != TOK_END) {
+        rule_error(&parser, "Unexpected text after rule", "");
+    }
+    if (parser.failed || root < 0) return -1;
+
+    RuleProgram *program = is_exit ? &rules->exit : &rules->entry;
+    memset(program, 0, sizeof(RuleProgram));
+
+    RuleEmitter emitter = { &parser, rules, program, 0 };
+    emit_node(&emitter, root);
+    emit_byte(&emitter, OP_END);
+    if (parser.failed) return -1;
+
+    program->constant = (parser.nodes[root].kind == NODE_BOOL) ? parser.nodes[root].value : -1;
+    return 0;
+}
+
+int validate_rule(const char *text, int is_exit, char *error, int error_size) {
+    CompiledRules rules;
+    memset(&rules, 0, sizeof(rules));
+    return compile_rule(text, is_exit, &rules, error, error_size);
+}
+
+int compile_strategy_rules(const Strategy *strategy, CompiledRules *rules,
+                           char *error, int error_size) {
+    char legacy[256];
+    memset(rules, 0, sizeof(CompiledRules));
+
+    // Rules not written by the user are generated from the numeric parameters.
+    // Parameters that disable a clause fold it away during compilation.
+    if (strategy->entry_rule[0] != '\0') {
+        if (compile_rule(strategy->entry_rule, 0, rules, error, error_size) != 0) return -1;
+    } else {
+        snprintf(legacy, sizeof(legacy),
+                 "(%d > 0 and %d > 0 and sma(%d) crosses_above sma(%d)) or "
+                 "(%.17g > 0 and rsi(14) <= %.17g)",
+                 strategy->sma_short_period, strategy->sma_long_period,
+                 strategy->sma_short_period, strategy->sma_long_period,
+                 strategy->rsi_oversold, strategy->rsi_oversold);
+        if (compile_rule(legacy, 0, rules, error, error_size) != 0) return -1;
+    }
+
+    if (strategy->exit_rule[0] != '\0') {
+        if (compile_rule(strategy->exit_rule, 1, rules, error, error_size) != 0) return -1;
+    } else {
+        snprintf(legacy, sizeof(legacy), "%.17g < 100 and rsi(14) >= %.17g",
+                 strategy->rsi_overbought, strategy->rsi_overbought);
+        if (compile_rule(legacy, 1, rules, error, error_size) != 0) return -1;
+    }
+    return 0;
+}
+
+int evaluate_rule(const RuleProgram *program, const double *const columns[],
+                  int day, const double state[]) {
+    double stack[RULE_STACK_SIZE];
+    int top = 0;
+    const unsigned char *pc = program->code;
+
+    // Comparisons yield 0.0/1.0, so AND/OR/NOT are arithmetic rather than jumps.
+    for (;;) {
+        switch (*pc++) {
+            case OP_CONST:     stack[top++] = program->consts[*pc++]; break;
+            case OP_LOAD:      stack[top++] = columns[*pc++][day]; break;
+            case OP_LOAD_PREV: stack[top++] = columns[*pc++][day - 1]; break;
+            case OP_STATE:     stack[top++] = state[*pc++]; break;
+            case OP_LT:  top--; stack[top - 1] = stack[top - 1] <  stack[top]; break;
+            case OP_LE:  top--; stack[top - 1] = stack[top - 1] <= stack[top]; break;
+            case OP_GT:  top--; stack[top - 1] = stack[top - 1] >  stack[top]; break;
+            case OP_GE:  top--; stack[top - 1] = stack[top - 1] >= stack[top]; break;
+            case OP_AND: top--; stack[top - 1] = stack[top - 1] * stack[top]; break;
+            case OP_OR:  top--; stack[top - 1] = stack[top - 1] + stack[top] - stack[top - 1] * stack[top]; break;
+            case OP_NOT: stack[top - 1] = 1.0 - stack[top - 1]; break;
+            default:     return stack[0] != 0.0;
+        }
+    }
+}
+
+// Fills out[from_day, day_count). closes must be valid from
+// from_day - indicator_lookback() onwards.
+void compute_indicator_column(const RuleIndicator *indicator, const double closes[],
+                              int from_day, int day_count, double out[]) {
+    for (int d = from_day; d < day_count; d++) {
+        switch (indicator->kind) {
+            case IND_CLOSE: out[d] = closes[d]; break;
+            case IND_SMA:   out[d] = calculate_sma((double *)closes, d, indicator->period); break;
+            case IND_RSI:   out[d] = calculate_rsi((double *)closes, d, indicator->period); break;
+        }
+    }
+}
+
+// Number of bars before a day that its indicator value depends on
+int indicator_lookback(const RuleIndicator *indicator) {
+    return indicator->kind == IND_CLOSE ? 0 : indicator->period;
+}
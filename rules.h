@@ -0,0 +1,61 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include "structures.h"
+
+#define RULE_MAX_CODE 128
+#define RULE_MAX_CONSTS 32
+#define RULE_MAX_INDICATORS 8
+#define RULE_STACK_SIZE 16
+
+// Indicator series a rule can reference
+typedef enum {
+    IND_CLOSE,
+    IND_SMA,
+    IND_RSI
+} IndicatorKind;
+
+typedef struct {
+    IndicatorKind kind;
+    int period;
+} RuleIndicator;
+
+// Values a rule reads from the run rather than from indicator columns:
+// position values in exit rules, correlation to the holdings in entry rules
+enum {
+    RULE_STATE_PNL_PCT,
+    RULE_STATE_HELD_DAYS,
+    RULE_STATE_AVG_CORR,
+    RULE_STATE_COUNT
+};
+
+// Compiled bytecode for one rule
+typedef struct {
+    unsigned char code[RULE_MAX_CODE];
+    int code_len;
+    double consts[RULE_MAX_CONSTS];
+    int const_count;
+    int constant;           // -1 if the rule reads data, else its folded value (0/1)
+} RuleProgram;
+
+// Entry and exit programs sharing one indicator table
+typedef struct {
+    RuleIndicator indicators[RULE_MAX_INDICATORS];
+    int indicator_count;
+    int correlation_window;             // bars behind avg_corr(N), 0 if unused
+    RuleProgram entry;
+    RuleProgram exit;
+} CompiledRules;
+
+int compile_rule(const char *text, int is_exit, CompiledRules *rules,
+                 char *error, int error_size);
+int compile_strategy_rules(const Strategy *strategy, CompiledRules *rules,
+                           char *error, int error_size);
+int validate_rule(const char *text, int is_exit, char *error, int error_size);
+int evaluate_rule(const RuleProgram *program, const double *const columns[],
+                  int day, const double state[]);
+void compute_indicator_column(const RuleIndicator *indicator, const double closes[],
+                              int from_day, int day_count, double out[]);
+int indicator_lookback(const RuleIndicator *indicator);
+
+#endif
@@ -0,0 +1,377 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "scheduler.h"
+
+typedef struct {
+    SchedulerTaskFn run;
+    void *context;
+    int remaining;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} TaskBatch;
+
+struct SchedulerTask {
+    TaskBatch *batch;
+    int task;
+};
+
+static long long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// With base NULL the arena allocates and grows its own block
+void arena_init(WorkerArena *arena, void *base, size_t size) {
+    memset(arena, 0, sizeof(WorkerArena));
+    arena->base = base;
+    arena->size = base != NULL ? size : 0;
+    arena->owns_base = base == NULL;
+}
+
+void *arena_alloc(WorkerArena *arena, size_t size) {
+    size = align_up(size > 0 ? size : 1);
+    arena->requested += size;
+    if (arena->requested > arena->high_water) arena->high_water = arena->requested;
+
+    if (arena->used + size <= arena->size) {
+        void *pointer = arena->base + arena->used;
+        arena->used += size;
+        return pointer;
+    }
+    void *block;
+    if (posix_memalign(&block, ARENA_ALIGN, ARENA_ALIGN + size) != 0) return NULL;
+    ((ArenaBlock *)block)->next = arena->overflow;
+    arena->overflow = block;
+    return (char *)block + ARENA_ALIGN;
+}
+
+// Frees everything handed out since the last reset
+void arena_reset(WorkerArena *arena) {
+    while (arena->overflow != NULL) {
+        ArenaBlock *next = arena->overflow->next;
+        free(arena->overflow);
+        arena->overflow = next;
+    }
+    if (arena->owns_base && arena->high_water > arena->size) {
+        void *grown;
+        free(arena->base);
+        arena->base = NULL;
+        arena->size = 0;
+        if (posix_memalign(&grown, ARENA_ALIGN, arena->high_water) == 0) {
+            arena->base = grown;
+            arena->size = arena->high_water;
+        }
+    }
+    arena->used = 0;
+    arena->requested = 0;
+}
+
+void arena_free(WorkerArena *arena) {
+    arena_reset(arena);
+    if (arena->owns_base) free(arena->base);
+    memset(arena, 0, sizeof(WorkerArena));
+}
+
+// Parses a sysfs CPU list such as "0-3,8-11"
+static int parse_cpu_list(const char *text, cpu_set_t *set) {
+    int count = 0;
+    CPU_ZERO(set);
+    while (*text != '\0' && *text != '\n') {
+        char *end;
+        long first = strtol(text, &end, 10), last = first;
+        if (end == text) return -1;
+        if (*end == '-') {
+            text = end + 1;
+            last = strtol(text, &end, 10);
+            if (end == text) return -1;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET((int)cpu, set);
+            count++;
+        }
+        text = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+// Pinning is best effort: a worker that cannot be pinned runs unpinned
+static void pin_worker(SchedulerWorker *worker, SchedulerPinning pinning) {
+    cpu_set_t allowed, set;
+    if (pinning == SCHEDULER_PIN_NONE || sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+
+    if (pinning == SCHEDULER_PIN_NODE) {
+        cpu_set_t nodes[64];
+        int node_ids[64], node_count = 0;
+        for (int node = 0; node < 64; node++) {
+            char path[64], line[1024];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            FILE *fp = fopen(path, "r");
+            if (fp == NULL) continue;
+            if (fgets(line, sizeof(line), fp) != NULL && parse_cpu_list(line, &nodes[node_count]) > 0) {
+                node_ids[node_count++] = node;
+            }
+            fclose(fp);
+        }
+        if (node_count > 0) {
+            int pick = worker->index % node_count;
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &nodes[pick]) == 0) {
+                __atomic_store_n(&worker->stats.node, node_ids[pick], __ATOMIC_RELAXED);
+            }
+            return;
+        }
+        // No NUMA information: fall back to one CPU per worker
+    }
+
+    int online = CPU_COUNT(&allowed), skip = worker->index % (online > 0 ? online : 1);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || skip-- > 0) continue;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+            __atomic_store_n(&worker->stats.cpu, cpu, __ATOMIC_RELAXED);
+        }
+        return;
+    }
+}
+
+// The owner takes from the back of its deque. Thieves take from the front,
+// where a worker's share of a batch starts with its oldest and costliest
+// tasks, so one steal moves as much work as possible.
+static int take_task(SchedulerWorker *worker, struct SchedulerTask *task, int *stolen) {
+    Scheduler *scheduler = worker->scheduler;
+    int n = scheduler->worker_count;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->count > 0) {
+        worker->count--;
+        *task = worker->tasks[(worker->head + worker->count) % worker->capacity];
+        pthread_mutex_unlock(&worker->lock);
+        *stolen = 0;
+        return 1;
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    worker->seed = worker->seed * 1103515245u + 12345u;
+    int start = n > 1 ? (int)((worker->seed >> 16) % (unsigned int)(n - 1)) : 0;
+    for (int k = 0; k < n - 1; k++) {
+        SchedulerWorker *victim = &scheduler->workers[(worker->index + 1 + (start + k) % (n - 1)) % n];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->count > 0) {
+            *task = victim->tasks[victim->head];
+            victim->head = (victim->head + 1) % victim->capacity;
+            victim->count--;
+            pthread_mutex_unlock(&victim->lock);
+            *stolen = 1;
+            return 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return 0;
+}
+
+static void run_task(SchedulerWorker *worker, const struct SchedulerTask *task, int stolen) {
+    TaskBatch *batch = task->batch;
+    long long started = now_ns();
+
+    batch->run(batch->context, task->task, worker->index, &worker->arena);
+    arena_reset(&worker->arena);
+
+    __atomic_add_fetch(&worker->stats.busy_ns, now_ns() - started, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&worker->stats.tasks, 1, __ATOMIC_RELAXED);
+    if (stolen) __atomic_add_fetch(&worker->stats.steals, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->stats.arena_bytes, worker->arena.size, __ATOMIC_RELAXED);
+
+    // The submitter may free the batch as soon as the lock is released
+    pthread_mutex_lock(&batch->lock);
+    if (--batch->remaining == 0) pthread_cond_signal(&batch->done);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+static void *worker_main(void *arg) {
+    SchedulerWorker *worker = (SchedulerWorker *)arg;
+    Scheduler *scheduler = worker->scheduler;
+    struct SchedulerTask task;
+    int stolen;
+
+    pin_worker(worker, scheduler->pinning);
+    for (;;) {
+        if (take_task(worker, &task, &stolen)) {
+            __atomic_sub_fetch(&scheduler->queued, 1, __ATOMIC_ACQ_REL);
+            run_task(worker, &task, stolen);
+            continue;
+        }
+        pthread_mutex_lock(&scheduler->lock);
+        while (!scheduler->shutdown && __atomic_load_n(&scheduler->queued, __ATOMIC_ACQUIRE) <= 0) {
+            pthread_cond_wait(&scheduler->wake, &scheduler->lock);
+        }
+        int stop = scheduler->shutdown && __atomic_load_n(&scheduler->queued, __ATOMIC_ACQUIRE) <= 0;
+        pthread_mutex_unlock(&scheduler->lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+// threads <= 0 uses one per CPU. Returns -1 if no worker could be started.
+int scheduler_init(Scheduler *scheduler, const SchedulerOptions *options) {
+    int threads = options != NULL ? options->threads : 0;
+    SchedulerPinning pinning = options != NULL ? options->pinning : SCHEDULER_PIN_NONE;
+
+    memset(scheduler, 0, sizeof(Scheduler));
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > SCHEDULER_MAX_WORKERS) threads = SCHEDULER_MAX_WORKERS;
+
+    scheduler->workers = calloc((size_t)threads, sizeof(SchedulerWorker));
+    if (scheduler->workers == NULL) return -1;
+    scheduler->worker_count = threads;
+    scheduler->pinning = pinning;
+    scheduler->started_ns = now_ns();
+    pthread_mutex_init(&scheduler->lock, NULL);
+    pthread_cond_init(&scheduler->wake, NULL);
+    for (int w = 0; w < threads; w++) {
+        SchedulerWorker *worker = &scheduler->workers[w];
+        worker->scheduler = scheduler;
+        worker->index = w;
+        worker->seed = 2654435761u * (unsigned int)(w + 1);
+        pthread_mutex_init(&worker->lock, NULL);
+        arena_init(&worker->arena, NULL, 0);
+        worker->stats.cpu = worker->stats.node = -1;
+    }
+
+    // Tasks dealt to a worker that failed to start are stolen by the others
+    int started = 0;
+    for (int w = 0; w < threads; w++) {
+        SchedulerWorker *worker = &scheduler->workers[w];
+        worker->started = pthread_create(&worker->thread, NULL, worker_main, worker) == 0;
+        started += worker->started;
+    }
+    if (started == 0) {
+        scheduler_free(scheduler);
+        return -1;
+    }
+    return 0;
+}
+
+// Lets queued tasks finish, then stops the workers
+void scheduler_free(Scheduler *scheduler) {
+    if (scheduler->workers == NULL) return;
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->shutdown = 1;
+    pthread_cond_broadcast(&scheduler->wake);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    // Workers steal from each other until they exit, so every one is
+    // joined before any deque goes away
+    for (int w = 0; w < scheduler->worker_count; w++) {
+        if (scheduler->workers[w].started) pthread_join(scheduler->workers[w].thread, NULL);
+    }
+    for (int w = 0; w < scheduler->worker_count; w++) {
+        SchedulerWorker *worker = &scheduler->workers[w];
+        pthread_mutex_destroy(&worker->lock);
+        arena_free(&worker->arena);
+        free(worker->tasks);
+    }
+    pthread_mutex_destroy(&scheduler->lock);
+    pthread_cond_destroy(&scheduler->wake);
+    free(scheduler->workers);
+    memset(scheduler, 0, sizeof(Scheduler));
+}
+
+static int push_task(SchedulerWorker *worker, const struct SchedulerTask *task) {
+    pthread_mutex_lock(&worker->lock);
+    if (worker->count == worker->capacity) {
+        int capacity = worker->capacity > 0 ? worker->capacity * 2 : 64;
+        struct SchedulerTask *grown = malloc(sizeof(struct SchedulerTask) * (size_t)capacity);
+        if (grown == NULL) {
+            pthread_mutex_unlock(&worker->lock);
+            return -1;
+        }
+        for (int i = 0; i < worker->count; i++) {
+            grown[i] = worker->tasks[(worker->head + i) % worker->capacity];
+        }
+        free(worker->tasks);
+        worker->tasks = grown;
+        worker->capacity = capacity;
+        worker->head = 0;
+    }
+    worker->tasks[(worker->head + worker->count) % worker->capacity] = *task;
+    worker->count++;
+    pthread_mutex_unlock(&worker->lock);
+    return 0;
+}
+
+// Runs tasks [0, task_count) and returns once all have finished. Tasks are
+// dealt round-robin in index order, so the lowest indices sit at the front
+// of each deque, where idle workers steal first: give them to the costliest
+// tasks. Tasks that cannot be queued run on the calling thread.
+int scheduler_run(Scheduler *scheduler, int task_count, SchedulerTaskFn run, void *context) {
+    TaskBatch batch;
+    int queued = 0;
+
+    if (task_count <= 0) return 0;
+    batch.run = run;
+    batch.context = context;
+    batch.remaining = task_count;
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.done, NULL);
+
+    pthread_mutex_lock(&scheduler->lock);
+    int first = scheduler->next_worker;
+    scheduler->next_worker = (first + task_count) % scheduler->worker_count;
+    pthread_mutex_unlock(&scheduler->lock);
+
+    for (; queued < task_count; queued++) {
+        struct SchedulerTask task = { &batch, queued };
+        if (push_task(&scheduler->workers[(first + queued) % scheduler->worker_count], &task) != 0) break;
+    }
+    __atomic_add_fetch(&scheduler->queued, queued, __ATOMIC_ACQ_REL);
+    pthread_mutex_lock(&scheduler->lock);
+    pthread_cond_broadcast(&scheduler->wake);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    if (queued < task_count) {
+        WorkerArena arena;
+        arena_init(&arena, NULL, 0);
+        for (int t = queued; t < task_count; t++) {
+            run(context, t, scheduler->worker_count, &arena);
+            arena_reset(&arena);
+        }
+        arena_free(&arena);
+        pthread_mutex_lock(&batch.lock);
+        batch.remaining -= task_count - queued;
+        pthread_mutex_unlock(&batch.lock);
+    }
+
+    pthread_mutex_lock(&batch.lock);
+    while (batch.remaining > 0) pthread_cond_wait(&batch.done, &batch.lock);
+    pthread_mutex_unlock(&batch.lock);
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.done);
+    return 0;
+}
+
+// One entry per worker; uptime is the time since scheduler_init, so each
+// worker's utilization is busy_ns / uptime
+void scheduler_stats(Scheduler *scheduler, WorkerStats stats[], long long *uptime_ns) {
+    for (int w = 0; w < scheduler->worker_count; w++) {
+        WorkerStats *source = &scheduler->workers[w].stats;
+        stats[w].cpu = __atomic_load_n(&source->cpu, __ATOMIC_RELAXED);
+        stats[w].node = __atomic_load_n(&source->node, __ATOMIC_RELAXED);
+        stats[w].tasks = __atomic_load_n(&source->tasks, __ATOMIC_RELAXED);
+        stats[w].steals = __atomic_load_n(&source->steals, __ATOMIC_RELAXED);
+        stats[w].busy_ns = __atomic_load_n(&source->busy_ns, __ATOMIC_RELAXED);
+        stats[w].arena_bytes = __atomic_load_n(&source->arena_bytes, __ATOMIC_RELAXED);
+    }
+    if (uptime_ns != NULL) *uptime_ns = now_ns() - scheduler->started_ns;
+}
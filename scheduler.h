@@ -0,0 +1,97 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Shared pool of worker threads for batches of independent tasks of very
+// different cost. Each worker has its own deque of tasks: it takes from the
+// back of its own, and when that is empty steals from the front of
+// another's, where the oldest and largest tasks are. Any number of threads may submit batches at once; each
+// submitter sleeps until its own batch is done. Every worker also owns a
+// bump arena for task scratch, reset after each task, so scratch memory is
+// reused instead of going through malloc.
+#define SCHEDULER_MAX_WORKERS 256
+#define ARENA_ALIGN 64                  // a cache line, so workers never share one
+
+typedef enum {
+    SCHEDULER_PIN_NONE,
+    SCHEDULER_PIN_CPU,                  // worker w on the w-th online CPU
+    SCHEDULER_PIN_NODE                  // worker w on the CPUs of NUMA node w % nodes
+} SchedulerPinning;
+
+typedef struct {
+    int threads;                        // <= 0: one per CPU
+    SchedulerPinning pinning;
+} SchedulerOptions;
+
+// Bump allocator. Allocations beyond the current block get blocks of their
+// own until the next reset, which then grows the main block to the high
+// water mark, so a worker settles on one block sized for its largest task.
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+} ArenaBlock;
+
+typedef struct {
+    char *base;
+    size_t size;
+    size_t used;
+    int owns_base;                      // 0: a caller's block, never regrown
+    ArenaBlock *overflow;
+    size_t requested;                   // since the last reset
+    size_t high_water;
+} WorkerArena;
+
+// Runs task index of a batch on worker 0..worker_count-1, or worker_count
+// for the submitting thread, so tasks can keep per-worker state. The
+// arena is reset once it returns.
+typedef void (*SchedulerTaskFn)(void *context, int task, int worker, WorkerArena *arena);
+
+typedef struct {
+    int cpu;                            // pinned CPU, or -1
+    int node;                           // pinned NUMA node, or -1
+    long long tasks;
+    long long steals;                   // tasks taken from another worker
+    long long busy_ns;                  // time spent running tasks
+    size_t arena_bytes;
+} WorkerStats;
+
+struct Scheduler;
+
+typedef struct {
+    struct Scheduler *scheduler;
+    int index;
+    pthread_t thread;
+    int started;
+    unsigned int seed;                  // picks steal victims
+    pthread_mutex_t lock;               // guards the deque
+    struct SchedulerTask *tasks;        // ring buffer
+    int capacity;
+    int head;
+    int count;
+    WorkerArena arena;
+    WorkerStats stats;                  // updated atomically by the worker
+} SchedulerWorker;
+
+typedef struct Scheduler {
+    SchedulerWorker *workers;
+    int worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int queued;                         // tasks in all deques
+    int next_worker;                    // where the next batch starts dealing
+    int shutdown;
+    SchedulerPinning pinning;
+    long long started_ns;
+} Scheduler;
+
+int scheduler_init(Scheduler *scheduler, const SchedulerOptions *options);
+void scheduler_free(Scheduler *scheduler);
+int scheduler_run(Scheduler *scheduler, int task_count, SchedulerTaskFn run, void *context);
+void scheduler_stats(Scheduler *scheduler, WorkerStats stats[], long long *uptime_ns);
+void arena_init(WorkerArena *arena, void *base, size_t size);
+void *arena_alloc(WorkerArena *arena, size_t size);
+void arena_reset(WorkerArena *arena);
+void arena_free(WorkerArena *arena);
+
+#endif
@@ -1,102 +1,149 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include "stock_data.h"
+#include "feed_ingest.h"
+#include "symbols.h"
 #include "structures.h"
 
-void create_sample_csv() {
-    FILE *fp = fopen("stock_data.csv", "w");
-    if (fp == NULL) {
-        printf("Error creating CSV file!\n");
-        return;
+// Appends one row, starting a new stock whenever the symbol changes.
+// Rows beyond MAX_STOCKS / MAX_DAYS, or without a symbol id, are dropped.
+void append_price_row(Stock stocks[], int *stock_idx, int symbol_id, const PriceData *data) {
+    if (symbol_id < 0) return;
+    if (*stock_idx < 0 || stocks[*stock_idx].symbol_id != symbol_id) {
+        if (*stock_idx + 1 >= MAX_STOCKS) return;
+        (*stock_idx)++;
+        stocks[*stock_idx].symbol_id = symbol_id;
+        stocks[*stock_idx].day_count = 0;
     }
 
-    fprintf(fp, "Symbol,Date,Open,High,Low,Close,Volume\n");
-
-    srand(time(NULL));
-
-    // Stock 1: TECH_A
-    double tech_a_base = 100.0;
-    for (int i = 0; i < 50; i++) {
-        double change = (rand() % 600 - 300) / 100.0;
-        tech_a_base += change;
-        double open = tech_a_base;
-        double close = tech_a_base + (rand() % 400 - 200) / 100.0;
-        double high = (open > close ? open : close) + (rand() % 200) / 100.0;
-        double low = (open < close ? open : close) - (rand() % 200) / 100.0;
-        int volume = 100000 + (rand() % 50000);
-        fprintf(fp, "TECH_A,2024-01-%02d,%.2f,%.2f,%.2f,%.2f,%d\n", 
-                i + 1, open, high, low, close, volume);
-    }
+    Stock *stock = &stocks[*stock_idx];
+    if (stock->day_count >= MAX_DAYS) return;
 
-    // Stock 2: FINANCE_B
-    double fin_b_base = 150.0;
-    for (int i = 0; i < 50; i++) {
-        double change = (rand() % 800 - 400) / 100.0;
-        fin_b_base += change;
-        double open = fin_b_base;
-        double close = fin_b_base + (rand() % 500 - 250) / 100.0;
-        double high = (open > close ? open : close) + (rand() % 250) / 100.0;
-        double low = (open < close ? open : close) - (rand() % 250) / 100.0;
-        int volume = 80000 + (rand() % 40000);
-        fprintf(fp, "FINANCE_B,2024-01-%02d,%.2f,%.2f,%.2f,%.2f,%d\n", 
-                i + 1, open, high, low, close, volume);
-    }
+    PriceData *row = &stock->prices[stock->day_count++];
+    row->symbol_id = symbol_id;
+    strcpy(row->date, data->date);
+    row->open = data->open;
+    row->high = data->high;
+    row->low = data->low;
+    row->close = data->close;
+    row->volume = data->volume;
+}
 
-    // Stock 3: ENERGY_C
-    double energy_c_base = 75.0;
-    for (int i = 0; i < 50; i++) {
-        double change = (rand() % 500 - 250) / 100.0;
-        energy_c_base += change;
-        double open = energy_c_base;
-        double close = energy_c_base + (rand() % 300 - 150) / 100.0;
-        double high = (open > close ? open : close) + (rand() % 150) / 100.0;
-        double low = (open < close ? open : close) - (rand() % 150) / 100.0;
-        int volume = 120000 + (rand() % 60000);
-        fprintf(fp, "ENERGY_C,2024-01-%02d,%.2f,%.2f,%.2f,%.2f,%d\n", 
-                i + 1, open, high, low, close, volume);
+// Parses "Symbol,Date,Open,High,Low,Close,Volume" rows after the header, in
+// any order: rows are grouped by symbol and each symbol's bars sorted by
+// date. Malformed rows are skipped. Only the first MAX_STOCKS symbols and
+// each one's most recent MAX_DAYS bars fit; if dropped is not NULL it
+// receives what was left out. Returns -1 if memory runs out.
+int read_stock_csv(FILE *fp, Stock stocks[], int *stock_count, DroppedData *dropped) {
+    FeedTable table;
+
+    *stock_count = 0;
+    if (feed_read_csv(fp, 0, &table) != 0) return -1;
+    feed_table_stocks(&table, stocks, stock_count);
+    if (dropped != NULL) {
+        dropped->symbols = table.dropped_symbols;
+        dropped->bars = table.dropped_bars;
     }
+    feed_table_free(&table);
+    return 0;
+}
 
-    fclose(fp);
+// Copies one on-disk record into a bar and returns the symbol it names
+const char *unpack_stock_record(StockRecord *record, PriceData *data) {
+    record->symbol[MAX_STOCK_NAME - 1] = '\0';
+    record->date[MAX_DATE - 1] = '\0';
+    memcpy(data->date, record->date, MAX_DATE);
+    data->open = record->open;
+    data->high = record->high;
+    data->low = record->low;
+    data->close = record->close;
+    data->volume = record->volume;
+    return record->symbol;
 }
 
-void load_stock_data(Stock stocks[], int *stock_count) {
-    FILE *fp = fopen("stock_data.csv", "r");
-    if (fp == NULL) {
-        printf("Error opening CSV file!\n");
-        return;
+// Reads a binary data file from its header on. Returns -1 if the header
+// is not a compatible one.
+int read_stock_binary(FILE *fp, Stock stocks[], int *stock_count) {
+    StockFileHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, STOCK_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.record_size != (int)sizeof(StockRecord)) {
+        return -1;
     }
 
-    char line[256];
-    fgets(line, sizeof(line), fp);
-
-    char current_symbol[MAX_STOCK_NAME] = "";
+    StockRecord rows[256];
     int stock_idx = -1;
+    long long remaining = header.record_count;
+
+    while (remaining > 0) {
+        size_t want = remaining < 256 ? (size_t)remaining : 256;
+        size_t got = fread(rows, sizeof(StockRecord), want, fp);
+        if (got == 0) break;
+        for (size_t i = 0; i < got; i++) {
+            PriceData data;
+            const char *symbol = unpack_stock_record(&rows[i], &data);
+            append_price_row(stocks, &stock_idx, symbol_intern(symbol), &data);
+        }
+        remaining -= (long long)got;
+    }
+
+    *stock_count = stock_idx + 1;
+    return 0;
+}
 
-    while (fgets(line, sizeof(line), fp)) {
-        char symbol[MAX_STOCK_NAME];
-        PriceData data;
+// Days since 1970-01-01 for a proleptic Gregorian date
+long long days_from_civil(int year, int month, int day) {
+    long long y = year - (month <= 2);
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    long long yoe = y - era * 400;
+    long long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
 
-        sscanf(line, "%[^,],%[^,],%lf,%lf,%lf,%lf,%d",
-               symbol, data.date, &data.open, &data.high, &data.low, &data.close, &data.volume);
+void civil_from_days(long long days, int *year, int *month, int *day) {
+    long long z = days + 719468;
+    long long era = (z >= 0 ? z : z - 146096) / 146097;
+    long long doe = z - era * 146097;
+    long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long long mp = (5 * doy + 2) / 153;
+    *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(yoe + era * 400 + (*month <= 2));
+}
 
-        if (strcmp(current_symbol, symbol) != 0) {
-            stock_idx++;
-            strcpy(stocks[stock_idx].symbol, symbol);
-            strcpy(current_symbol, symbol);
-            stocks[stock_idx].day_count = 0;
-        }
+// "YYYY-MM-DD" or "YYYY-MM-DD HH:MM" to minutes since epoch
+int date_to_minutes(const char *date, long long *minutes, int *has_time) {
+    int year, month, day, hour = 0, minute = 0;
+    int fields = sscanf(date, "%d-%d-%d %d:%d", &year, &month, &day, &hour, &minute);
+    if (fields != 3 && fields != 5) return -1;
+    *minutes = days_from_civil(year, month, day) * 1440 + hour * 60 + minute;
+    if (has_time != NULL) *has_time = fields == 5;
+    return 0;
+}
+
+// FNV-1a over the first day_count bars; changes if any of them is restated
+unsigned long long stock_fingerprint(const Stock *stock, int day_count) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int d = 0; d < day_count; d++) {
+        const PriceData *row = &stock->prices[d];
+        const double values[4] = { row->open, row->high, row->low, row->close };
+        const unsigned char *bytes = (const unsigned char *)values;
 
-        strcpy(stocks[stock_idx].prices[stocks[stock_idx].day_count].date, data.date);
-        stocks[stock_idx].prices[stocks[stock_idx].day_count].open = data.open;
-        stocks[stock_idx].prices[stocks[stock_idx].day_count].high = data.high;
-        stocks[stock_idx].prices[stocks[stock_idx].day_count].low = data.low;
-        stocks[stock_idx].prices[stocks[stock_idx].day_count].close = data.close;
-        stocks[stock_idx].prices[stocks[stock_idx].day_count].volume = data.volume;
-        stocks[stock_idx].day_count++;
+        for (size_t i = 0; i < sizeof(values); i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        for (const char *c = row->date; *c != '\0'; c++) hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+        hash = (hash ^ (unsigned int)row->volume) * 1099511628211ULL;
     }
+    return hash;
+}
 
-    *stock_count = stock_idx + 1;
-    fclose(fp);
+// The engine reads every stock at the same bar index, so all of them must
+// hold the same number of bars
+int stocks_aligned(const Stock stocks[], int stock_count) {
+    for (int s = 1; s < stock_count; s++) {
+        if (stocks[s].day_count != stocks[0].day_count) return 0;
+    }
+    return 1;
 }
\ No newline at end of file
@@ -1,9 +1,45 @@
 #ifndef STOCK_DATA_H
 #define STOCK_DATA_H
 
+#include <stdio.h>
 #include "structures.h"
 
-void create_sample_csv();
-void load_stock_data(Stock stocks[], int *stock_count);
+// Binary market data file: this header followed by StockRecords grouped by
+// symbol, each symbol's rows in date order
+#define STOCK_BINARY_MAGIC "BTSTOCK1"
+
+typedef struct {
+    char magic[8];
+    int record_size;
+    int reserved;
+    long long record_count;
+} StockFileHeader;
+
+// One bar on disk, symbol spelled out since ids only last for the process
+typedef struct {
+    char symbol[MAX_STOCK_NAME];
+    char date[MAX_DATE];
+    double open;
+    double high;
+    double low;
+    double close;
+    int volume;
+} StockRecord;
+
+// What a CSV load left out to fit MAX_STOCKS symbols of MAX_DAYS bars
+typedef struct {
+    int symbols;            // past the first MAX_STOCKS
+    long long bars;         // theirs, and bars before a symbol's most recent MAX_DAYS
+} DroppedData;
+
+int read_stock_csv(FILE *fp, Stock stocks[], int *stock_count, DroppedData *dropped);
+int read_stock_binary(FILE *fp, Stock stocks[], int *stock_count);
+const char *unpack_stock_record(StockRecord *record, PriceData *data);
+void append_price_row(Stock stocks[], int *stock_idx, int symbol_id, const PriceData *data);
+int date_to_minutes(const char *date, long long *minutes, int *has_time);
+long long days_from_civil(int year, int month, int day);
+void civil_from_days(long long days, int *year, int *month, int *day);
+unsigned long long stock_fingerprint(const Stock *stock, int day_count);
+int stocks_aligned(const Stock stocks[], int stock_count);
 
 #endif
\ No newline at end of file
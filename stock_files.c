@@ -0,0 +1,118 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "stock_files.h"
+#include "stock_data.h"
+#include "symbols.h"
+#include "structures.h"
+
+static void warn_dropped(const DroppedData *dropped) {
+    if (dropped->symbols == 0 && dropped->bars == 0) return;
+    printf("Warning: stock_data.csv exceeds %d symbols x %d bars; dropped %d symbols and %lld bars, "
+           "keeping each symbol's most recent bars!\n", MAX_STOCKS, MAX_DAYS, dropped->symbols, dropped->bars);
+}
+
+static void read_csv_file(Stock stocks[], int *stock_count, DroppedData *dropped) {
+    FILE *fp = fopen("stock_data.csv", "r");
+    dropped->symbols = 0;
+    dropped->bars = 0;
+    if (fp == NULL) {
+        printf("Error opening CSV file!\n");
+        return;
+    }
+    if (read_stock_csv(fp, stocks, stock_count, dropped) != 0) printf("Error allocating memory for the CSV file!\n");
+    fclose(fp);
+    warn_dropped(dropped);
+}
+
+void load_stock_data(Stock stocks[], int *stock_count) {
+    DroppedData dropped;
+    read_csv_file(stocks, stock_count, &dropped);
+}
+
+static int snapshot_identity(StockSnapshotHeader *header) {
+    struct stat info;
+    if (stat("stock_data.csv", &info) != 0) return -1;
+
+    memset(header, 0, sizeof(StockSnapshotHeader));
+    memcpy(header->magic, STOCK_SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->record_size = (int)sizeof(PriceData);
+    header->source_size = (long long)info.st_size;
+    header->source_mtime_ns = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+    return 0;
+}
+
+static int read_stock_snapshot(const StockSnapshotHeader *expected, Stock stocks[], int *stock_count) {
+    StockSnapshotHeader stored;
+    FILE *fp = fopen(STOCK_SNAPSHOT_PATH, "rb");
+    if (fp == NULL) return -1;
+
+    int ok = fread(&stored, sizeof(stored), 1, fp) == 1 &&
+             memcmp(stored.magic, expected->magic, sizeof(stored.magic)) == 0 &&
+             stored.record_size == expected->record_size &&
+             stored.source_size == expected->source_size &&
+             stored.source_mtime_ns == expected->source_mtime_ns &&
+             stored.stock_count >= 0 && stored.stock_count <= MAX_STOCKS;
+    for (int s = 0; ok && s < stored.stock_count; s++) {
+        char symbol[MAX_STOCK_NAME];
+        ok = fread(symbol, sizeof(symbol), 1, fp) == 1 &&
+             fread(&stocks[s].day_count, sizeof(int), 1, fp) == 1 &&
+             stocks[s].day_count >= 0 && stocks[s].day_count <= MAX_DAYS &&
+             fread(stocks[s].prices, sizeof(PriceData), (size_t)stocks[s].day_count, fp) ==
+                 (size_t)stocks[s].day_count;
+        if (ok) {
+            symbol[MAX_STOCK_NAME - 1] = '\0';
+            stocks[s].symbol_id = symbol_intern(symbol);
+            ok = stocks[s].symbol_id >= 0;
+            for (int d = 0; ok && d < stocks[s].day_count; d++) stocks[s].prices[d].symbol_id = stocks[s].symbol_id;
+        }
+    }
+    fclose(fp);
+    if (!ok) return -1;
+    *stock_count = stored.stock_count;
+    DroppedData dropped = { stored.dropped_symbols, stored.dropped_bars };
+    warn_dropped(&dropped);
+    return 0;
+}
+
+static void write_stock_snapshot(StockSnapshotHeader *header, Stock stocks[], int stock_count) {
+    FILE *fp = fopen(STOCK_SNAPSHOT_PATH, "wb");
+    if (fp == NULL) return;
+
+    header->stock_count = stock_count;
+    int ok = fwrite(header, sizeof(StockSnapshotHeader), 1, fp) == 1;
+    for (int s = 0; ok && s < stock_count; s++) {
+        char symbol[MAX_STOCK_NAME];
+        memset(symbol, 0, sizeof(symbol));
+        strcpy(symbol, symbol_name(stocks[s].symbol_id));
+        ok = fwrite(symbol, sizeof(symbol), 1, fp) == 1 &&
+             fwrite(&stocks[s].day_count, sizeof(int), 1, fp) == 1 &&
+             fwrite(stocks[s].prices, sizeof(PriceData), (size_t)stocks[s].day_count, fp) ==
+                 (size_t)stocks[s].day_count;
+    }
+    // A read-only location just means the CSV is parsed again next time
+    if (fclose(fp) != 0 || !ok) remove(STOCK_SNAPSHOT_PATH);
+}
+
+// Loads stock_data.csv from its snapshot when the CSV is unchanged, and
+// otherwise parses it and refreshes the snapshot. Returns 1 if the snapshot
+// was used.
+int load_stock_data_cached(Stock stocks[], int *stock_count) {
+    StockSnapshotHeader header;
+
+    *stock_count = 0;
+    if (snapshot_identity(&header) != 0) {
+        printf("Error opening CSV file!\n");
+        return 0;
+    }
+    if (read_stock_snapshot(&header, stocks, stock_count) == 0) return 1;
+
+    // The snapshot keeps the counts so a cached load still warns
+    DroppedData dropped;
+    read_csv_file(stocks, stock_count, &dropped);
+    header.dropped_symbols = dropped.symbols;
+    header.dropped_bars = dropped.bars;
+    write_stock_snapshot(&header, stocks, *stock_count);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef STOCK_FILES_H
+#define STOCK_FILES_H
+
+#include "structures.h"
+
+// The app's data files, loaded with error messages on stdout. The library
+// itself only parses open streams (stock_data.h).
+
+// Sidecar written next to stock_data.csv after it is parsed: the loaded
+// stocks as raw records, valid while the CSV's size and mtime are unchanged.
+// Each stock's symbol is stored by name, and what the CSV load dropped is
+// kept so a cached load can warn about it too.
+#define STOCK_SNAPSHOT_MAGIC "BTSNAP03"
+#define STOCK_SNAPSHOT_PATH "stock_data.csv.snap"
+
+typedef struct {
+    char magic[8];
+    int record_size;
+    int stock_count;
+    long long source_size;
+    long long source_mtime_ns;
+    int dropped_symbols;
+    int reserved;
+    long long dropped_bars;
+} StockSnapshotHeader;
+
+void load_stock_data(Stock stocks[], int *stock_count);
+int load_stock_data_cached(Stock stocks[], int *stock_count);
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strategy_catalog.h"
+#include "backtest.h"
+#include "structures.h"
+
+void catalog_init(StrategyCatalog *catalog) {
+    memset(catalog, 0, sizeof(StrategyCatalog));
+}
+
+void catalog_free(StrategyCatalog *catalog) {
+    free(catalog->entries);
+    free(catalog->slots);
+    catalog_init(catalog);
+}
+
+static int find_slot(const StrategyCatalog *catalog, unsigned long long hash) {
+    int mask = catalog->slot_count - 1;
+    int slot = (int)(hash & (unsigned long long)mask);
+
+    while (catalog->slots[slot] >= 0 && catalog->entries[catalog->slots[slot]].hash != hash) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Keeps the index at most half full
+static int grow_index(StrategyCatalog *catalog) {
+    int slot_count = catalog->slot_count > 0 ? catalog->slot_count * 2 : 64;
+    int *slots = malloc(sizeof(int) * (size_t)slot_count);
+    if (slots == NULL) return -1;
+
+    free(catalog->slots);
+    catalog->slots = slots;
+    catalog->slot_count = slot_count;
+    for (int i = 0; i < slot_count; i++) slots[i] = -1;
+    for (int i = 0; i < catalog->count; i++) {
+        slots[find_slot(catalog, catalog->entries[i].hash)] = i;
+    }
+    return 0;
+}
+
+const CatalogEntry *catalog_find(const StrategyCatalog *catalog, unsigned long long hash) {
+    if (catalog->slot_count == 0) return NULL;
+    int index = catalog->slots[find_slot(catalog, hash)];
+    return index >= 0 ? &catalog->entries[index] : NULL;
+}
+
+static int add_entry(StrategyCatalog *catalog, const Strategy *strategy, unsigned long long hash,
+                     int ref_count) {
+    if (catalog->count == catalog->capacity) {
+        int capacity = catalog->capacity > 0 ? catalog->capacity * 2 : 32;
+        CatalogEntry *grown = realloc(catalog->entries, sizeof(CatalogEntry) * (size_t)capacity);
+        if (grown == NULL) {
+            printf("Error growing the strategy catalog!\n");
+            return -1;
+        }
+        catalog->entries = grown;
+        catalog->capacity = capacity;
+    }
+    if ((catalog->count + 1) * 2 > catalog->slot_count && grow_index(catalog) != 0) {
+        printf("Error growing the strategy catalog!\n");
+        return -1;
+    }
+
+    CatalogEntry *entry = &catalog->entries[catalog->count];
+    entry->hash = hash;
+    entry->strategy = *strategy;
+    entry->ref_count = ref_count;
+    catalog->slots[find_slot(catalog, hash)] = catalog->count++;
+    return 0;
+}
+
+// Adds one reference to the strategy's parameter set, creating the entry
+// the first time it is seen. An equal hash is only a candidate: should a
+// different parameter set already hold the key, the next key is tried, so
+// a key never names two parameter sets.
+int catalog_intern(StrategyCatalog *catalog, const Strategy *strategy, unsigned long long *hash) {
+    *hash = strategy_hash(strategy);
+    for (;;) {
+        const CatalogEntry *entry = catalog_find(catalog, *hash);
+        if (entry == NULL) return add_entry(catalog, strategy, *hash, 1);
+        if (strategies_equal(&entry->strategy, strategy)) {
+            catalog->entries[entry - catalog->entries].ref_count++;
+            return 0;
+        }
+        (*hash)++;
+    }
+}
+
+// Re-creates a saved entry, unreferenced, under the key it was saved with.
+// Returns -1 if that key already names other parameters.
+int catalog_restore(StrategyCatalog *catalog, const Strategy *strategy, unsigned long long hash) {
+    const CatalogEntry *entry = catalog_find(catalog, hash);
+    if (entry != NULL) return strategies_equal(&entry->strategy, strategy) ? 0 : -1;
+    return add_entry(catalog, strategy, hash, 0);
+}
+
+// Drops one reference. Unreferenced entries stay in memory but are not saved.
+void catalog_release(StrategyCatalog *catalog, unsigned long long hash) {
+    const CatalogEntry *entry = catalog_find(catalog, hash);
+    if (entry != NULL && entry->ref_count > 0) {
+        catalog->entries[entry - catalog->entries].ref_count--;
+    }
+}
+
+// The referenced parameters under the reference's own name
+int catalog_resolve(const StrategyCatalog *catalog, const StrategyRef *ref, Strategy *strategy) {
+    const CatalogEntry *entry = catalog_find(catalog, ref->hash);
+    if (entry == NULL) {
+        printf("Error: strategy '%s' is missing from the catalog!\n", ref->name);
+        return -1;
+    }
+    *strategy = entry->strategy;
+    strcpy(strategy->name, ref->name);
+    return 0;
+}
+
+// The presets followed by the user's strategies, fully resolved. Returns
+// the count, or -1 on failure; the caller frees *strategies.
+int comparison_lineup(const StrategyCatalog *catalog, const User *user, Strategy **strategies) {
+    int count = PRESET_STRATEGY_COUNT;
+
+    *strategies = malloc(sizeof(Strategy) * (size_t)(PRESET_STRATEGY_COUNT + user->strategy_count));
+    if (*strategies == NULL) {
+        printf("Error allocating the comparison line-up!\n");
+        return -1;
+    }
+    get_preset_strategies(*strategies);
+    for (int i = 0; i < user->strategy_count; i++) {
+        if (catalog_resolve(catalog, &user->strategies[i], &(*strategies)[count]) == 0) count++;
+    }
+    return count;
+}
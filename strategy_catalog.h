@@ -0,0 +1,32 @@
+#ifndef STRATEGY_CATALOG_H
+#define STRATEGY_CATALOG_H
+
+#include "structures.h"
+
+// One entry per distinct parameter set, identified by strategy_hash(), or
+// the next free key should another parameter set already hold it. Users
+// refer to entries by that key under their own display names.
+typedef struct {
+    unsigned long long hash;
+    Strategy strategy;          // name is the one it was first saved under
+    int ref_count;
+} CatalogEntry;
+
+typedef struct {
+    CatalogEntry *entries;
+    int count;
+    int capacity;
+    int *slots;                 // open-addressing index into entries, -1 = empty
+    int slot_count;             // power of two
+} StrategyCatalog;
+
+void catalog_init(StrategyCatalog *catalog);
+void catalog_free(StrategyCatalog *catalog);
+const CatalogEntry *catalog_find(const StrategyCatalog *catalog, unsigned long long hash);
+int catalog_intern(StrategyCatalog *catalog, const Strategy *strategy, unsigned long long *hash);
+int catalog_restore(StrategyCatalog *catalog, const Strategy *strategy, unsigned long long hash);
+void catalog_release(StrategyCatalog *catalog, unsigned long long hash);
+int catalog_resolve(const StrategyCatalog *catalog, const StrategyRef *ref, Strategy *strategy);
+int comparison_lineup(const StrategyCatalog *catalog, const User *user, Strategy **strategies);
+
+#endif
@@ -5,15 +5,18 @@
 #define MAX_DAYS 1000
 #define MAX_TRADES 500
 #define MAX_STOCK_NAME 20
+#define MAX_DATE 20         // "YYYY-MM-DD" or "YYYY-MM-DD HH:MM" for intraday bars
 #define MAX_USERS 50
 #define MAX_USERNAME 30
 #define MAX_PASSWORD 30
-#define MAX_STRATEGIES_PER_USER 10
+#define MAX_RULE_LENGTH 128
+#define PRICE_SCALE 100     // ticks per currency unit in fixed-point mode (cents)
 
-// Stock price data structure
+// Stock price data structure. Symbols are ids from the symbol dictionary
+// (symbols.h); symbol_name() gives the text.
 typedef struct {
-    char symbol[MAX_STOCK_NAME];
-    char date[12];
+    int symbol_id;
+    char date[MAX_DATE];
     double open;
     double high;
     double low;
@@ -23,15 +26,15 @@ typedef struct {
 
 // Stock structure
 typedef struct {
-    char symbol[MAX_STOCK_NAME];
+    int symbol_id;
     PriceData prices[MAX_DAYS];
     int day_count;
 } Stock;
 
 // Trade record structure
 typedef struct {
-    char symbol[MAX_STOCK_NAME];
-    char date[12];
+    int symbol_id;
+    char date[MAX_DATE];
     int day;
     char type[5];
     double price;
@@ -53,9 +56,15 @@ typedef struct {
     double stop_loss_pct;
     double take_profit_pct;
     int max_holding_days;
+    char entry_rule[MAX_RULE_LENGTH];   // optional rule text, empty = use parameters
+    char exit_rule[MAX_RULE_LENGTH];
 } Strategy;
 
-// Portfolio structure
+// Portfolio structure. In fixed-point mode cash and entry prices are kept in
+// integer ticks; the double fields mirror them for reporting. Per-stock
+// arrays follow the dataset's stock order; stocks[s].symbol_id names them.
+// The trade log keeps the first MAX_TRADES trades; the running totals after
+// it count every trade, so results stay right once the log is full.
 typedef struct {
     double cash;
     int positions[MAX_STOCKS];
@@ -63,14 +72,32 @@ typedef struct {
     int buy_day[MAX_STOCKS];
     Trade trades[MAX_TRADES];
     int trade_count;
+    int fixed_point;
+    long long cash_ticks;
+    long long avg_buy_ticks[MAX_STOCKS];
+    int trades_made;                    // logged or not
+    int winning_trades;
+    int losing_trades;
+    double start_cash;
+    double realized_profit;
+    double peak_equity;                 // highest cash plus realized profit so far
+    double max_drawdown;                // deepest fall from that peak, as a fraction
 } Portfolio;
 
+// A user's saved strategy: their name for it and the hash of its
+// parameters in the shared strategy catalog
+typedef struct {
+    char name[50];
+    unsigned long long hash;
+} StrategyRef;
+
 // User structure
 typedef struct {
     char username[MAX_USERNAME];
     char password[MAX_PASSWORD];
-    Strategy custom_strategies[MAX_STRATEGIES_PER_USER];
+    StrategyRef *strategies;            // grows as needed, no fixed cap
     int strategy_count;
+    int strategy_capacity;
 } User;
 
 // Strategy Result for comparison
@@ -86,6 +113,7 @@ typedef struct {
     int losing_trades;
     double win_rate;
     double total_realized_profit;
+    double max_drawdown_pct;            // deepest fall of realized equity from its peak
 } StrategyResult;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "sweep.h"
+#include "structures.h"
+
+// Number of values in the range, or -1 if it is malformed
+int sweep_range_count(const SweepRange *range) {
+    if (range->step == 0.0) return 1;
+    if (range->step < 0.0 || range->to < range->from) return -1;
+
+    double count = floor((range->to - range->from) / range->step + 1e-9) + 1.0;
+    return count > MAX_SWEEP_SIZE ? MAX_SWEEP_SIZE + 1 : (int)count;
+}
+
+static double sweep_value(const SweepRange *range, int i) {
+    return range->from + range->step * i;
+}
+
+// Allocates the grid of variants of base into *strategies, stop loss
+// varying slowest. Returns the count, or -1 after printing the problem.
+int build_exit_sweep(const Strategy *base, const ExitSweep *sweep, Strategy **strategies) {
+    int stops = sweep_range_count(&sweep->stop_loss);
+    int profits = sweep_range_count(&sweep->take_profit);
+    int holds = sweep_range_count(&sweep->max_holding);
+
+    if (stops <= 0 || profits <= 0 || holds <= 0) {
+        printf("Error: each range needs from <= to and a step of 0 or more!\n");
+        return -1;
+    }
+    if ((long long)stops * profits * holds > MAX_SWEEP_SIZE) {
+        printf("Error: the sweep has more than %d parameter sets!\n", MAX_SWEEP_SIZE);
+        return -1;
+    }
+
+    int count = stops * profits * holds;
+    *strategies = malloc(sizeof(Strategy) * (size_t)count);
+    if (*strategies == NULL) {
+        printf("Error allocating the sweep!\n");
+        return -1;
+    }
+
+    int n = 0;
+    for (int a = 0; a < stops; a++) {
+        for (int b = 0; b < profits; b++) {
+            for (int c = 0; c < holds; c++) {
+                Strategy *strategy = &(*strategies)[n++];
+                *strategy = *base;
+                strategy->stop_loss_pct = sweep_value(&sweep->stop_loss, a);
+                strategy->take_profit_pct = sweep_value(&sweep->take_profit, b);
+                strategy->max_holding_days = (int)lround(sweep_value(&sweep->max_holding, c));
+                snprintf(strategy->name, sizeof(strategy->name), "%.20s SL%.2f TP%.2f H%d", base->name,
+                         strategy->stop_loss_pct, strategy->take_profit_pct, strategy->max_holding_days);
+            }
+        }
+    }
+    return count;
+}
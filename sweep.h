@@ -0,0 +1,27 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "structures.h"
+
+// Most parameter sets one sweep may generate
+#define MAX_SWEEP_SIZE 20000
+
+// Values from, from + step, ... up to to; a step of 0 gives from alone
+typedef struct {
+    double from;
+    double to;
+    double step;
+} SweepRange;
+
+// Exit parameters to vary around a base strategy, whose entry parameters
+// every generated strategy keeps
+typedef struct {
+    SweepRange stop_loss;
+    SweepRange take_profit;
+    SweepRange max_holding;
+} ExitSweep;
+
+int sweep_range_count(const SweepRange *range);
+int build_exit_sweep(const Strategy *base, const ExitSweep *sweep, Strategy **strategies);
+
+#endif
@@ -0,0 +1,71 @@
+#include <string.h>
+#include <pthread.h>
+#include "symbols.h"
+#include "structures.h"
+
+// Names are written before the slot that publishes their id, and slots are
+// only ever filled, so lookups read the table without locking. Interning a
+// new name takes the lock.
+static char names[MAX_SYMBOLS][MAX_STOCK_NAME];
+static int slots[SYMBOL_SLOTS];         // id + 1, 0 = empty
+static int count;
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int hash_name(const char *name) {
+    unsigned int hash = 2166136261u;
+    for (; *name != '\0'; name++) hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash;
+}
+
+// The name's id, or -1 with *slot at the empty slot where it would go
+static int probe(const char *name, unsigned int *slot) {
+    unsigned int s = hash_name(name) & (SYMBOL_SLOTS - 1);
+    for (;;) {
+        int entry = __atomic_load_n(&slots[s], __ATOMIC_ACQUIRE);
+        if (entry == 0) break;
+        if (strcmp(names[entry - 1], name) == 0) return entry - 1;
+        s = (s + 1) & (SYMBOL_SLOTS - 1);
+    }
+    *slot = s;
+    return -1;
+}
+
+// The id of name (truncated to MAX_STOCK_NAME - 1 characters), assigning
+// the next one if it is new. Returns -1 for an empty name or when
+// MAX_SYMBOLS symbols are already known.
+int symbol_intern(const char *name) {
+    char key[MAX_STOCK_NAME];
+    unsigned int slot;
+
+    strncpy(key, name, MAX_STOCK_NAME - 1);
+    key[MAX_STOCK_NAME - 1] = '\0';
+    if (key[0] == '\0') return -1;
+
+    int id = probe(key, &slot);
+    if (id >= 0) return id;
+
+    pthread_mutex_lock(&intern_lock);
+    id = probe(key, &slot);
+    if (id < 0 && count < MAX_SYMBOLS) {
+        id = count;
+        strcpy(names[id], key);
+        __atomic_store_n(&slots[slot], id + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&count, id + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&intern_lock);
+    return id;
+}
+
+// The id of an already interned name, or -1
+int symbol_find(const char *name) {
+    unsigned int slot;
+    return probe(name, &slot);
+}
+
+const char *symbol_name(int id) {
+    return id >= 0 && id < __atomic_load_n(&count, __ATOMIC_ACQUIRE) ? names[id] : "?";
+}
+
+int symbol_count(void) {
+    return __atomic_load_n(&count, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,18 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include "structures.h"
+
+// Process-wide dictionary giving every symbol a dense integer id the first
+// time it is seen. Prices, trades, stocks and cached indicators carry the
+// id; the name is only looked up to print or store it. Ids never change or
+// get reused, and the dictionary may be used from any number of threads.
+#define MAX_SYMBOLS 65536
+#define SYMBOL_SLOTS (MAX_SYMBOLS * 2)  // hash slots, a power of two
+
+int symbol_intern(const char *name);
+int symbol_find(const char *name);
+const char *symbol_name(int id);
+int symbol_count(void);
+
+#endif
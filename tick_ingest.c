@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "tick_ingest.h"
+#include "stock_data.h"
+#include "symbols.h"
+#include "structures.h"
+
+#define TICK_READ_BUFFER (1 << 20)
+
+// Open bar for one symbol
+typedef struct {
+    int symbol_id;
+    long long bucket;       // bar start, seconds since epoch
+    double open;
+    double high;
+    double low;
+    double close;
+    long long volume;
+    int has_bar;
+} BarAccumulator;
+
+typedef struct {
+    BarAccumulator accumulators[TICK_MAX_SYMBOLS];
+    int by_symbol[MAX_SYMBOLS];     // index into accumulators by symbol id, -1 = none
+    int count;
+    int header_checked;
+} AccumulatorTable;
+
+// The symbol dictionary does the hashing; its id indexes the table directly
+static BarAccumulator *find_accumulator(AccumulatorTable *table, const char *symbol, int length) {
+    char name[MAX_STOCK_NAME];
+    memcpy(name, symbol, (size_t)length);
+    name[length] = '\0';
+
+    int id = symbol_intern(name);
+    if (id < 0) return NULL;
+    if (table->by_symbol[id] >= 0) return &table->accumulators[table->by_symbol[id]];
+    if (table->count >= TICK_MAX_SYMBOLS) return NULL;
+
+    BarAccumulator *acc = &table->accumulators[table->count];
+    memset(acc, 0, sizeof(BarAccumulator));
+    acc->symbol_id = id;
+    table->by_symbol[id] = table->count++;
+    return acc;
+}
+
+int parse_bar_resolution(const char *text) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (value <= 0) return -1;
+
+    switch (*end) {
+        case 'm': return (int)(value * 60);
+        case 'h': return (int)(value * 3600);
+        case 'd': return (int)(value * 86400);
+        case 's':
+        case '\0': return (int)value;
+        default: return -1;
+    }
+}
+
+// Accepts epoch seconds or "YYYY-MM-DD HH:MM[:SS]" (also with 'T').
+// Returns 0 on success and leaves *cursor after the field.
+static int parse_timestamp(const char **cursor, long long *seconds) {
+    const char *p = *cursor;
+    long long fields[6] = { 0, 0, 0, 0, 0, 0 };
+    int count = 0;
+
+    if (!isdigit((unsigned char)*p)) return -1;
+    while (count < 6) {
+        long long value = 0;
+        if (!isdigit((unsigned char)*p)) break;
+        while (isdigit((unsigned char)*p)) value = value * 10 + (*p++ - '0');
+        fields[count++] = value;
+        if (*p == '-' || *p == ':' || *p == ' ' || *p == 'T') p++;
+        else break;
+    }
+    if (*p == '.') {
+        p++;
+        while (isdigit((unsigned char)*p)) p++;
+    }
+
+    if (count == 1) {
+        *seconds = fields[0];
+    } else if (count >= 3) {
+        *seconds = days_from_civil((int)fields[0], (int)fields[1], (int)fields[2]) * 86400 +
+                   fields[3] * 3600 + fields[4] * 60 + fields[5];
+    } else {
+        return -1;
+    }
+    *cursor = p;
+    return 0;
+}
+
+static void format_bucket(long long bucket, int resolution_seconds, char date[MAX_DATE]) {
+    int year, month, day;
+    long long days = (bucket >= 0 ? bucket : bucket - 86399) / 86400;
+    long long second_of_day = bucket - days * 86400;
+
+    civil_from_days(days, &year, &month, &day);
+    if (resolution_seconds % 86400 == 0) {
+        snprintf(date, MAX_DATE, "%04d-%02d-%02d", year % 10000, month, day);
+    } else {
+        snprintf(date, MAX_DATE, "%04d-%02d-%02d %02d:%02d", year % 10000, month, day,
+                 (int)(second_of_day / 3600), (int)(second_of_day % 3600 / 60));
+    }
+}
+
+static void emit_bar(BarAccumulator *acc, int resolution_seconds, BarCallback on_bar,
+                     void *context, TickIngestStats *stats) {
+    PriceData bar;
+
+    memset(&bar, 0, sizeof(bar));
+    bar.symbol_id = acc->symbol_id;
+    format_bucket(acc->bucket, resolution_seconds, bar.date);
+    bar.open = acc->open;
+    bar.high = acc->high;
+    bar.low = acc->low;
+    bar.close = acc->close;
+    bar.volume = acc->volume > 2147483647LL ? 2147483647 : (int)acc->volume;
+
+    on_bar(&bar, acc->bucket, context);
+    stats->bars++;
+    acc->has_bar = 0;
+}
+
+// Parses "timestamp,symbol,price,size" and folds it into its symbol's bar
+static void process_tick(AccumulatorTable *table, const char *line, int resolution_seconds,
+                         BarCallback on_bar, void *context, TickIngestStats *stats) {
+    const char *p = line;
+    long long timestamp;
+
+    // Skip an optional header line
+    if (!table->header_checked) {
+        table->header_checked = 1;
+        if (!isdigit((unsigned char)line[0])) return;
+    }
+    if (parse_timestamp(&p, &timestamp) != 0 || *p != ',') {
+        stats->rejected++;
+        return;
+    }
+
+    const char *symbol = ++p;
+    while (*p != ',' && *p != '\0') p++;
+    int length = (int)(p - symbol);
+    if (*p != ',' || length == 0 || length >= MAX_STOCK_NAME) {
+        stats->rejected++;
+        return;
+    }
+
+    char *end;
+    double price = strtod(p + 1, &end);
+    if (end == p + 1 || *end != ',' || price <= 0.0) {
+        stats->rejected++;
+        return;
+    }
+    long long size = strtoll(end + 1, NULL, 10);
+
+    BarAccumulator *acc = find_accumulator(table, symbol, length);
+    if (acc == NULL) {
+        stats->rejected++;
+        return;
+    }
+
+    long long bucket = timestamp - ((timestamp % resolution_seconds) + resolution_seconds) % resolution_seconds;
+    if (acc->has_bar && bucket < acc->bucket) {
+        stats->late++;
+        return;
+    }
+    if (acc->has_bar && bucket != acc->bucket) {
+        emit_bar(acc, resolution_seconds, on_bar, context, stats);
+    }
+
+    if (!acc->has_bar) {
+        acc->bucket = bucket;
+        acc->open = acc->high = acc->low = price;
+        acc->volume = 0;
+        acc->has_bar = 1;
+    }
+    if (price > acc->high) acc->high = price;
+    if (price < acc->low) acc->low = price;
+    acc->close = price;
+    acc->volume += size;
+    stats->ticks++;
+}
+
+int stream_tick_bars(const char *path, int resolution_seconds, BarCallback on_bar,
+                     void *context, TickIngestStats *stats) {
+    if (resolution_seconds <= 0) {
+        printf("Error: invalid bar resolution!\n");
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("Error opening tick file '%s'!\n", path);
+        return -1;
+    }
+
+    AccumulatorTable *table = malloc(sizeof(AccumulatorTable));
+    char *buffer = malloc(TICK_READ_BUFFER + 1);
+    if (table == NULL || buffer == NULL) {
+        printf("Error allocating tick buffers!\n");
+        free(table);
+        free(buffer);
+        fclose(fp);
+        return -1;
+    }
+    memset(table->by_symbol, -1, sizeof(table->by_symbol));
+    table->count = 0;
+    table->header_checked = 0;
+    memset(stats, 0, sizeof(TickIngestStats));
+    stats->resolution = resolution_seconds;
+
+    // Lines are processed straight out of the read buffer; only a partial
+    // trailing line is carried over to the next read
+    size_t carried = 0;
+    for (;;) {
+        size_t got = fread(buffer + carried, 1, TICK_READ_BUFFER - carried, fp);
+        size_t length = carried + got;
+        if (length == 0) break;
+        buffer[length] = '\0';
+
+        char *line = buffer;
+        char *newline;
+        while ((newline = memchr(line, '\n', length - (size_t)(line - buffer))) != NULL) {
+            *newline = '\0';
+            process_tick(table, line, resolution_seconds, on_bar, context, stats);
+            line = newline + 1;
+        }
+
+        carried = length - (size_t)(line - buffer);
+        if (got == 0 || carried == TICK_READ_BUFFER) {
+            // End of file without newline, or a line longer than the buffer
+            if (carried > 0) process_tick(table, line, resolution_seconds, on_bar, context, stats);
+            carried = 0;
+            if (got == 0) break;
+        } else {
+            memmove(buffer, line, carried);
+        }
+    }
+
+    // Close every bar still open at end of input
+    for (int i = 0; i < table->count; i++) {
+        if (table->accumulators[i].has_bar) {
+            emit_bar(&table->accumulators[i], resolution_seconds, on_bar, context, stats);
+        }
+    }
+    stats->symbols = table->count;
+
+    free(buffer);
+    free(table);
+    fclose(fp);
+    return 0;
+}
+
+// One symbol's most recent MAX_DAYS bars as they close, with their bucket
+// starts, in a ring: bar k (0 = oldest kept) is at (first + k) % MAX_DAYS
+typedef struct {
+    int symbol_id;
+    long long first_bucket;     // of the symbol's first bar, kept or not
+    long long evicted;          // older bars pushed out of the full ring
+    long long last_evicted;     // bucket of the newest of those
+    PriceData bars[MAX_DAYS];
+    long long buckets[MAX_DAYS];
+    int first;
+    int count;
+} BarSeries;
+
+typedef struct {
+    BarSeries series[MAX_STOCKS];
+    int series_count;
+} StockSink;
+
+static int ring_slot(const BarSeries *series, int k) {
+    return (series->first + k) % MAX_DAYS;
+}
+
+static void collect_bar(const PriceData *bar, long long bucket, void *context) {
+    StockSink *sink = (StockSink *)context;
+    BarSeries *series = NULL;
+
+    for (int i = 0; i < sink->series_count; i++) {
+        if (sink->series[i].symbol_id == bar->symbol_id) {
+            series = &sink->series[i];
+            break;
+        }
+    }
+    if (series == NULL) {
+        if (sink->series_count >= MAX_STOCKS) return;
+        series = &sink->series[sink->series_count++];
+        memset(series, 0, sizeof(BarSeries));
+        series->symbol_id = bar->symbol_id;
+        series->first_bucket = bucket;
+    }
+    // A full ring overwrites its oldest bar
+    int slot = ring_slot(series, series->count);
+    if (series->count == MAX_DAYS) {
+        series->last_evicted = series->buckets[slot];
+        series->evicted++;
+        series->first = ring_slot(series, 1);
+    } else {
+        series->count++;
+    }
+    series->bars[slot] = *bar;
+    series->buckets[slot] = bucket;
+}
+
+static int compare_buckets(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// The engine reads every stock at the same bar index, so the series are
+// laid onto one grid: every bucket in which any symbol traded, from the
+// first bucket in which all of them have. Earlier bars are dropped, and a
+// symbol with no trades in a bucket repeats its previous close with zero
+// volume. Only the most recent MAX_DAYS buckets fit; older bars from the
+// first bucket on, here or already pushed out of a ring, count as truncated.
+static int align_series(StockSink *sink, Stock stocks[], int *stock_count, TickIngestStats *stats) {
+    // The grid can only begin where every ring still has a bar
+    long long start = 0, floor = 0;
+    for (int i = 0; i < sink->series_count; i++) {
+        const BarSeries *series = &sink->series[i];
+        if (i == 0 || series->first_bucket > start) start = series->first_bucket;
+        if (i == 0 || series->buckets[series->first] > floor) floor = series->buckets[series->first];
+    }
+
+    long long *grid = malloc(sizeof(long long) * (size_t)sink->series_count * MAX_DAYS);
+    if (grid == NULL) return -1;
+    long long grid_count = 0;
+    for (int i = 0; i < sink->series_count; i++) {
+        const BarSeries *series = &sink->series[i];
+        for (int k = 0; k < series->count; k++) {
+            long long bucket = series->buckets[ring_slot(series, k)];
+            if (bucket >= floor) grid[grid_count++] = bucket;
+        }
+    }
+    qsort(grid, (size_t)grid_count, sizeof(long long), compare_buckets);
+    long long unique = 0;
+    for (long long g = 0; g < grid_count; g++) {
+        if (unique == 0 || grid[g] != grid[unique - 1]) grid[unique++] = grid[g];
+    }
+    long long skip = unique > MAX_DAYS ? unique - MAX_DAYS : 0;
+    long long *kept = grid + skip;
+    unique -= skip;
+
+    for (int i = 0; i < sink->series_count; i++) {
+        const BarSeries *series = &sink->series[i];
+        Stock *stock = &stocks[i];
+        int k = 0;
+
+        // Bars leave a ring in date order, so if the newest one to go came
+        // before every symbol had traded, they all did
+        if (series->last_evicted < start) stats->trimmed += series->evicted;
+        else stats->truncated += series->evicted;
+
+        for (; k < series->count && series->buckets[ring_slot(series, k)] < kept[0]; k++) {
+            if (series->buckets[ring_slot(series, k)] < start) stats->trimmed++;
+            else stats->truncated++;
+        }
+        stock->symbol_id = series->symbol_id;
+        for (int g = 0; g < (int)unique; g++) {
+            PriceData *row = &stock->prices[g];
+            if (k < series->count && series->buckets[ring_slot(series, k)] == kept[g]) {
+                *row = series->bars[ring_slot(series, k++)];
+                continue;
+            }
+            // Every symbol has traded by the first grid bucket, so there is
+            // always a previous bar, possibly one of the dropped ones
+            *row = g > 0 ? stock->prices[g - 1] : series->bars[ring_slot(series, k - 1)];
+            format_bucket(kept[g], stats->resolution, row->date);
+            row->open = row->high = row->low = row->close;
+            row->volume = 0;
+            stats->filled++;
+        }
+        stock->day_count = (int)unique;
+    }
+    *stock_count = sink->series_count;
+    free(grid);
+    return 0;
+}
+
+int load_tick_bars(const char *path, int resolution_seconds, Stock stocks[],
+                   int *stock_count, TickIngestStats *stats) {
+    StockSink *sink = calloc(1, sizeof(StockSink));
+    int status;
+
+    *stock_count = 0;
+    if (sink == NULL) {
+        printf("Error allocating tick buffers!\n");
+        return -1;
+    }
+    status = stream_tick_bars(path, resolution_seconds, collect_bar, sink, stats);
+    if (status == 0 && sink->series_count > 0 && align_series(sink, stocks, stock_count, stats) != 0) {
+        printf("Error allocating bar buffers!\n");
+        status = -1;
+    }
+    free(sink);
+    return status;
+}
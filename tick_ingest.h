@@ -0,0 +1,30 @@
+#ifndef TICK_INGEST_H
+#define TICK_INGEST_H
+
+#include "structures.h"
+
+#define TICK_MAX_SYMBOLS 4096
+
+// Called once for every completed bar, in the order bars close; the bar
+// carries its symbol id, bucket its start in seconds since epoch
+typedef void (*BarCallback)(const PriceData *bar, long long bucket, void *context);
+
+typedef struct {
+    long long ticks;
+    long long bars;
+    long long rejected;     // lines that could not be parsed
+    long long late;         // ticks older than their symbol's open bar
+    long long trimmed;      // bars before every symbol had traded, dropped by load_tick_bars
+    long long filled;       // empty intervals load_tick_bars filled from the previous close
+    long long truncated;    // bars older than the most recent MAX_DAYS intervals, dropped by load_tick_bars
+    int symbols;
+    int resolution;         // seconds per bar
+} TickIngestStats;
+
+int parse_bar_resolution(const char *text);
+int stream_tick_bars(const char *path, int resolution_seconds, BarCallback on_bar,
+                     void *context, TickIngestStats *stats);
+int load_tick_bars(const char *path, int resolution_seconds, Stock stocks[],
+                   int *stock_count, TickIngestStats *stats);
+
+#endif
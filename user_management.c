@@ -1,73 +1,193 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "user_management.h"
+#include "strategy_catalog.h"
+#include "rules.h"
+#include "backtest.h"
 #include "structures.h"
 
-void load_users(User users[], int *user_count) {
+// Splits text in place on sep, keeping empty fields. Returns the field count.
+static int split_fields(char *text, char sep, char *fields[], int max_fields) {
+    int count = 0;
+    while (count < max_fields) {
+        fields[count++] = text;
+        char *next = strchr(text, sep);
+        if (next == NULL) break;
+        *next = '\0';
+        text = next + 1;
+    }
+    return count;
+}
+
+static void parse_strategy(char *text, Strategy *s) {
+    char *fields[10];
+    int count = split_fields(text, '|', fields, 10);
+
+    memset(s, 0, sizeof(Strategy));
+    if (count > 0) strncpy(s->name, fields[0], sizeof(s->name) - 1);
+    if (count > 1) s->rsi_oversold = atof(fields[1]);
+    if (count > 2) s->rsi_overbought = atof(fields[2]);
+    if (count > 3) s->sma_short_period = atoi(fields[3]);
+    if (count > 4) s->sma_long_period = atoi(fields[4]);
+    if (count > 5) s->stop_loss_pct = atof(fields[5]);
+    if (count > 6) s->take_profit_pct = atof(fields[6]);
+    if (count > 7) s->max_holding_days = atoi(fields[7]);
+    // Rules were added later; older rows simply have no fields for them
+    if (count > 8) strncpy(s->entry_rule, fields[8], MAX_RULE_LENGTH - 1);
+    if (count > 9) strncpy(s->exit_rule, fields[9], MAX_RULE_LENGTH - 1);
+}
+
+// Exact doubles, so a reloaded strategy hashes the same as the saved one
+static void write_strategy(FILE *fp, const Strategy *s) {
+    fprintf(fp, "%s|%.17g|%.17g|%d|%d|%.17g|%.17g|%d|%s|%s",
+            s->name, s->rsi_oversold, s->rsi_overbought,
+            s->sma_short_period, s->sma_long_period,
+            s->stop_loss_pct, s->take_profit_pct, s->max_holding_days,
+            s->entry_rule, s->exit_rule);
+}
+
+static int add_strategy_ref(User *user, const char *name, unsigned long long hash) {
+    if (user->strategy_count == user->strategy_capacity) {
+        int capacity = user->strategy_capacity > 0 ? user->strategy_capacity * 2 : 8;
+        StrategyRef *grown = realloc(user->strategies, sizeof(StrategyRef) * (size_t)capacity);
+        if (grown == NULL) {
+            printf("Error allocating strategies for '%s'!\n", user->username);
+            return -1;
+        }
+        user->strategies = grown;
+        user->strategy_capacity = capacity;
+    }
+    StrategyRef *ref = &user->strategies[user->strategy_count++];
+    strncpy(ref->name, name, sizeof(ref->name) - 1);
+    ref->name[sizeof(ref->name) - 1] = '\0';
+    ref->hash = hash;
+    return 0;
+}
+
+// strategies.csv: one row per referenced parameter set, "hash,strategy"
+static void load_catalog(StrategyCatalog *catalog) {
+    FILE *fp = fopen("strategies.csv", "r");
+    if (fp == NULL) return;
+
+    char *line = NULL;
+    size_t size = 0;
+    if (getline(&line, &size, fp) == -1) { // Skip header
+        free(line);
+        fclose(fp);
+        return;
+    }
+    while (getline(&line, &size, fp) != -1) {
+        char *comma = strchr(line, ',');
+        if (comma == NULL) continue;
+        *comma = '\0';
+        comma[1 + strcspn(comma + 1, "\r\n")] = '\0';
+
+        Strategy strategy;
+        unsigned long long stored = strtoull(line, NULL, 16);
+        parse_strategy(comma + 1, &strategy);
+        // References are counted as users' strategies are read
+        if (catalog_restore(catalog, &strategy, stored) != 0) {
+            printf("Warning: catalog entry %016llx is listed twice with different parameters!\n", stored);
+        }
+    }
+    free(line);
+    fclose(fp);
+}
+
+// Loads the strategy catalog and then users.csv. A user's strategy field is
+// either "name|hash" or, in files from before the catalog, the full
+// parameter list, which is added to the catalog as it is read.
+void load_users(User users[], int *user_count, StrategyCatalog *catalog) {
+    *user_count = 0;
+    load_catalog(catalog);
+
     FILE *fp = fopen("users.csv", "r");
     if (fp == NULL) {
-        *user_count = 0;
         return;
     }
 
-    char line[2048];
-    fgets(line, sizeof(line), fp); // Skip header
-    *user_count = 0;
+    char *line = NULL;
+    size_t size = 0;
+    if (getline(&line, &size, fp) == -1) { // Skip header
+        free(line);
+        fclose(fp);
+        return;
+    }
 
-    while (fgets(line, sizeof(line), fp) && *user_count < MAX_USERS) {
+    while (getline(&line, &size, fp) != -1 && *user_count < MAX_USERS) {
         User *user = &users[*user_count];
-        char *token;
-        
-        // Parse username
-        token = strtok(line, ",");
-        if (token) strcpy(user->username, token);
-        
-        // Parse password
-        token = strtok(NULL, ",");
-        if (token) strcpy(user->password, token);
-        
-        // Parse strategy count
-        token = strtok(NULL, ",");
-        if (token) user->strategy_count = atoi(token);
-        
-        // Parse each strategy
-        for (int i = 0; i < user->strategy_count && i < MAX_STRATEGIES_PER_USER; i++) {
-            Strategy *s = &user->custom_strategies[i];
-            
-            token = strtok(NULL, "|");
-            if (token) strcpy(s->name, token);
-            
-            token = strtok(NULL, "|");
-            if (token) s->rsi_oversold = atof(token);
-            
-            token = strtok(NULL, "|");
-            if (token) s->rsi_overbought = atof(token);
-            
-            token = strtok(NULL, "|");
-            if (token) s->sma_short_period = atoi(token);
-            
-            token = strtok(NULL, "|");
-            if (token) s->sma_long_period = atoi(token);
-            
-            token = strtok(NULL, "|");
-            if (token) s->stop_loss_pct = atof(token);
-            
-            token = strtok(NULL, "|");
-            if (token) s->take_profit_pct = atof(token);
-            
-            token = strtok(NULL, ",");
-            if (token) s->max_holding_days = atoi(token);
+        int max_fields = 1;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        for (char *c = line; *c != '\0'; c++) {
+            if (*c == ',') max_fields++;
         }
-        
+        char **fields = malloc(sizeof(char *) * (size_t)max_fields);
+        if (fields == NULL) break;
+        int count = split_fields(line, ',', fields, max_fields);
+        if (count < 3) {
+            free(fields);
+            continue;
+        }
+
+        memset(user, 0, sizeof(User));
+        strncpy(user->username, fields[0], MAX_USERNAME - 1);
+        strncpy(user->password, fields[1], MAX_PASSWORD - 1);
+        int strategy_count = atoi(fields[2]);
+        if (strategy_count > count - 3) strategy_count = count - 3;
+
+        for (int i = 0; i < strategy_count; i++) {
+            char *text = fields[3 + i];
+            char *bar = strchr(text, '|');
+            unsigned long long hash;
+
+            if (bar != NULL && strchr(bar + 1, '|') == NULL) {
+                *bar = '\0';
+                hash = strtoull(bar + 1, NULL, 16);
+                const CatalogEntry *entry = catalog_find(catalog, hash);
+                if (entry == NULL) {
+                    printf("Warning: %s's strategy '%s' is missing from the catalog!\n", user->username, text);
+                    continue;
+                }
+                catalog->entries[entry - catalog->entries].ref_count++;
+                add_strategy_ref(user, text, hash);
+            } else {
+                Strategy strategy;
+                parse_strategy(text, &strategy);
+                if (catalog_intern(catalog, &strategy, &hash) == 0) {
+                    add_strategy_ref(user, strategy.name, hash);
+                }
+            }
+        }
+
+        free(fields);
         (*user_count)++;
     }
 
+    free(line);
     fclose(fp);
 }
 
-void save_users(User users[], int user_count) {
-    FILE *fp = fopen("users.csv", "w");
+void save_users(User users[], int user_count, const StrategyCatalog *catalog) {
+    // The catalog goes first so users.csv never refers to a missing entry
+    FILE *fp = fopen("strategies.csv", "w");
+    if (fp == NULL) {
+        printf("Error saving strategies!\n");
+        return;
+    }
+    fprintf(fp, "Hash,Strategy\n");
+    for (int i = 0; i < catalog->count; i++) {
+        const CatalogEntry *entry = &catalog->entries[i];
+        if (entry->ref_count == 0) continue;
+        fprintf(fp, "%016llx,", entry->hash);
+        write_strategy(fp, &entry->strategy);
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+
+    fp = fopen("users.csv", "w");
     if (fp == NULL) {
         printf("Error saving users!\n");
         return;
@@ -81,13 +201,9 @@ void save_users(User users[], int user_count) {
         User *user = &users[i];
         fprintf(fp, "%s,%s,%d", user->username, user->password, user->strategy_count);
         
-        // Write each strategy separated by commas, fields within strategy separated by pipes
+        // Each strategy is the user's name for it and its catalog hash
         for (int j = 0; j < user->strategy_count; j++) {
-            Strategy *s = &user->custom_strategies[j];
-            fprintf(fp, ",%s|%.2f|%.2f|%d|%d|%.2f|%.2f|%d",
-                    s->name, s->rsi_oversold, s->rsi_overbought,
-                    s->sma_short_period, s->sma_long_period,
-                    s->stop_loss_pct, s->take_profit_pct, s->max_holding_days);
+            fprintf(fp, ",%s|%016llx", user->strategies[j].name, user->strategies[j].hash);
         }
         fprintf(fp, "\n");
     }
@@ -95,6 +211,14 @@ void save_users(User users[], int user_count) {
     fclose(fp);
 }
 
+void free_users(User users[], int user_count) {
+    for (int i = 0; i < user_count; i++) {
+        free(users[i].strategies);
+        users[i].strategies = NULL;
+        users[i].strategy_count = users[i].strategy_capacity = 0;
+    }
+}
+
 void register_user(User users[], int *user_count) {
     User new_user;
     printf("\n=== USER REGISTRATION ===\n");
@@ -112,7 +236,9 @@ void register_user(User users[], int *user_count) {
     printf("Enter password: ");
     scanf("%s", new_user.password);
     
+    new_user.strategies = NULL;
     new_user.strategy_count = 0;
+    new_user.strategy_capacity = 0;
     users[*user_count] = new_user;
     (*user_count)++;
     
@@ -140,14 +266,39 @@ int login(User users[], int user_count, char *logged_username) {
     return -1;
 }
 
-void create_new_strategy(User *user) {
-    if (user->strategy_count >= MAX_STRATEGIES_PER_USER) {
-        printf("Maximum strategies reached! Please delete a strategy first.\n");
-        return;
+// Reads a rule from the user, re-prompting until it compiles.
+// '-' clears the rule; '.' keeps the current one when editing.
+static void prompt_rule(const char *label, char rule[], int is_exit, int allow_keep) {
+    char input[MAX_RULE_LENGTH];
+    char error[128];
+
+    for (;;) {
+        if (allow_keep) {
+            printf("Enter %s rule [%s] ('.' to keep, '-' for none): ", label, rule[0] ? rule : "none");
+        } else {
+            printf("Enter %s rule (or '-' to use the parameters above): ", label);
+        }
+        scanf(" %127[^\n]", input);
+
+        if (allow_keep && strcmp(input, ".") == 0) return;
+        if (strcmp(input, "-") == 0) {
+            rule[0] = '\0';
+            return;
+        }
+        if (validate_rule(input, is_exit, error, sizeof(error)) == 0) {
+            strcpy(rule, input);
+            return;
+        }
+        printf("Invalid rule: %s\n", error);
     }
+}
+
+void create_new_strategy(User *user, StrategyCatalog *catalog) {
+    Strategy new_strategy;
+    Strategy *strategy = &new_strategy;
+    unsigned long long hash;
     
-    Strategy *strategy = &user->custom_strategies[user->strategy_count];
-    
+    memset(strategy, 0, sizeof(Strategy));
     printf("\n=== CREATE NEW STRATEGY ===\n");
     printf("Enter strategy name: ");
     scanf(" %[^\n]", strategy->name);
@@ -166,17 +317,28 @@ void create_new_strategy(User *user) {
     printf("Enter max holding days (e.g., 15): ");
     scanf("%d", &strategy->max_holding_days);
     
-    user->strategy_count++;
+    printf("\nOptional rules, e.g. 'sma(5) crosses_above sma(20) and rsi(14) < 60'\n");
+    strategy->entry_rule[0] = '\0';
+    strategy->exit_rule[0] = '\0';
+    prompt_rule("entry", strategy->entry_rule, 0, 0);
+    prompt_rule("exit", strategy->exit_rule, 1, 0);
+    
+    // Identical parameters saved by anyone share one catalog entry
+    if (catalog_intern(catalog, strategy, &hash) != 0) return;
+    if (add_strategy_ref(user, strategy->name, hash) != 0) {
+        catalog_release(catalog, hash);
+        return;
+    }
     printf("\n✓ Strategy '%s' created successfully!\n", strategy->name);
 }
 
-void edit_strategy(User *user) {
+void edit_strategy(User *user, StrategyCatalog *catalog) {
     if (user->strategy_count == 0) {
         printf("\nNo strategies to edit!\n");
         return;
     }
     
-    show_user_strategies(user);
+    show_user_strategies(user, catalog);
     
     int choice;
     printf("\nSelect strategy to edit (1-%d): ", user->strategy_count);
@@ -187,7 +349,11 @@ void edit_strategy(User *user) {
         return;
     }
     
-    Strategy *strategy = &user->custom_strategies[choice - 1];
+    StrategyRef *ref = &user->strategies[choice - 1];
+    Strategy edited;
+    Strategy *strategy = &edited;
+    unsigned long long hash;
+    if (catalog_resolve(catalog, ref, strategy) != 0) return;
     
     printf("\n=== EDITING STRATEGY: %s ===\n", strategy->name);
     printf("Current values are shown in [brackets]\n\n");
@@ -232,10 +398,19 @@ void edit_strategy(User *user) {
         while(getchar() != '\n');
     }
     
+    prompt_rule("entry", strategy->entry_rule, 0, 1);
+    prompt_rule("exit", strategy->exit_rule, 1, 1);
+    
+    // Other users may share the old parameters, so the entry is never
+    // modified in place: the reference moves to the new parameter set
+    if (catalog_intern(catalog, strategy, &hash) != 0) return;
+    catalog_release(catalog, ref->hash);
+    ref->hash = hash;
+    strcpy(ref->name, strategy->name);
     printf("\n✓ Strategy '%s' updated successfully!\n", strategy->name);
 }
 
-void show_user_strategies(User *user) {
+void show_user_strategies(User *user, const StrategyCatalog *catalog) {
     printf("\n=== YOUR SAVED STRATEGIES ===\n");
     if (user->strategy_count == 0) {
         printf("No strategies saved yet.\n");
@@ -243,21 +418,25 @@ void show_user_strategies(User *user) {
     }
     
     for (int i = 0; i < user->strategy_count; i++) {
-        Strategy *s = &user->custom_strategies[i];
+        Strategy strategy;
+        Strategy *s = &strategy;
+        if (catalog_resolve(catalog, &user->strategies[i], s) != 0) continue;
         printf("\n%d. %s\n", i + 1, s->name);
         printf("   RSI: %.0f-%.0f | SMA: %d/%d | Stop Loss: %.1f%% | Take Profit: %.1f%% | Max Days: %d\n",
                s->rsi_oversold, s->rsi_overbought, s->sma_short_period, s->sma_long_period,
                s->stop_loss_pct, s->take_profit_pct, s->max_holding_days);
+        if (s->entry_rule[0] != '\0') printf("   Entry Rule: %s\n", s->entry_rule);
+        if (s->exit_rule[0] != '\0') printf("   Exit Rule: %s\n", s->exit_rule);
     }
 }
 
-void delete_strategy(User *user) {
+void delete_strategy(User *user, StrategyCatalog *catalog) {
     if (user->strategy_count == 0) {
         printf("\nNo strategies to delete!\n");
         return;
     }
     
-    show_user_strategies(user);
+    show_user_strategies(user, catalog);
     
     int choice;
     printf("\nSelect strategy to delete (1-%d): ", user->strategy_count);
@@ -270,13 +449,14 @@ void delete_strategy(User *user) {
     
     char confirm;
     printf("Are you sure you want to delete '%s'? (y/n): ", 
-           user->custom_strategies[choice - 1].name);
+           user->strategies[choice - 1].name);
     scanf(" %c", &confirm);
     
     if (confirm == 'y' || confirm == 'Y') {
+        catalog_release(catalog, user->strategies[choice - 1].hash);
         // Shift strategies down
         for (int i = choice - 1; i < user->strategy_count - 1; i++) {
-            user->custom_strategies[i] = user->custom_strategies[i + 1];
+            user->strategies[i] = user->strategies[i + 1];
         }
         user->strategy_count--;
         printf("\n✓ Strategy deleted successfully!\n");
@@ -285,22 +465,53 @@ void delete_strategy(User *user) {
     }
 }
 
-Strategy select_user_strategy(User *user) {
+Strategy select_user_strategy(User *user, const StrategyCatalog *catalog) {
     int choice;
     printf("\nSelect strategy (1-%d) or 0 for preset strategies: ", user->strategy_count);
     scanf("%d", &choice);
     
-    if (choice > 0 && choice <= user->strategy_count) {
-        return user->custom_strategies[choice - 1];
+    Strategy strategy;
+    if (choice > 0 && choice <= user->strategy_count &&
+        catalog_resolve(catalog, &user->strategies[choice - 1], &strategy) == 0) {
+        return strategy;
     } else {
-        Strategy strategy;
         // Return empty strategy to indicate preset selection needed
         strategy.sma_short_period = -1; // Flag for main to handle
         return strategy;
     }
 }
 
-void strategy_management_menu(User *user, User users[], int user_count) {
+void get_preset_strategy(Strategy *strategy) {
+    Strategy presets[PRESET_STRATEGY_COUNT];
+    int choice;
+    
+    printf("\nSelect Preset Trading Strategy:\n");
+    printf("1. Simple Moving Average Crossover\n");
+    printf("2. RSI-based Strategy\n");
+    printf("3. Combined Strategy (SMA + RSI)\n");
+    printf("Enter choice (1-3): ");
+    scanf("%d", &choice);
+
+    // Anything out of range falls back to the combined strategy
+    get_preset_strategies(presets);
+    *strategy = presets[choice >= 1 && choice <= PRESET_STRATEGY_COUNT ? choice - 1 : 2];
+
+    printf("\n=== STRATEGY CONFIGURED ===\n");
+    printf("Name: %s\n", strategy->name);
+    if (strategy->sma_short_period > 0) {
+        printf("SMA Short Period: %d days\n", strategy->sma_short_period);
+        printf("SMA Long Period: %d days\n", strategy->sma_long_period);
+    }
+    if (strategy->rsi_oversold > 0) {
+        printf("RSI Oversold: %.0f\n", strategy->rsi_oversold);
+        printf("RSI Overbought: %.0f\n", strategy->rsi_overbought);
+    }
+    printf("Stop Loss: %.2f%%\n", strategy->stop_loss_pct);
+    printf("Take Profit: %.2f%%\n", strategy->take_profit_pct);
+    printf("Max Holding: %d days\n", strategy->max_holding_days);
+}
+
+void strategy_management_menu(User *user, User users[], int user_count, StrategyCatalog *catalog) {
     int choice;
     
     do {
@@ -315,19 +526,19 @@ void strategy_management_menu(User *user, User users[], int user_count) {
         
         switch (choice) {
             case 1:
-                create_new_strategy(user);
-                save_users(users, user_count);
+                create_new_strategy(user, catalog);
+                save_users(users, user_count, catalog);
                 break;
             case 2:
-                edit_strategy(user);
-                save_users(users, user_count);
+                edit_strategy(user, catalog);
+                save_users(users, user_count, catalog);
                 break;
             case 3:
-                show_user_strategies(user);
+                show_user_strategies(user, catalog);
                 break;
             case 4:
-                delete_strategy(user);
-                save_users(users, user_count);
+                delete_strategy(user, catalog);
+                save_users(users, user_count, catalog);
                 break;
             case 5:
                 printf("Returning to main menu...\n");
@@ -2,16 +2,19 @@
 #define USER_MANAGEMENT_H
 
 #include "structures.h"
+#include "strategy_catalog.h"
 
-void load_users(User users[], int *user_count);
-void save_users(User users[], int user_count);
+void load_users(User users[], int *user_count, StrategyCatalog *catalog);
+void save_users(User users[], int user_count, const StrategyCatalog *catalog);
+void free_users(User users[], int user_count);
 int login(User users[], int user_count, char *logged_username);
 void register_user(User users[], int *user_count);
-void create_new_strategy(User *user);
-void edit_strategy(User *user);
-void show_user_strategies(User *user);
-void delete_strategy(User *user);
-Strategy select_user_strategy(User *user);
-void strategy_management_menu(User *user, User users[], int user_count);
+void create_new_strategy(User *user, StrategyCatalog *catalog);
+void edit_strategy(User *user, StrategyCatalog *catalog);
+void show_user_strategies(User *user, const StrategyCatalog *catalog);
+void delete_strategy(User *user, StrategyCatalog *catalog);
+Strategy select_user_strategy(User *user, const StrategyCatalog *catalog);
+void get_preset_strategy(Strategy *strategy);
+void strategy_management_menu(User *user, User users[], int user_count, StrategyCatalog *catalog);
 
 #endif
\ No newline at end of file